@@ -1,6 +1,7 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <cstring>
 
 #include "ApplicationLog.h"
 #include "Utilities.h"
@@ -8,6 +9,9 @@
 using namespace std;
 using namespace sa;
 
+static const uint32_t logFormatMagic = 0x474c4153; // "SALG"
+static const uint32_t logFormatVersion = 2;
+
 ApplicationLogger& ApplicationLogger::instance()
 {
     static ApplicationLogger theInstance;
@@ -19,6 +23,11 @@ void ApplicationLogger::openLog (IOutputStream* binaryOutputStream)
     saAssert (!stream && !stringTable);
     stream = binaryOutputStream;
     stringTable = new map <string, uint32_t>;
+    literalStringIndices = new map <const char*, uint32_t>;
+    formatStringIndices = new vector <uint32_t>;
+
+    writeInteger (logFormatMagic);
+    writeInteger (logFormatVersion);
 }
 
 void ApplicationLogger::closeLog()
@@ -31,6 +40,18 @@ void ApplicationLogger::closeLog()
         delete stringTable;
         stringTable = nullptr;
     }
+
+    if (literalStringIndices)
+    {
+        delete literalStringIndices;
+        literalStringIndices = nullptr;
+    }
+
+    if (formatStringIndices)
+    {
+        delete formatStringIndices;
+        formatStringIndices = nullptr;
+    }
 }
 
 void ApplicationLogger::setDuplicateToCerr (bool duplicate)
@@ -44,7 +65,13 @@ void ApplicationLogger::writeInteger (uint32_t integer)
     stream->write (reinterpret_cast <char*> (&integer), 4);
 }
 
-void ApplicationLogger::writeString (std::string str)
+void ApplicationLogger::writeInteger64 (uint64_t integer)
+{
+    saAssert (stream);
+    stream->write (reinterpret_cast <char*> (&integer), 8);
+}
+
+uint32_t ApplicationLogger::writeString (const string& str)
 {
     saAssert (stream && stringTable);
 
@@ -60,26 +87,105 @@ void ApplicationLogger::writeString (std::string str)
     {
         writeInteger (it->second);
     }
+
+    return it->second;
+}
+
+void ApplicationLogger::writeLiteralString (const char* literal)
+{
+    auto it = literalStringIndices->find (literal);
+    if (it == literalStringIndices->end())
+        (*literalStringIndices)[literal] = writeString (literal);
+    else
+        writeInteger (it->second);
+}
+
+void ApplicationLogger::writeFormatString (const FormatString& formatString)
+{
+    uint32_t id = formatString.getId();
+    if (!id)
+        return void (writeString (formatString.getSource()));
+
+    // Index 0 is never used: zero ids are not cached
+    const uint32_t notWritten = 0;
+    if (id >= formatStringIndices->size())
+        formatStringIndices->resize (id + 1, notWritten);
+
+    uint32_t& index = (*formatStringIndices)[id];
+    if (index == notWritten)
+        index = writeString (formatString.getSource()) + 1;
+    else
+        writeInteger (index - 1);
+}
+
+void ApplicationLogger::writeArgument (const FormatArgument& argument)
+{
+    if (argument.type == FormatArgument::Type::CUSTOM)
+    {
+        FormatBuffer* buffer = FormatBuffer::acquireThreadBuffer();
+        buffer->appendArgument (argument);
+
+        writeInteger (static_cast <uint32_t> (FormatArgument::Type::STRING));
+        writeInteger (static_cast <uint32_t> (buffer->getContents().length()));
+        stream->write (buffer->getContents().data(), static_cast <uint32_t> (buffer->getContents().length()));
+
+        FormatBuffer::releaseThreadBuffer (buffer);
+        return;
+    }
+
+    writeInteger (static_cast <uint32_t> (argument.type));
+    switch (argument.type)
+    {
+        case FormatArgument::Type::SIGNED_INTEGER:   return writeInteger64 (static_cast <uint64_t> (argument.signedValue));
+        case FormatArgument::Type::UNSIGNED_INTEGER: return writeInteger64 (argument.unsignedValue);
+
+        case FormatArgument::Type::FLOATING_POINT:
+        {
+            uint64_t bits;
+            memcpy (&bits, &argument.floatingPointValue, 8);
+            return writeInteger64 (bits);
+        }
+
+        case FormatArgument::Type::STRING:
+            writeInteger (static_cast <uint32_t> (argument.stringValue.length));
+            return stream->write (argument.stringValue.data, static_cast <uint32_t> (argument.stringValue.length));
+
+        case FormatArgument::Type::CUSTOM:
+            break;
+    }
+
+    saUnreachable ("Invalid format argument type.");
 }
 
-void ApplicationLogger::log (const char* file, int line, const char* function, string message, bool error)
+void ApplicationLogger::log (const char* file, int line, const char* function, const FormatMessage& message, bool error)
 {
     saAssert (line >= 0);
 
     if (duplicateToCerr)
-        cerr << formatLogEntryForStderr (file, line, function, message, error);
+    {
+        FormatBuffer* buffer = FormatBuffer::acquireThreadBuffer();
+        message.format (*buffer);
+        cerr << formatLogEntryForStderr (file, line, function, buffer->getContents(), error);
+        FormatBuffer::releaseThreadBuffer (buffer);
+    }
 
     if (stream)
     {
-        writeString (file);
+        writeLiteralString (file);
         writeInteger (static_cast <uint32_t> (line));
-        writeString (function);
-        writeString (message);
+        writeLiteralString (function);
+        writeFormatString (message.getFormatString());
+
+        writeInteger (message.getNumArguments());
+        for (unsigned i = 0; i < message.getNumArguments(); i++)
+            writeArgument (message.getArgument (i));
+
         writeInteger (error ? 1 : 0);
     }
 }
 
-string sa::formatLogEntryForStderr (const char* file, int line, const char* /*function*/, string message, bool /*error*/)
+string sa::formatLogEntryForStderr (const char* file, int line, const char* /*function*/, const string& message,
+                                    bool /*error*/)
 {
     const char* sourcePathSubstring = "src/";
     const int fileFieldWidth = 18 + 1 + 3;
@@ -122,13 +228,28 @@ LogStreamHolder::~LogStreamHolder()
 unique_ptr <ApplicationLog> ApplicationLog::load (IInputStream* binaryInputStream)
 {
     unique_ptr <ApplicationLog> log (new ApplicationLog);
+
+    if (log->readInteger (binaryInputStream) != logFormatMagic)
+        throw InvalidArgumentException (__ORIGIN__, "Not an application log stream.", "binaryInputStream");
+
+    if (log->readInteger (binaryInputStream) != logFormatVersion)
+        throw InvalidArgumentException (__ORIGIN__, "Unsupported application log version.", "binaryInputStream");
+
     while (binaryInputStream->getNumBytesRemaining())
     {
         ApplicationLogEntry entry;
         entry.fileOriginIndex = log->readString (binaryInputStream);
         entry.lineOrigin = log->readInteger (binaryInputStream);
         entry.functionOriginIndex = log->readString (binaryInputStream);
-        entry.messageIndex = log->readString (binaryInputStream);
+        entry.formatStringIndex = log->readString (binaryInputStream);
+
+        entry.firstArgumentIndex = static_cast <unsigned> (log->arguments.size());
+        entry.nArguments = static_cast <unsigned> (log->readInteger (binaryInputStream));
+        saVerify (entry.nArguments <= FormatString::maxArguments);
+
+        for (unsigned i = 0; i < entry.nArguments; i++)
+            log->readArgument (binaryInputStream);
+
         entry.isError = log->readInteger (binaryInputStream) != 0;
         log->entries.push_back (entry);
     }
@@ -139,10 +260,47 @@ unique_ptr <ApplicationLog> ApplicationLog::load (IInputStream* binaryInputStrea
 uint32_t ApplicationLog::readInteger (IInputStream* stream)
 {
     uint32_t integer;
-    stream->read (reinterpret_cast <char*> (&integer), 4);
+    saVerify (stream->read (reinterpret_cast <char*> (&integer), 4) == 4);
+    return integer;
+}
+
+uint64_t ApplicationLog::readInteger64 (IInputStream* stream)
+{
+    uint64_t integer;
+    saVerify (stream->read (reinterpret_cast <char*> (&integer), 8) == 8);
     return integer;
 }
 
+void ApplicationLog::readArgument (IInputStream* stream)
+{
+    StoredArgument argument;
+    argument.type = static_cast <FormatArgument::Type> (readInteger (stream));
+    argument.bits = 0;
+
+    switch (argument.type)
+    {
+        case FormatArgument::Type::SIGNED_INTEGER:
+        case FormatArgument::Type::UNSIGNED_INTEGER:
+        case FormatArgument::Type::FLOATING_POINT:
+            argument.bits = readInteger64 (stream);
+            break;
+
+        case FormatArgument::Type::STRING:
+        {
+            uint32_t length = readInteger (stream);
+            argument.contents.resize (length);
+            if (length)
+                saVerify (stream->read (&argument.contents[0], length) == length);
+            break;
+        }
+
+        case FormatArgument::Type::CUSTOM:
+            saUnreachable ("Custom arguments are stored as strings.");
+    }
+
+    arguments.push_back (argument);
+}
+
 unsigned ApplicationLog::readString (IInputStream* stream)
 {
     unsigned index = static_cast <unsigned> (readInteger (stream));
@@ -162,7 +320,36 @@ unsigned ApplicationLog::readString (IInputStream* stream)
 
 string ApplicationLog::getEntryMessage (unsigned int entryIndex) const
 {
-    return stringTable[entries[entryIndex].messageIndex];
+    const ApplicationLogEntry& entry = entries[entryIndex];
+
+    if (formatStrings.size() < stringTable.size())
+        formatStrings.resize (stringTable.size());
+
+    unique_ptr <FormatString>& formatString = formatStrings[entry.formatStringIndex];
+    if (!formatString)
+        formatString.reset (new FormatString (stringTable[entry.formatStringIndex]));
+
+    FormatArgument messageArguments[FormatString::maxArguments];
+    for (unsigned i = 0; i < entry.nArguments; i++)
+    {
+        const StoredArgument& stored = arguments[entry.firstArgumentIndex + i];
+        FormatArgument& argument = messageArguments[i];
+
+        argument.type = stored.type;
+        if (stored.type == FormatArgument::Type::STRING)
+        {
+            argument.stringValue.data = stored.contents.data();
+            argument.stringValue.length = stored.contents.length();
+        }
+        else
+        {
+            static_assert (sizeof (argument.unsignedValue) == 8 && sizeof (argument.floatingPointValue) == 8,
+                           "Argument values are stored as 64 bits.");
+            memcpy (&argument.unsignedValue, &stored.bits, 8);
+        }
+    }
+
+    return FormatMessage (*formatString, messageArguments, entry.nArguments).toString();
 }
 
 string ApplicationLog::getEntryFileOrigin (unsigned int entryIndex) const
@@ -194,7 +381,7 @@ LogAction::LogAction (const char* file, int line, const char* function, bool err
     file (file), line (line), function (function), error (error)
 {}
 
-void LogAction::fire (string formattedString)
+void LogAction::fire (const FormatMessage& message) const
 {
-    sa::ApplicationLogger::instance().log (file, line, function, formattedString, error);
+    sa::ApplicationLogger::instance().log (file, line, function, message, error);
 }
@@ -15,10 +15,16 @@ using std::string;
 using std::vector;
 using std::map;
 
+/* Binary log format: a header (magic & version), then entries until the end of the stream.
+   Strings (file & function origins, format strings) are written once, later references use their indices.
+   Messages are not formatted: an entry contains the format string and typed arguments (see FormatArgument).
+   Custom arguments are formatted on write and stored as strings. */
+
 class ApplicationLogger
 {
 public :
-    void log (const char* file, int line, const char* function, string message, bool error);
+    // Formats the message only if it is duplicated to stderr
+    void log (const char* file, int line, const char* function, const FormatMessage& message, bool error);
 
     void openLog (IOutputStream* binaryOutputStream);
     void closeLog();
@@ -36,10 +42,18 @@ private :
     IOutputStream* stream;
     map <string, uint32_t>* stringTable;
 
+    // Caches of string table indices: by address of string literals & by id of call site format strings
+    map <const char*, uint32_t>* literalStringIndices;
+    vector <uint32_t>* formatStringIndices;
+
     bool duplicateToCerr;
 
-    void writeString (string string);
+    uint32_t writeString (const string& str);
+    void writeLiteralString (const char* literal);
+    void writeFormatString (const FormatString& formatString);
+    void writeArgument (const FormatArgument& argument);
     void writeInteger (uint32_t integer);
+    void writeInteger64 (uint64_t integer);
 };
 
 class LogStreamHolder
@@ -58,6 +72,7 @@ public :
     string getEntryFunctionOrigin (unsigned entryIndex) const;
     unsigned getEntryLineOrigin (unsigned entryIndex) const;
 
+    // Formats the message on demand
     string getEntryMessage (unsigned entryIndex) const;
     bool isErrorEntry (unsigned entryIndex) const;
 
@@ -75,17 +90,31 @@ private :
         unsigned fileOriginIndex, functionOriginIndex;
         unsigned lineOrigin;
 
-        unsigned messageIndex;
+        unsigned formatStringIndex;
+        unsigned firstArgumentIndex, nArguments;
         bool isError;
     };
 
+    struct StoredArgument
+    {
+        FormatArgument::Type type;
+        uint64_t bits;
+        string contents;
+    };
+
     vector <ApplicationLogEntry> entries;
+    vector <StoredArgument> arguments;
+
+    // Parsed lazily, indexed by string table index
+    mutable vector < unique_ptr <FormatString> > formatStrings;
 
     unsigned readString (IInputStream* stream);
     uint32_t readInteger (IInputStream* stream);
+    uint64_t readInteger64 (IInputStream* stream);
+    void readArgument (IInputStream* stream);
 };
 
-string formatLogEntryForStderr (const char* file, int line, const char* function, string message, bool error);
+string formatLogEntryForStderr (const char* file, int line, const char* function, const string& message, bool error);
 
 //#define saLogPure(message) sa::ApplicationLogger::instance().log (__ORIGIN__, (message), false)
 //#define saErrorPure(message) sa::ApplicationLogger::instance().log (__ORIGIN__, (message), true)
@@ -95,7 +124,7 @@ class LogAction : public IAfterformatAction
 public :
     LogAction (const char* file, int line, const char* function, bool error);
 
-    virtual void fire (string formattedString);
+    virtual void fire (const FormatMessage& message) const;
 
 private :
     const char* file;
@@ -104,8 +133,9 @@ private :
     bool error;
 };
 
-#define saLog(message)  sa::FormatObjectsHolder (saTranslate (message), new sa::LogAction (__ORIGIN__, false))
-#define saError(message) sa::FormatObjectsHolder (saTranslate (message), new sa::LogAction (__ORIGIN__, true))
+// The LogAction temporary outlives the holder: both die at the end of the full-expression, the action is created first
+#define saLog(message)   sa::FormatObjectsHolder (message, saFormatCallSite(), true, sa::LogAction (__ORIGIN__, false))
+#define saError(message) sa::FormatObjectsHolder (message, saFormatCallSite(), true, sa::LogAction (__ORIGIN__, true))
 
 }
 
@@ -0,0 +1,57 @@
+#include "Arena.h"
+#include "Debug.h"
+
+#include <algorithm>
+
+using namespace sa;
+using namespace std;
+
+sa::Arena::Arena (size_t blockSize, size_t maxBytesKept) :
+    blockSize (blockSize), maxBytesKept (maxBytesKept), currentBlock (0), blockPosition (0), nBytesUsed (0), nBytesReserved (0)
+{}
+
+sa::Arena::~Arena()
+{}
+
+void* sa::Arena::allocate (size_t nBytes, size_t alignment)
+{
+    saAssert (alignment > 0 && (alignment & (alignment - 1)) == 0 && alignment <= alignof (max_align_t));
+
+    for (; currentBlock < blocks.size(); currentBlock++, blockPosition = 0)
+    {
+        // Blocks are aligned for any type: positions are aligned as offsets
+        size_t position = (blockPosition + alignment - 1) & ~(alignment - 1);
+        if (position + nBytes <= blocks[currentBlock].size)
+        {
+            blockPosition = position + nBytes;
+            nBytesUsed += nBytes;
+            return blocks[currentBlock].data.get() + position;
+        }
+    }
+
+    // Allocations larger than blocks get blocks of their own
+    size_t size = max (blockSize, nBytes);
+    blocks.push_back (Block { unique_ptr <char[]> (new char[size]), size });
+    nBytesReserved += size;
+
+    currentBlock = blocks.size() - 1;
+    blockPosition = nBytes;
+    nBytesUsed += nBytes;
+    return blocks[currentBlock].data.get();
+}
+
+void sa::Arena::reset()
+{
+    // Blocks are kept in order of allocation: the first ones are the ones every file uses
+    size_t nBlocksKept = 0;
+    uint64_t nBytesKept = 0;
+    for (; nBlocksKept < blocks.size() && nBytesKept + blocks[nBlocksKept].size <= maxBytesKept; nBlocksKept++)
+        nBytesKept += blocks[nBlocksKept].size;
+
+    blocks.resize (nBlocksKept);
+    nBytesReserved = nBytesKept;
+
+    currentBlock = 0;
+    blockPosition = 0;
+    nBytesUsed = 0;
+}
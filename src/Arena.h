@@ -0,0 +1,109 @@
+#ifndef STYLE_ANALYZER_ARENA_H
+#define STYLE_ANALYZER_ARENA_H
+
+/* Arena: memory for the data of a single file, taken from large blocks by bumping a pointer & released at once.
+
+   Containers of file contexts take an ArenaAllocator: their memory comes from the arena, or from the heap if there is
+   none (i. e. contexts edited for as long as an editor runs, see IncrementalSession.h). Memory given back to an arena
+   is not reused until the arena is reset: reserve containers when their size is known, buffers left by growth stay.
+   Resetting keeps the blocks for the next file: a process grabbing files one after another allocates them once. Blocks
+   beyond maxBytesKept are freed on reset: a single huge file does not hold its memory for as long as the process runs.
+   Whatever lives in an arena must be destroyed before it is reset.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace sa
+{
+
+class Arena
+{
+public :
+    explicit Arena (size_t blockSize = 1 << 16, size_t maxBytesKept = 1 << 24);
+    ~Arena();
+
+    void* allocate (size_t nBytes, size_t alignment);
+
+    // Everything allocated is released, blocks are kept up to maxBytesKept
+    void reset();
+
+    uint64_t getNumBytesUsed() const
+    {
+        return nBytesUsed;
+    }
+
+    uint64_t getNumBytesReserved() const
+    {
+        return nBytesReserved;
+    }
+
+private :
+    Arena (const Arena&) = delete;
+    Arena& operator= (const Arena&) = delete;
+
+    struct Block
+    {
+        std::unique_ptr <char[]> data;
+        size_t size;
+    };
+
+    size_t blockSize, maxBytesKept;
+    // Blocks before currentBlock are full
+    std::vector <Block> blocks;
+    size_t currentBlock, blockPosition;
+    uint64_t nBytesUsed, nBytesReserved;
+};
+
+// A null arena allocates from the heap
+template <typename T> class ArenaAllocator
+{
+public :
+    typedef T value_type;
+
+    ArenaAllocator (Arena* arena = nullptr) :
+        arena (arena)
+    {}
+
+    template <typename U> ArenaAllocator (const ArenaAllocator <U>& other) :
+        arena (other.getArena())
+    {}
+
+    T* allocate (size_t n)
+    {
+        if (arena)
+            return static_cast <T*> (arena->allocate (n * sizeof (T), alignof (T)));
+        return static_cast <T*> (::operator new (n * sizeof (T)));
+    }
+
+    void deallocate (T* pointer, size_t)
+    {
+        if (!arena)
+            ::operator delete (pointer);
+    }
+
+    Arena* getArena() const
+    {
+        return arena;
+    }
+
+    template <typename U> bool operator== (const ArenaAllocator <U>& other) const
+    {
+        return arena == other.getArena();
+    }
+
+    template <typename U> bool operator!= (const ArenaAllocator <U>& other) const
+    {
+        return arena != other.getArena();
+    }
+
+private :
+    Arena* arena;
+};
+
+}
+
+#endif // STYLE_ANALYZER_ARENA_H
@@ -0,0 +1,168 @@
+/* Headers file format (native byte order):
+   - header: magic, version (32-bit)
+   - headers (count, then for every header): name, size & content hash (64-bit)
+   Records & hashes are written & read by src/BinaryData.h.
+*/
+
+#include "AstCache.h"
+#include "BinaryData.h"
+#include "FileSystem.h"
+#include "FileStreams.h"
+#include "ApplicationLog.h"
+#include "Debug.h"
+
+#include <cstdio>
+#include <set>
+
+using namespace sa;
+using namespace std;
+
+static const uint32_t headersMagic = 0x48415341; // "ASAH"
+static const uint32_t headersVersion = 1;
+
+namespace
+{
+
+string readWholeFile (const string& fileName)
+{
+    unique_ptr <UniversalInputStream> stream = UniversalInputStream::openInputStream (fileName,
+                                                                                       RelativeInputStreamFlags::BINARY);
+    string contents (stream->getNumBytesRemaining(), 0);
+    if (!contents.empty())
+        stream->read (&contents[0], static_cast <uint32_t> (contents.length()));
+    return contents;
+}
+
+void collectHeader (CXFile includedFile, CXSourceLocation*, unsigned includeDepth, CXClientData clientData)
+{
+    // The main file has no inclusion stack
+    if (includeDepth > 0)
+        static_cast <set <string>*> (clientData)->insert (convertCXString (clang_getFileName (includedFile)));
+}
+
+}
+
+sa::AstCache::AstCache (const string& directory, const vector <string>& compilerOptions) :
+    directory (directory), optionsHash (hashOffsetBasis)
+{
+    // Serialized units are readable by the same libclang only
+    optionsHash = hashString (optionsHash, convertCXString (clang_getClangVersion()));
+    for (const string& option: compilerOptions)
+        optionsHash = hashString (optionsHash, option);
+}
+
+string sa::AstCache::getEntryPath (const string& fileName, const string& contents) const
+{
+    uint64_t hash = hashString (optionsHash, fileName);
+    hash = hashBytes (hash, contents.data(), contents.length());
+
+    char name[17];
+    snprintf (name, sizeof (name), "%016llx", static_cast <unsigned long long> (hash));
+    return FileSystem::instance().appendPath (directory, name);
+}
+
+bool sa::AstCache::areHeadersUpToDate (const string& headersFileName) const
+{
+    IFileSystem& fileSystem = FileSystem::instance();
+    if (!fileSystem.fileExists (headersFileName))
+        return false;
+
+    string data = readWholeFile (headersFileName);
+    BinaryReader reader (data.data(), data.length());
+    if (reader.readInteger() != headersMagic || reader.readInteger() != headersVersion)
+        return false;
+
+    uint32_t nHeaders = reader.readInteger();
+    for (uint32_t i = 0; i < nHeaders && reader.isOk(); i++)
+    {
+        string fileName = reader.readString();
+        uint64_t size = reader.readInteger64();
+        uint64_t hash = reader.readInteger64();
+
+        FileStatus status;
+        if (!reader.isOk() || !fileSystem.getFileStatus (fileName, status))
+            return false;
+
+        // Modification times have a second resolution: a header changed within the second it was saved in
+        // would keep its time, so contents are always hashed
+        if (status.size != size || hashFileContents (fileName) != hash)
+        {
+            saLog ("Cached AST is out of date: header '%1' changed") << fileName;
+            return false;
+        }
+    }
+
+    return reader.isOk() && reader.isAtEnd();
+}
+
+ClangTranslationUnit sa::AstCache::load (ClangIndex& index, const string& fileName, const string& contents)
+{
+    string entryPath = getEntryPath (fileName, contents);
+
+    ClangTranslationUnit unit (nullptr);
+    if (areHeadersUpToDate (entryPath + ".headers"))
+        unit = index.loadTranslationUnit (entryPath + ".ast");
+
+    if (unit)
+        saLog ("AST of '%1' loaded from '%2'") << fileName << entryPath + ".ast";
+
+    return unit;
+}
+
+void sa::AstCache::save (CXTranslationUnit unit, const string& fileName, const string& contents)
+{
+    IFileSystem& fileSystem = FileSystem::instance();
+    string entryPath = getEntryPath (fileName, contents);
+
+    set <string> headers;
+    clang_getInclusions (unit, collectHeader, &headers);
+
+    BinaryWriter writer;
+    writer.writeInteger (headersMagic);
+    writer.writeInteger (headersVersion);
+    writer.writeInteger (static_cast <uint32_t> (headers.size()));
+
+    for (const string& header: headers)
+    {
+        FileStatus status;
+        if (!fileSystem.getFileStatus (header, status))
+        {
+            saLog ("AST of '%1' not cached: header '%2' is not a file") << fileName << header;
+            return;
+        }
+
+        // Entries may be loaded from another working directory
+        writer.writeString (fileSystem.getCanonicalPath (header));
+        writer.writeInteger64 (status.size);
+        writer.writeInteger64 (hashFileContents (header));
+    }
+
+    // Written aside & renamed: concurrent runs & workers never see a partial entry. The unit goes first,
+    // the headers file makes the entry visible.
+    string astFileName = entryPath + ".ast", headersFileName = entryPath + ".headers";
+    string temporaryAstFileName = getTemporaryFileName (astFileName);
+    if (clang_saveTranslationUnit (unit, temporaryAstFileName.c_str(), clang_defaultSaveOptions (unit)) != 0 ||
+        rename (temporaryAstFileName.c_str(), astFileName.c_str()) != 0)
+    {
+        remove (temporaryAstFileName.c_str());
+        saLog ("AST of '%1' not cached: failed to save '%2'") << fileName << astFileName;
+        return;
+    }
+
+    string temporaryHeadersFileName = getTemporaryFileName (headersFileName);
+    {
+        unique_ptr <FileOutputStream> stream = FileOutputStream::openOutputStream (temporaryHeadersFileName,
+                                                                                   RelativeOutputStreamFlags::BINARY);
+        saVerify (writer.contents.length() <= UINT32_MAX);
+        stream->write (writer.contents.data(), static_cast <uint32_t> (writer.contents.length()));
+    }
+
+    if (rename (temporaryHeadersFileName.c_str(), headersFileName.c_str()) != 0)
+    {
+        remove (temporaryHeadersFileName.c_str());
+        saLog ("AST of '%1' not cached: failed to save '%2'") << fileName << headersFileName;
+        return;
+    }
+
+    saLog ("AST of '%1' saved to '%2'") << fileName << astFileName;
+}
@@ -0,0 +1,50 @@
+#ifndef STYLE_ANALYZER_AST_CACHE_H
+#define STYLE_ANALYZER_AST_CACHE_H
+
+/* AST cache: translation units saved by libclang (clang_saveTranslationUnit) & loaded instead of parsing.
+
+   'AstCacheDirectory = "<directory>"' in the [dataGrabbing] section enables it. An entry is a pair of files named by
+   the hash of the libclang version, the clang options, the source name & the source text:
+   - '<key>.ast', the serialized unit; it keeps the source text, so in-memory sources are cached as well
+   - '<key>.headers', the headers the unit included: names, sizes & content hashes
+   An entry is used if every header has the same size & contents (hashing headers costs far less than parsing them).
+   libclang also refuses a unit whose headers were touched, even if they are the same: the file is parsed & its entry
+   saved again. Units with errors are not cached. A header added earlier in the include path, shadowing one recorded,
+   is not noticed: clear the directory when include paths or system headers change.
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LibclangHelpers.h"
+
+namespace sa
+{
+
+using std::string;
+using std::vector;
+
+class AstCache
+{
+public :
+    // The directory must exist
+    AstCache (const string& directory, const vector <string>& compilerOptions);
+
+    // Returns a null unit if there is no up to date entry
+    ClangTranslationUnit load (ClangIndex& index, const string& fileName, const string& contents);
+
+    // Failures are logged only: the cache is never required
+    void save (CXTranslationUnit unit, const string& fileName, const string& contents);
+
+private :
+    string directory;
+    uint64_t optionsHash;
+
+    string getEntryPath (const string& fileName, const string& contents) const;
+    bool areHeadersUpToDate (const string& headersFileName) const;
+};
+
+}
+
+#endif // STYLE_ANALYZER_AST_CACHE_H
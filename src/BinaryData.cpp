@@ -0,0 +1,95 @@
+#include <cstring>
+
+#include <unistd.h>
+
+#include "BinaryData.h"
+#include "FileStreams.h"
+
+using namespace sa;
+using namespace std;
+
+uint64_t sa::hashBytes (uint64_t hash, const char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ static_cast <unsigned char> (data[i])) * 1099511628211ull;
+    return hash;
+}
+
+uint64_t sa::hashString (uint64_t hash, const string& s)
+{
+    return hashBytes (hash, s.c_str(), s.length() + 1);
+}
+
+uint64_t sa::hashFileContents (const string& fileName)
+{
+    unique_ptr <UniversalInputStream> stream = UniversalInputStream::openInputStream (fileName,
+                                                                                       RelativeInputStreamFlags::BINARY);
+    uint64_t hash = hashOffsetBasis;
+
+    char buffer[4096];
+    while (uint32_t nRead = stream->read (buffer, sizeof (buffer)))
+        hash = hashBytes (hash, buffer, nRead);
+
+    return hash;
+}
+
+void sa::BinaryWriter::writeInteger (uint32_t integer)
+{
+    contents.append (reinterpret_cast <const char*> (&integer), sizeof (integer));
+}
+
+void sa::BinaryWriter::writeInteger64 (uint64_t integer)
+{
+    contents.append (reinterpret_cast <const char*> (&integer), sizeof (integer));
+}
+
+void sa::BinaryWriter::writeString (const string& s)
+{
+    writeInteger (static_cast <uint32_t> (s.length()));
+    contents += s;
+}
+
+sa::BinaryReader::BinaryReader (const char* data, size_t size) :
+    data (data), size (size), position (0), isValid (true)
+{}
+
+uint32_t sa::BinaryReader::readInteger()
+{
+    uint32_t integer = 0;
+    if (require (sizeof (integer)))
+        memcpy (&integer, data + position, sizeof (integer));
+    position += isValid ? sizeof (integer) : 0;
+    return integer;
+}
+
+uint64_t sa::BinaryReader::readInteger64()
+{
+    uint64_t integer = 0;
+    if (require (sizeof (integer)))
+        memcpy (&integer, data + position, sizeof (integer));
+    position += isValid ? sizeof (integer) : 0;
+    return integer;
+}
+
+string sa::BinaryReader::readString()
+{
+    uint32_t length = readInteger();
+    if (!require (length))
+        return string();
+
+    string s (data + position, length);
+    position += length;
+    return s;
+}
+
+bool sa::BinaryReader::require (size_t nBytes)
+{
+    if (isValid && size - position < nBytes)
+        isValid = false;
+    return isValid;
+}
+
+string sa::getTemporaryFileName (const string& fileName)
+{
+    return fileName + "." + to_string (getpid()) + ".tmp";
+}
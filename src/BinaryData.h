@@ -0,0 +1,75 @@
+#ifndef STYLE_ANALYZER_BINARY_DATA_H
+#define STYLE_ANALYZER_BINARY_DATA_H
+
+/* Binary data: records of caches & snapshots kept on disk (see IniConfigurationSnapshot.cpp, AstCache.cpp)
+   or sent between processes, and the hash telling whether a file changed.
+
+   Records are in native byte order: integers are 32 or 64-bit, strings are a 32-bit length followed by characters.
+   The reader never throws: an out of bounds read marks the data as invalid (readers of caches treat it as missing).
+   Hashes are 64-bit FNV-1a: fast & good enough to tell files apart, not meant to resist collisions made on purpose.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sa
+{
+
+using std::string;
+
+const uint64_t hashOffsetBasis = 14695981039346656037ull;
+
+// The hash continued by the bytes given
+uint64_t hashBytes (uint64_t hash, const char* data, size_t length);
+
+// The terminating zero is hashed too: hashes of concatenations keep the strings apart
+uint64_t hashString (uint64_t hash, const string& s);
+
+uint64_t hashFileContents (const string& fileName);
+
+class BinaryWriter
+{
+public :
+    string contents;
+
+    void writeInteger (uint32_t integer);
+    void writeInteger64 (uint64_t integer);
+    void writeString (const string& s);
+};
+
+class BinaryReader
+{
+public :
+    // The data must outlive the reader
+    BinaryReader (const char* data, size_t size);
+
+    bool isOk() const
+    {
+        return isValid;
+    }
+
+    bool isAtEnd() const
+    {
+        return position == size;
+    }
+
+    uint32_t readInteger();
+    uint64_t readInteger64();
+    string readString();
+
+private :
+    const char* data;
+    size_t size, position;
+    bool isValid;
+
+    bool require (size_t nBytes);
+};
+
+// Name of a file written aside & renamed over the file given: readers never see a partial file. The name is unique
+// per process, so processes writing the same file at once do not write into each other's data.
+string getTemporaryFileName (const string& fileName);
+
+}
+
+#endif // STYLE_ANALYZER_BINARY_DATA_H
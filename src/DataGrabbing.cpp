@@ -0,0 +1,716 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <map>
+
+#include "DataGrabbing.h"
+#include "ApplicationLog.h"
+#include "AstCache.h"
+#include "FileContext.h"
+#include "FileStreams.h"
+#include "FileSystem.h"
+#include "LibclangHelpers.h"
+#include "MemoryAccounting.h"
+#include "Metrics.h"
+#include "StyleStatistics.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+using namespace sa;
+using namespace std;
+
+namespace
+{
+
+// Counts bytes written into the wrapped stream
+class CountingOutputStream : public IOutputStream
+{
+public :
+    explicit CountingOutputStream (IOutputStream* stream) :
+        stream (stream), nBytesWritten (0)
+    {}
+
+    ~CountingOutputStream();
+
+    void write (const char* data, uint32_t nBytes)
+    {
+        stream->write (data, nBytes);
+        nBytesWritten += nBytes;
+    }
+
+    uint64_t getNumBytesWritten() const
+    {
+        return nBytesWritten;
+    }
+
+private :
+    IOutputStream* stream;
+    uint64_t nBytesWritten;
+};
+
+CountingOutputStream::~CountingOutputStream()
+{}
+
+// Returns the sampled resident set size
+uint64_t logMemoryUsage (const char* stage)
+{
+    uint64_t residentBytes = getResidentBytes();
+    saLog ("Memory after %1: heap %2 KiB (peak %3 KiB), RSS %4 KiB") << stage << getLiveHeapBytes() / 1024
+        << getPeakLiveHeapBytes() / 1024 << residentBytes / 1024;
+    return residentBytes;
+}
+
+unique_ptr <IOutputStream> openContextFile (const IniConfiguration& project)
+{
+    return FileOutputStream::openOutputStream (project[saIniKey ("common.contextfilename")],
+                                               RelativeOutputStreamFlags::APPEND | RelativeOutputStreamFlags::BINARY);
+}
+
+// Worker result: the report, the statistics & trace lengths (32-bit), the statistics, the trace events exported by
+// the worker, then the serialized context
+string encodeGrabResult (const FileGrabReport& report, const StyleStatistics& statistics, const string& trace,
+                         const string& context)
+{
+    MemoryOutputStream statisticsStream;
+    statistics.save (&statisticsStream);
+    uint32_t statisticsLength = static_cast <uint32_t> (statisticsStream.getContents().length());
+    uint32_t traceLength = static_cast <uint32_t> (trace.length());
+
+    string result (sizeof (report) + sizeof (statisticsLength) + sizeof (traceLength), 0);
+    memcpy (&result[0], &report, sizeof (report));
+    memcpy (&result[sizeof (report)], &statisticsLength, sizeof (statisticsLength));
+    memcpy (&result[sizeof (report) + sizeof (statisticsLength)], &traceLength, sizeof (traceLength));
+    return result + statisticsStream.getContents() + trace + context;
+}
+
+FileGrabReport decodeGrabResult (const string& result, StyleStatistics& statistics, string& trace, string& context)
+{
+    FileGrabReport report;
+    uint32_t statisticsLength = 0, traceLength = 0;
+    saVerify (result.length() >= sizeof (report) + sizeof (statisticsLength) + sizeof (traceLength));
+    memcpy (&report, result.data(), sizeof (report));
+    memcpy (&statisticsLength, result.data() + sizeof (report), sizeof (statisticsLength));
+    memcpy (&traceLength, result.data() + sizeof (report) + sizeof (statisticsLength), sizeof (traceLength));
+
+    size_t statisticsOffset = sizeof (report) + sizeof (statisticsLength) + sizeof (traceLength);
+    saVerify (result.length() - statisticsOffset >= uint64_t (statisticsLength) + traceLength);
+    unique_ptr <UniversalInputStream> statisticsStream =
+        UniversalInputStream::openInputStream ("<grabbing result>", result.substr (statisticsOffset, statisticsLength));
+    statistics = StyleStatistics::load (statisticsStream.get());
+
+    trace = result.substr (statisticsOffset + statisticsLength, traceLength);
+    context = result.substr (statisticsOffset + statisticsLength + traceLength);
+    return report;
+}
+
+// A file name, or an in-memory source: the name, zero byte, the contents
+string encodeGrabTask (const string& fileName, bool isInMemory, const string& contents)
+{
+    return isInMemory ? fileName + '\0' + contents : fileName;
+}
+
+FileGrabReport grabTask (const IniConfiguration& project, const string& task, IOutputStream* contextStream,
+                         HeaderRegistry* headerRegistry, StyleStatistics* statistics)
+{
+    size_t separator = task.find ('\0');
+    if (separator == string::npos)
+        return grabDataFromFile (project, task, contextStream, headerRegistry, statistics);
+
+    return grabDataFromSource (project, task.substr (0, separator), task.substr (separator + 1), contextStream,
+                               headerRegistry, statistics);
+}
+
+struct IncludedHeaders
+{
+    CXTranslationUnit unit;
+    vector <CXFile> files;
+};
+
+void collectProjectHeader (CXFile includedFile, CXSourceLocation*, unsigned includeDepth, CXClientData clientData)
+{
+    IncludedHeaders& headers = *static_cast <IncludedHeaders*> (clientData);
+
+    // The main file has no inclusion stack
+    if (includeDepth > 0 && !clang_Location_isInSystemHeader (clang_getLocationForOffset (headers.unit, includedFile, 0)))
+        headers.files.push_back (includedFile);
+}
+
+// Writes contexts of the project headers of the unit claimed in the registry, returns their tokens. The arena is reset
+// after every header: a single header context is in memory at a time.
+uint32_t grabHeaders (CXTranslationUnit unit, HeaderRegistry& headerRegistry, NameCollector& nameCollector, Arena& arena,
+                      StyleStatistics* statistics, IOutputStream* contextStream, uint32_t& nHeaders)
+{
+    IFileSystem& fileSystem = FileSystem::instance();
+
+    IncludedHeaders headers = IncludedHeaders { unit, vector <CXFile>() };
+    clang_getInclusions (unit, collectProjectHeader, &headers);
+
+    uint32_t nTokens = 0;
+    for (CXFile file: headers.files)
+    {
+        string fileName = convertCXString (clang_getFileName (file));
+        unsigned long size = 0;
+        const char* contents = clang_getFileContents (unit, file, &size);
+        if (!contents || !fileSystem.fileExists (fileName))
+            continue;
+
+        // Includes of a header through different paths name the same file
+        string canonicalName = fileSystem.getCanonicalPath (fileName);
+        string headerContents (contents, size);
+        if (!headerRegistry.claim (canonicalName, headerContents))
+            continue;
+
+        saTraceScope ("Grab header", "file", canonicalName);
+        saLog ("Grabbing data from header '%1'") << canonicalName;
+
+        unique_ptr <FileContext> context = FileContext::create (unit, file, canonicalName, move (headerContents),
+                                                                &nameCollector, &arena);
+        context->save (contextStream);
+        if (statistics)
+            statistics->addFile (*context);
+
+        nTokens += context->getIndentationContext()->getNumTokens();
+        nHeaders++;
+
+        context.reset();
+        arena.reset();
+    }
+
+    return nTokens;
+}
+
+// The index, the indexing session & the arena of the grabbing process: made on the first file, workers make their own
+struct GrabbingSession
+{
+    ClangIndex index;
+    NameCollector nameCollector;
+    // Contexts of a file are destroyed before the next file: it is reset for every file
+    Arena arena;
+    // The source context is kept while its headers are written: their contexts have an arena of their own
+    Arena headerArena;
+
+    GrabbingSession() :
+        index (false, true), nameCollector (index)
+    {}
+};
+
+GrabbingSession& getGrabbingSession()
+{
+    static unique_ptr <GrabbingSession> session (new GrabbingSession);
+    return *session;
+}
+
+// Stays open until the worker exits
+unique_ptr <FileOutputStream> workerLogStream;
+
+void startGrabbingWorker (unsigned workerIndex)
+{
+    // The coordinator log can not be shared; trace events go back to the coordinator with results
+    ApplicationLogger::instance().closeLog();
+    workerLogStream = FileOutputStream::openOutputStream ("application-log-worker" + to_string (workerIndex),
+                                                          RelativeOutputStreamFlags::BINARY |
+                                                          RelativeOutputStreamFlags::UNBUFFERED);
+    ApplicationLogger::instance().openLog (workerLogStream.get());
+    ApplicationLogger::instance().setDuplicateToCerr (false);
+
+    TraceRecorder::instance().continueInForkedProcess (workerIndex + 2, "worker " + to_string (workerIndex));
+}
+
+struct QueuedFile
+{
+    string file;
+    bool isInMemory;
+    string contents;
+    // Zero if the file can not be read
+    uint64_t size;
+
+    bool wasDeferred, wasPrefetched;
+    unsigned nAttempts;
+};
+
+class GrabbingCoordinator
+{
+public :
+    explicit GrabbingCoordinator (const IniConfiguration& project);
+
+    void enqueue (const string& file, bool isInMemory, const string& contents);
+    void run();
+
+private :
+    const IniConfiguration& project;
+
+    deque <QueuedFile> queue;
+    uint64_t memoryBudget;
+
+    unsigned nWorkers, nRetries;
+    // Created before workers are forked: shared by them
+    unique_ptr <HeaderRegistry> headerRegistry;
+    unique_ptr <WorkerPool> pool;
+    map <unsigned, QueuedFile> runningFiles;
+    unsigned nextTaskId;
+
+    // The prediction: the largest memory peak per source byte seen so far.
+    // The first file is not counted: libraries load & initialize on their first use, which is not a per-file cost.
+    double bytesPerSourceByte;
+    unsigned nFilesMeasured;
+
+    FileGrabReport largestReport;
+    string largestFile;
+
+    // Summaries of the files grabbed are merged as they come: one is kept whatever the number of files
+    StyleStatistics statistics;
+
+    bool fitsMemoryBudget (QueuedFile& queuedFile);
+    void prefetchQueuedFiles();
+    void grabInProcess (const QueuedFile& queuedFile);
+    void handleWorkerResult (const WorkerPool::Result& result);
+    void recordReport (const string& file, const FileGrabReport& report, uint64_t memoryBefore);
+    void reportStatistics();
+};
+
+GrabbingCoordinator::GrabbingCoordinator (const IniConfiguration& project) :
+    project (project), memoryBudget (0), nWorkers (0), nRetries (1), nextTaskId (0), bytesPerSourceByte (0),
+    nFilesMeasured (0), largestReport (FileGrabReport())
+{
+    // Megabytes a grabbing process may use, files predicted to need more are deferred or rejected
+    if (project[saIniKey ("datagrabbing.memorybudget")].isDefined())
+        memoryBudget = static_cast <uint64_t> (project[saIniKey ("datagrabbing.memorybudget")].asInteger()) << 20;
+
+    if (project[saIniKey ("datagrabbing.workers")].isDefined())
+        nWorkers = static_cast <unsigned> (max (project[saIniKey ("datagrabbing.workers")].asInteger(), 0));
+
+    if (project[saIniKey ("datagrabbing.workerretries")].isDefined())
+        nRetries = static_cast <unsigned> (max (project[saIniKey ("datagrabbing.workerretries")].asInteger(), 0));
+
+    if (!project[saIniKey ("datagrabbing.grabheaders")].isDefined() ||
+        project[saIniKey ("datagrabbing.grabheaders")].asBoolean())
+        headerRegistry.reset (new HeaderRegistry);
+
+    // Read by files with handles: a missing property is reported by name here. Workers read the configuration too,
+    // every key is known here, then unused keys are reported correctly.
+    project[saIniKey ("datagrabbing.commonclangoptions")].asVector();
+    project[saIniKey ("datagrabbing.astcachedirectory")].isDefined();
+
+    if (nWorkers > 0)
+    {
+        int timeout = 600;
+        if (project[saIniKey ("datagrabbing.workertimeout")].isDefined())
+            timeout = max (project[saIniKey ("datagrabbing.workertimeout")].asInteger(), 1);
+
+        HeaderRegistry* registry = headerRegistry.get();
+        WorkerPool::TaskHandler grabInWorker = [&project, registry] (const string& task)
+        {
+            MemoryOutputStream context;
+            StyleStatistics statistics;
+            FileGrabReport report = grabTask (project, task, &context, registry, &statistics);
+            return encodeGrabResult (report, statistics, TraceRecorder::instance().exportEvents(), context.getContents());
+        };
+
+        saLog ("Starting %1 grabbing workers") << nWorkers;
+        pool.reset (new WorkerPool (nWorkers, grabInWorker, startGrabbingWorker, chrono::seconds (timeout)));
+    }
+}
+
+void GrabbingCoordinator::enqueue (const string& file, bool isInMemory, const string& contents)
+{
+    FileStatus status = FileStatus();
+    if (isInMemory)
+        status.size = contents.length();
+    else if (!FileSystem::instance().getFileStatus (file, status))
+        status.size = 0;
+
+    queue.push_back (QueuedFile { file, isInMemory, contents, status.size, false, false, 0 });
+}
+
+void GrabbingCoordinator::run()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint64_t nFilesProcessedBefore = metrics::filesProcessed.get(), nFilesFailedBefore = metrics::filesFailed.get();
+    uint64_t nTokensBefore = metrics::tokensTokenized.get();
+
+    // Largest files first: the last files to finish are small ones, workers are busy until the end however skewed
+    // the sizes are. The tool process alone grabs files in the order given: a single process has nothing to balance
+    // & overlaps nothing but prefetching, its context file keeps the order of the project.
+    if (pool)
+        stable_sort (queue.begin(), queue.end(), [] (const QueuedFile& a, const QueuedFile& b) { return a.size > b.size; });
+
+    while (!queue.empty() || (pool && pool->getNumPendingTasks() > 0))
+    {
+        // Every worker gets a file & a next one, queued in the pool: a worker finishing a file starts the next one
+        // while the coordinator writes the context. Other files wait for results: predictions use the latest reports.
+        if (!queue.empty() && (!pool || pool->getNumPendingTasks() < 2 * nWorkers))
+        {
+            QueuedFile queuedFile = queue.front();
+            queue.pop_front();
+            prefetchQueuedFiles();
+
+            if (!fitsMemoryBudget (queuedFile))
+                continue;
+
+            if (!pool)
+            {
+                grabInProcess (queuedFile);
+                continue;
+            }
+
+            pool->submit (nextTaskId, encodeGrabTask (queuedFile.file, queuedFile.isInMemory, queuedFile.contents));
+            runningFiles[nextTaskId++] = move (queuedFile);
+            continue;
+        }
+
+        handleWorkerResult (pool->waitForResult());
+    }
+
+    if (pool && pool->getNumRestarts() > 0)
+        saLog ("Grabbing workers restarted %1 times") << pool->getNumRestarts();
+
+    if (!largestFile.empty())
+        saLog ("Largest memory peak: %1 KiB for file '%2' (%3 tokens), process RSS peak %4 KiB")
+            << largestReport.getPeakBytes() / 1024 << largestFile << largestReport.nTokens
+            << getPeakResidentBytes() / 1024;
+
+    double seconds = chrono::duration <double> (chrono::steady_clock::now() - start).count();
+    uint64_t nProcessed = metrics::filesProcessed.get() - nFilesProcessedBefore;
+    uint64_t nTokens = metrics::tokensTokenized.get() - nTokensBefore;
+    saLog ("Processed %1 files (%2 failed), %3 tokens in %4 s: %5 files/s, %6 tokens/s") << nProcessed
+        << metrics::filesFailed.get() - nFilesFailedBefore << nTokens << seconds
+        << (seconds > 0 ? static_cast <double> (nProcessed) / seconds : 0.0)
+        << (seconds > 0 ? static_cast <double> (nTokens) / seconds : 0.0);
+
+    reportStatistics();
+}
+
+bool GrabbingCoordinator::fitsMemoryBudget (QueuedFile& queuedFile)
+{
+    if (memoryBudget == 0 || bytesPerSourceByte <= 0)
+        return true;
+
+    uint64_t predictedBytes = static_cast <uint64_t> (static_cast <double> (queuedFile.size) * bytesPerSourceByte);
+
+    // A worker grabs one file at a time: the memory it holds is not known here, but it is not held by other files
+    uint64_t memoryInUse = pool ? 0 : getResidentBytes();
+    if (memoryInUse + predictedBytes <= memoryBudget)
+        return true;
+
+    // Memory held now may be released when the other files are done: the file is retried once after them
+    if (!pool && !queuedFile.wasDeferred && predictedBytes <= memoryBudget)
+    {
+        saLog ("File '%1' is deferred: it needs about %2 MiB, memory budget is %3 MiB") << queuedFile.file
+            << (predictedBytes >> 20) << (memoryBudget >> 20);
+        queuedFile.wasDeferred = true;
+        queue.push_back (queuedFile);
+        return false;
+    }
+
+    saError ("File '%1' is rejected: it needs about %2 MiB, memory budget is %3 MiB") << queuedFile.file
+        << (predictedBytes >> 20) << (memoryBudget >> 20);
+    metrics::filesFailed.add();
+    return false;
+}
+
+void GrabbingCoordinator::prefetchQueuedFiles()
+{
+    // Files next in the queue are read by the system while the current ones are parsed: one per process grabbing
+    for (size_t i = 0; i < queue.size() && i < max (nWorkers, 1u); i++)
+    {
+        QueuedFile& queuedFile = queue[i];
+        if (!queuedFile.isInMemory && !queuedFile.wasPrefetched)
+        {
+            FileSystem::instance().prefetchFile (queuedFile.file);
+            queuedFile.wasPrefetched = true;
+        }
+    }
+}
+
+void GrabbingCoordinator::grabInProcess (const QueuedFile& queuedFile)
+{
+    const string& file = queuedFile.file;
+    uint64_t residentBytesBefore = getResidentBytes();
+    FileGrabReport report = FileGrabReport();
+
+    try
+    {
+        unique_ptr <IOutputStream> contextStream = openContextFile (project);
+        if (queuedFile.isInMemory)
+            report = grabDataFromSource (project, file, queuedFile.contents, contextStream.get(), headerRegistry.get(),
+                                         &statistics);
+        else
+            report = grabDataFromFile (project, file, contextStream.get(), headerRegistry.get(), &statistics);
+    }
+    catch (...)
+    {
+        metrics::filesFailed.add();
+        throw;
+    }
+
+    recordReport (file, report, residentBytesBefore);
+}
+
+void GrabbingCoordinator::handleWorkerResult (const WorkerPool::Result& result)
+{
+    QueuedFile queuedFile = runningFiles[result.taskId];
+    runningFiles.erase (result.taskId);
+
+    switch (result.status)
+    {
+    case WorkerPool::Status::DONE :
+    {
+        string trace, context;
+        StyleStatistics fileStatistics;
+        FileGrabReport report = decodeGrabResult (result.output, fileStatistics, trace, context);
+        statistics.merge (fileStatistics);
+        TraceRecorder::instance().importEvents (trace);
+
+        {
+            saTraceScope ("Write context", "file", queuedFile.file);
+            unique_ptr <IOutputStream> contextStream = openContextFile (project);
+            contextStream->write (context.data(), static_cast <uint32_t> (context.length()));
+        }
+
+        recordReport (queuedFile.file, report, 0);
+        return;
+    }
+
+    case WorkerPool::Status::FAILED :
+        saError ("Grabbing failed for file '%1':\n%2") << queuedFile.file << result.output;
+        metrics::filesFailed.add();
+        return;
+
+    case WorkerPool::Status::CRASHED :
+    case WorkerPool::Status::TIMED_OUT :
+        if (queuedFile.nAttempts < nRetries)
+        {
+            saLog ("Grabbing worker failed on file '%1' (%2), the file is retried") << queuedFile.file << result.output;
+            queuedFile.nAttempts++;
+            queue.push_back (queuedFile);
+            return;
+        }
+
+        saError ("File '%1' is skipped: grabbing worker failed on it (%2)") << queuedFile.file << result.output;
+        metrics::filesFailed.add();
+        return;
+    }
+}
+
+void GrabbingCoordinator::recordReport (const string& file, const FileGrabReport& report, uint64_t memoryBefore)
+{
+    metrics::filesProcessed.add();
+    metrics::tokensTokenized.add (report.nTokens);
+    metrics::headersProcessed.add (report.nHeaders);
+    metrics::contextBytesWritten.add (report.contextBytes);
+    metrics::parseSeconds.observe (report.parseSeconds);
+    if (report.astCacheLookup == FileGrabReport::AstCacheLookup::HIT)
+        metrics::astCacheHits.add();
+    else if (report.astCacheLookup == FileGrabReport::AstCacheLookup::MISS)
+        metrics::astCacheMisses.add();
+
+    saLog ("File '%1': %2 tokens, %3 context bytes, heap peak %4 KiB, RSS growth %5 KiB") << file << report.nTokens
+        << report.contextBytes << report.peakHeapBytes / 1024 << report.residentGrowthBytes / 1024;
+    if (report.nHeaders > 0)
+        saLog ("File '%1': %2 headers grabbed with it") << file << report.nHeaders;
+
+    if (nFilesMeasured++ > 0 && report.sourceBytes > 0)
+        bytesPerSourceByte = max (bytesPerSourceByte, static_cast <double> (report.getPeakBytes()) /
+                                                      static_cast <double> (report.sourceBytes));
+
+    if (memoryBudget > 0 && memoryBefore + report.getPeakBytes() > memoryBudget)
+        saLog ("Warning: file '%1' exceeded the memory budget: %2 MiB used") << file
+            << ((memoryBefore + report.getPeakBytes()) >> 20);
+
+    if (largestFile.empty() || report.getPeakBytes() > largestReport.getPeakBytes())
+    {
+        largestReport = report;
+        largestFile = file;
+    }
+}
+
+void GrabbingCoordinator::reportStatistics()
+{
+    bool isStatisticsFileSet = project[saIniKey ("datagrabbing.statisticsfilename")].isDefined();
+    if (statistics.getFeatures().nFiles == 0)
+        return;
+
+    const StyleFeatures& features = statistics.getFeatures();
+    StyleRules rules = statistics.inferRules (StyleRules::load (project));
+    saLog ("Project style of %1 files: indent width %2, type names %3, function names %4, variable names %5")
+        << features.nFiles << rules.indentWidth << getNamingStyleName (rules.typeNames)
+        << getNamingStyleName (rules.functionNames) << getNamingStyleName (rules.variableNames);
+    saLog ("Project features: %1 lines, %2 indented with tabs, %3 ending with spaces") << features.nLines
+        << features.nTabIndentedLines << features.nTrailingSpaceLines;
+
+    if (isStatisticsFileSet)
+    {
+        unique_ptr <FileOutputStream> stream = FileOutputStream::openOutputStream (
+            project[saIniKey ("datagrabbing.statisticsfilename")].asString(), RelativeOutputStreamFlags::BINARY);
+        statistics.save (stream.get());
+    }
+}
+
+}
+
+FileGrabReport sa::grabDataFromFile (const IniConfiguration& project, const string& file, IOutputStream* contextStream,
+                                     HeaderRegistry* headerRegistry, StyleStatistics* statistics)
+{
+    string contents;
+    {
+        saTraceScope ("Read source", "file", file);
+        unique_ptr <UniversalInputStream> stream = UniversalInputStream::openInputStream (file, RelativeInputStreamFlags::NONE);
+        contents.resize (stream->getNumBytesRemaining());
+        // A short read would pass a truncated source for the whole file
+        if (stream->read (&contents[0], static_cast <uint32_t> (contents.length())) != contents.length())
+            throw InputOutputException (__ORIGIN__, "text input stream created on '" + file + "'", "Reading the whole file");
+    }
+
+    return grabDataFromSource (project, file, contents, contextStream, headerRegistry, statistics);
+}
+
+FileGrabReport sa::grabDataFromSource (const IniConfiguration& project, const string& file, const string& contents,
+                                       IOutputStream* contextStream, HeaderRegistry* headerRegistry,
+                                       StyleStatistics* statistics)
+{
+    saTraceScope ("Grab data from file", "file", file);
+    saLog ("Grabbing data from file '%1'...") << file;
+
+    resetPeakLiveHeapBytes();
+    uint64_t heapBytesBefore = getLiveHeapBytes();
+    uint64_t residentBytesBefore = getResidentBytes(), peakResidentBytes = residentBytesBefore;
+
+    // Keys are resolved once per file, reads are indexing
+    const vector <string>& compilerCommandLineOptions =
+        project[project.findHandle (saIniKey ("datagrabbing.commonclangoptions"))].asVector();
+    IniPropertyHandle astCacheDirectory = project.findHandle (saIniKey ("datagrabbing.astcachedirectory"));
+
+    GrabbingSession& session = getGrabbingSession();
+    session.arena.reset();
+
+    // libclang reads the buffer instead of the file: both the unit & the context are made from the same text
+    vector <CXUnsavedFile> unsavedFiles = { CXUnsavedFile { file.c_str(), contents.data(), contents.length() } };
+
+    unique_ptr <AstCache> astCache;
+    if (project[astCacheDirectory].isDefined())
+        astCache.reset (new AstCache (project[astCacheDirectory].asString(), compilerCommandLineOptions));
+
+    ClangTranslationUnit unit (nullptr);
+    bool isUnitCached = false;
+    double parseSeconds = 0;
+    {
+        saTraceScope ("Parse translation unit", "file", file);
+        chrono::steady_clock::time_point parseStart = chrono::steady_clock::now();
+        if (astCache)
+        {
+            unit = astCache->load (session.index, file, contents);
+            isUnitCached = unit != nullptr;
+        }
+
+        if (!isUnitCached)
+            unit = session.index.parseTranslationUnit (file, compilerCommandLineOptions, CXTranslationUnit_None,
+                                                       unsavedFiles);
+        parseSeconds = chrono::duration <double> (chrono::steady_clock::now() - parseStart).count();
+    }
+    peakResidentBytes = max (peakResidentBytes, logMemoryUsage ("parsing"));
+
+    if (!unit)
+        saError ("Translation unit not created, see stderr for more info");
+
+    if (unit)
+    {
+        // Names of the source & of the headers it includes, in a single pass
+        saTraceScope ("Collect names", "file", file);
+        session.nameCollector.collect (unit);
+    }
+
+    int nDiagnostics = unit.getNumDiagnostics();
+    bool wereErrors = false;
+
+    {
+        saTraceScope ("Format diagnostics", "file", file);
+        for (int i = 0; i < nDiagnostics; i++)
+        {
+            ClangDiagnostic diag = unit.getDiagnostic (i);
+            if (diag.getSeverity() == CXDiagnostic_Error || diag.getSeverity() == CXDiagnostic_Fatal)
+                wereErrors = true;
+
+            saLog ("%1") << diag.formatDiagnostic (clang_defaultDiagnosticDisplayOptions());
+        }
+    }
+    peakResidentBytes = max (peakResidentBytes, logMemoryUsage ("diagnostics"));
+
+    if (wereErrors)
+        saError ("There were errors in a translation unit: grabbing impossible");
+
+    saLog ("Translation unit parsed successfully");
+
+    if (astCache && !isUnitCached && !wereErrors)
+    {
+        saTraceScope ("Save AST", "file", file);
+        astCache->save (unit, file, contents);
+    }
+
+    unique_ptr <FileContext> fileContext = FileContext::create (unit, contents, &session.nameCollector, &session.arena);
+    saAssert (fileContext);
+    peakResidentBytes = max (peakResidentBytes, logMemoryUsage ("file context creation"));
+
+    if (statistics)
+        statistics->addFile (*fileContext);
+
+    FileGrabReport report = FileGrabReport { contents.length(), fileContext->getIndentationContext()->getNumTokens(), 0,
+                                             0, 0, 0, parseSeconds, FileGrabReport::AstCacheLookup::NONE };
+    if (astCache)
+        report.astCacheLookup = isUnitCached ? FileGrabReport::AstCacheLookup::HIT : FileGrabReport::AstCacheLookup::MISS;
+    CountingOutputStream countingStream (contextStream);
+
+    // Header contexts are written one by one next to the source context: a single one is in memory at a time
+    if (headerRegistry && !wereErrors)
+    {
+        report.nTokens += grabHeaders (unit, *headerRegistry, session.nameCollector, session.headerArena, statistics,
+                                       &countingStream, report.nHeaders);
+        peakResidentBytes = max (peakResidentBytes, logMemoryUsage ("header contexts"));
+    }
+
+    // Headers not grabbed here would keep their names for as long as the process runs
+    session.nameCollector.dropDeclarations();
+
+    // The context does not refer to the unit: its memory is given back before the context is written
+    unit.dispose();
+    logMemoryUsage ("translation unit disposal");
+
+    saLog ("File context is ready to be serialized");
+
+    {
+        saTraceScope ("Write context", "file", file);
+        fileContext->save (&countingStream);
+        report.contextBytes = countingStream.getNumBytesWritten();
+    }
+    peakResidentBytes = max (peakResidentBytes, logMemoryUsage ("context writing"));
+    saLog ("Arena: %1 KiB used, %2 KiB in blocks") << session.arena.getNumBytesUsed() / 1024
+        << session.arena.getNumBytesReserved() / 1024;
+
+    uint64_t peakHeapBytes = getPeakLiveHeapBytes();
+    report.peakHeapBytes = peakHeapBytes > heapBytesBefore ? peakHeapBytes - heapBytesBefore : 0;
+    report.residentGrowthBytes = peakResidentBytes - residentBytesBefore;
+
+    saLog ("Data grabbing finished for file '%1'") << file;
+    return report;
+}
+
+void sa::grabProjectData (const IniConfiguration& project)
+{
+    IniProperty::Accessor filesProperty = project[saIniKey ("datagrabbing.files")];
+    const vector <string>& files = filesProperty.asVector();
+    saLog ("Grabbing from files: %1") << files;
+
+    GrabbingCoordinator coordinator (project);
+    for (unsigned i = 0; i < files.size(); i++)
+        coordinator.enqueue (filesProperty.resolveRelativePath (i, files[i]), false, string());
+    coordinator.run();
+}
+
+void sa::grabProjectData (const IniConfiguration& project, const string& fileName, const string& contents)
+{
+    saLog ("Grabbing from in-memory source '%1' (%2 bytes)") << fileName << contents.length();
+
+    GrabbingCoordinator coordinator (project);
+    coordinator.enqueue (fileName, true, contents);
+    coordinator.run();
+}
@@ -0,0 +1,89 @@
+#ifndef STYLE_ANALYZER_DATA_GRABBING_H
+#define STYLE_ANALYZER_DATA_GRABBING_H
+
+/* Data grabbing: project files are parsed by libclang, their file contexts are appended to the context file.
+
+   Files are grabbed in the tool process or, if 'Workers' is set in the [dataGrabbing] section, in pre-forked worker
+   processes (see WorkerPool.h), which send serialized contexts back to the coordinator writing the context file:
+   - a worker crash or hang (longer than 'WorkerTimeout' seconds, 600 by default) kills the worker only: it is restarted,
+     the file is retried 'WorkerRetries' times (1 by default), then skipped
+   - an exception while grabbing (i. e. the file can not be read) skips the file
+   - contexts are written in the order files are finished; files are grabbed largest first, every worker has a next one
+     queued & files next in the queue are prefetched from the disk while the current ones are parsed
+   - every worker logs into its own 'application-log-worker<index>'
+
+   A source is read once: the tool reads the file (or takes the text given in memory, i. e. from stdin), libclang gets it
+   as an unsaved file & the file context keeps the same text. In-memory sources never touch the disk, their names are
+   used by libclang to resolve relative includes & in the context.
+   Parsed units may be cached, see AstCache.h.
+
+   Headers: project headers included by a source (system headers excepted) get file contexts of their own, written
+   before the source one. Every header is grabbed once by all processes, see HeaderRegistry.h; 'GrabHeaders = "false"'
+   disables it.
+
+   Style statistics: every file & header grabbed is summarized (see StyleStatistics.h), workers send the summaries with
+   the contexts. The coordinator merges them as they come & logs the project style inferred from the merged summary;
+   'StatisticsFileName' in the [dataGrabbing] section saves the summary as well.
+
+   Memory: every file is reported (tokens, context bytes, heap & RSS peaks, see MemoryAccounting.h);
+   'MemoryBudget' (megabytes) makes files predicted to need more memory deferred or rejected. The budget applies
+   to every process grabbing files: the tool process, or every worker.
+*/
+
+#include <string>
+
+#include "HeaderRegistry.h"
+#include "IniConfiguration.h"
+#include "Streams.h"
+#include "StyleStatistics.h"
+
+namespace sa
+{
+
+using std::string;
+
+// Memory used while a file was grabbed, counted above the memory in use before the file.
+// Libraries with their own allocators are seen by resident set samples only (taken after every stage).
+struct FileGrabReport
+{
+    enum class AstCacheLookup : uint8_t
+    {
+        NONE,
+        HIT,
+        MISS
+    };
+
+    uint64_t sourceBytes;
+    // Headers included: tokens count theirs as well
+    uint32_t nTokens, nHeaders;
+    uint64_t contextBytes;
+    uint64_t peakHeapBytes, residentGrowthBytes;
+    double parseSeconds;
+    // Counted by the process writing the context: workers' metrics are never reported
+    AstCacheLookup astCacheLookup;
+
+    uint64_t getPeakBytes() const
+    {
+        return peakHeapBytes > residentGrowthBytes ? peakHeapBytes : residentGrowthBytes;
+    }
+};
+
+// Parses the source text named fileName & writes its context into the stream, then contexts of the headers
+// claimed in the registry (none without a registry). The source & the headers are counted in the statistics, if any.
+FileGrabReport grabDataFromSource (const IniConfiguration& project, const string& fileName, const string& contents,
+                                   IOutputStream* contextStream, HeaderRegistry* headerRegistry = nullptr,
+                                   StyleStatistics* statistics = nullptr);
+
+// Reads the file & grabs it
+FileGrabReport grabDataFromFile (const IniConfiguration& project, const string& file, IOutputStream* contextStream,
+                                 HeaderRegistry* headerRegistry = nullptr, StyleStatistics* statistics = nullptr);
+
+// Grabs all files of dataGrabbing.Files, appending their contexts to the context file
+void grabProjectData (const IniConfiguration& project);
+
+// Grabs the in-memory source instead of dataGrabbing.Files
+void grabProjectData (const IniConfiguration& project, const string& fileName, const string& contents);
+
+}
+
+#endif // STYLE_ANALYZER_DATA_GRABBING_H
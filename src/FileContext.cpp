@@ -1,6 +1,7 @@
 #include "FileContext.h"
 #include "FileStreams.h"
 #include "ApplicationLog.h"
+#include "Trace.h"
 
 using namespace sa;
 using namespace std;
@@ -18,7 +19,6 @@ string convertClangString (CXString clangString, bool assertNonNull = true)
 unique_ptr <FileContext> FileContext::create (CXTranslationUnit unit)
 {
     string sourceFileName = convertClangString (clang_getTranslationUnitSpelling (unit));
-    saLog ("Translation unit corresponds to file '%1'") << sourceFileName;
 
     unique_ptr <UniversalInputStream> stream
         = UniversalInputStream::openInputStream (sourceFileName, RelativeInputStreamFlags::NONE);
@@ -26,23 +26,74 @@ unique_ptr <FileContext> FileContext::create (CXTranslationUnit unit)
     unique_ptr <char[]> fileContentsBuffer (new char[fileSize + 1]);
     fileContentsBuffer[fileSize] = 0;
     stream->read (fileContentsBuffer.get(), fileSize);
+    saLog ("Read file '%1'") << sourceFileName;
 
-    unique_ptr <FileContext> context (new FileContext (string (fileContentsBuffer.get()), sourceFileName));
-    saLog ("Read file and created file context.");
+    return create (unit, string (fileContentsBuffer.get()));
+}
+
+unique_ptr <FileContext> FileContext::create (CXTranslationUnit unit, string fileContents, NameCollector* nameCollector,
+                                              Arena* arena)
+{
+    string sourceFileName = convertClangString (clang_getTranslationUnitSpelling (unit));
+    saLog ("Translation unit corresponds to file '%1'") << sourceFileName;
+
+    CXFile file = clang_getFile (unit, sourceFileName.c_str());
+    saAssert (file);
+    return create (unit, file, sourceFileName, move (fileContents), nameCollector, arena);
+}
+
+unique_ptr <FileContext> FileContext::create (CXTranslationUnit unit, CXFile file, string fileName, string fileContents,
+                                              NameCollector* nameCollector, Arena* arena)
+{
+    unique_ptr <FileContext> context (new FileContext (move (fileContents), fileName, arena));
+    saLog ("Created file context.");
 
     saLog ("Ready to create indentation subcontext");
-    context->indentationContext = IndentationContext::create (*context, unit);
+    {
+        saTraceScope ("Create indentation context", "file", fileName);
+        context->indentationContext = IndentationContext::create (*context, unit, file);
+    }
     saLog ("Indentation subcontext created");
 
     saLog ("Ready to create name subcontext");
-    context->nameContext = NameContext::create (unit);
+    {
+        saTraceScope ("Create name context", "file", fileName);
+        context->nameContext = nameCollector ? NameContext::create (nameCollector->takeDeclarations (fileName)) :
+                                               NameContext::create (unit, file);
+    }
     saLog ("Name subcontext created");
 
     return context;
 }
 
+void sa::FileContext::editContents (uint32_t offset, uint32_t nRemovedBytes, const string& insertedText)
+{
+    if (offset > fileContents.length() || nRemovedBytes > fileContents.length() - offset)
+        throw InvalidArgumentException (__ORIGIN__, "Edit of " + toString (nRemovedBytes) + " bytes at offset " +
+                                        toString (offset) + " is out of file '" + fileName + "'", "offset");
+
+    fileContents.replace (offset, nRemovedBytes, insertedText);
+}
+
+void sa::FileContext::updateSubcontexts (CXTranslationUnit unit, uint32_t offset, uint32_t nRemovedBytes,
+                                         uint32_t nInsertedBytes)
+{
+    {
+        saTraceScope ("Update indentation context", "file", fileName);
+        indentationContext->update (*this, unit, offset, nRemovedBytes, nInsertedBytes);
+    }
+
+    // Names are collected again by a walk over all cursors of the unit: unlike the indentation update, its time grows
+    // with the file (see docs/utility-subsystems.txt)
+    {
+        saTraceScope ("Update name context", "file", fileName);
+        nameContext = NameContext::create (unit, clang_getFile (unit, fileName.c_str()));
+    }
+}
+
 void sa::FileContext::save (IOutputStream* stream)
 {
+    saTraceScope ("Save file context", "file", fileName);
     serializeString (stream, fileName);
     serializeString (stream, fileContents);
 
@@ -55,10 +106,10 @@ string sa::deserializeString (IInputStream* stream)
     uint32_t length;
     saVerify (stream->read (reinterpret_cast <char*> (&length), 4) == 4);
 
-    unique_ptr <char[]> contents (new char[length + 1]);
-    saVerify (stream->read (contents.get(), length) == length);
+    string result (length, 0);
+    if (length > 0)
+        saVerify (stream->read (&result[0], length) == length);
 
-    string result = contents.get();
     return result;
 }
 
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <memory>
 
+#include "Arena.h"
 #include "IndentationContext.h"
 #include "NameContext.h"
 #include "Streams.h"
@@ -39,10 +40,33 @@ public :
         return nameContext.get();
     }
 
+    // Subcontexts allocate from it; null for the heap
+    Arena* getArena() const
+    {
+        return arena;
+    }
+
+    // Replaces nRemovedBytes at offset with the text: subcontexts are updated once the unit is reparsed
+    void editContents (uint32_t offset, uint32_t nRemovedBytes, const string& insertedText);
+
+    // The unit is reparsed with the contents edited: updates subcontexts around the edit
+    void updateSubcontexts (CXTranslationUnit unit, uint32_t offset, uint32_t nRemovedBytes, uint32_t nInsertedBytes);
+
     void save (IOutputStream* stream);
     static unique_ptr <FileContext> load (IInputStream* stream);
+    // Reads the translation unit source file
     static unique_ptr <FileContext> create (CXTranslationUnit unit);
 
+    // The source the unit was parsed from (i. e. an unsaved file): nothing is read again.
+    // Names are taken from the collector which parsed the unit, if any, or collected from the unit.
+    // The context must be destroyed before the arena is reset, see Arena.h.
+    static unique_ptr <FileContext> create (CXTranslationUnit unit, string fileContents,
+                                            NameCollector* nameCollector = nullptr, Arena* arena = nullptr);
+
+    // A file of the unit, the source or a header, with the text the unit was made of
+    static unique_ptr <FileContext> create (CXTranslationUnit unit, CXFile file, string fileName, string fileContents,
+                                            NameCollector* nameCollector = nullptr, Arena* arena = nullptr);
+
 private :
 
     FileContext (const FileContext&) = delete;
@@ -50,12 +74,13 @@ private :
 
     string fileContents;
     string fileName;
+    Arena* arena;
 
     unique_ptr <IndentationContext> indentationContext;
     unique_ptr <NameContext> nameContext;
 
-    FileContext (string fileContents, string fileName) :
-        fileContents (fileContents), fileName (fileName)
+    FileContext (string fileContents, string fileName, Arena* arena) :
+        fileContents (std::move (fileContents)), fileName (fileName), arena (arena)
     {}
 };
 
@@ -48,7 +48,8 @@ uint32_t UniversalInputStream::read (char* buffer, uint32_t nBytes)
     if (isBroken) return 0;
 
     uint32_t nRead = min (nBytes, getNumBytesRemaining());
-    memcpy (buffer, fileContents.get(), nRead);
+    memcpy (buffer, fileContents.get() + bufferPosition, nRead);
+    bufferPosition += nRead;
     return nRead;
 }
 
@@ -116,7 +117,7 @@ FileOutputStream::FileOutputStream (string fileName, bool isBinaryStream) :
 
 FileOutputStream::~FileOutputStream()
 {
-    if (file)
+    if (file && file != stdout)
         fclose (file);
 }
 
@@ -145,6 +146,7 @@ unique_ptr <FileOutputStream> FileOutputStream::openOutputStream (string fileNam
 {
     bool binary = extractFlag (flags, RelativeOutputStreamFlags::BINARY);
     bool append = extractFlag (flags, RelativeOutputStreamFlags::APPEND);
+    bool unbuffered = extractFlag (flags, RelativeOutputStreamFlags::UNBUFFERED);
 
     if (uint32_t (flags))
         throw InvalidArgumentException (__ORIGIN__,
@@ -158,5 +160,27 @@ unique_ptr <FileOutputStream> FileOutputStream::openOutputStream (string fileNam
     if (!(stream->file = fopen (fileName.c_str(), mode)))
         stream->ioError (__ORIGIN__, "create (fopen)");
 
+    if (unbuffered && setvbuf (stream->file, nullptr, _IONBF, 0) != 0)
+        stream->ioError (__ORIGIN__, "create (setvbuf)");
+
+    return stream;
+}
+
+unique_ptr <FileOutputStream> FileOutputStream::openStandardOutput()
+{
+    unique_ptr <FileOutputStream> stream (new FileOutputStream ("<stdout>", true));
+    stream->file = stdout;
+
+    if (setvbuf (stdout, nullptr, _IONBF, 0) != 0)
+        stream->ioError (__ORIGIN__, "create (setvbuf)");
+
     return stream;
 }
+
+MemoryOutputStream::~MemoryOutputStream()
+{}
+
+void MemoryOutputStream::write (const char* data, uint32_t nBytes)
+{
+    contents.append (data, nBytes);
+}
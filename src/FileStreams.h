@@ -50,6 +50,9 @@ public :
 
     static unique_ptr <FileOutputStream> openOutputStream (string fileName, RelativeOutputStreamFlags flags);
 
+    // Unbuffered binary stdout (i. e. for a protocol over it), left open when the stream is destroyed
+    static unique_ptr <FileOutputStream> openStandardOutput();
+
 private :
     FileOutputStream (const FileOutputStream&) = delete;
     FileOutputStream& operator= (const FileOutputStream&) = delete;
@@ -65,6 +68,27 @@ private :
     ATTRIBUTE_NORETURN void ioError (const char* fileOrigin, int lineOrigin, const char* functionOrigin, string operation);
 };
 
+// Collects everything written in memory (i. e. to send it elsewhere at once)
+class MemoryOutputStream : public IOutputStream
+{
+public :
+    MemoryOutputStream() = default;
+    ~MemoryOutputStream();
+
+    void write (const char* data, uint32_t nBytes);
+
+    const string& getContents() const
+    {
+        return contents;
+    }
+
+private :
+    MemoryOutputStream (const MemoryOutputStream&) = delete;
+    MemoryOutputStream& operator= (const MemoryOutputStream&) = delete;
+
+    string contents;
+};
+
 }
 
 #endif // STYLE_ANALYZER_FILE_STREAMS_H
@@ -1,6 +1,9 @@
 #include "FileSystem.h"
 #include <boost/filesystem.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 sa::IFileSystem::~IFileSystem() {}
 
 sa::FileSystem::~FileSystem() {}
@@ -62,6 +65,37 @@ std::string sa::FileSystem::getDirectoryPath (std::string absoluteOrRelativePath
     return boost::filesystem::canonical (boost::filesystem::path (absoluteOrRelativePath).parent_path()).string();
 }
 
+bool sa::FileSystem::getFileStatus (std::string absoluteOrRelativePath, FileStatus& status)
+{
+    boost::filesystem::path path (absoluteOrRelativePath);
+    boost::system::error_code error;
+
+    std::time_t modificationTime = boost::filesystem::last_write_time (path, error);
+    if (error)
+        return false;
+
+    boost::uintmax_t size = boost::filesystem::file_size (path, error);
+    if (error)
+        return false;
+
+    status.modificationTime = static_cast <long long> (modificationTime);
+    status.size = static_cast <unsigned long long> (size);
+    return true;
+}
+
+void sa::FileSystem::prefetchFile (std::string absoluteOrRelativePath)
+{
+    // The readahead goes on after the descriptor is closed
+    int fd = open (absoluteOrRelativePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+    close (fd);
+}
+
 sa::IFileSystem& sa::FileSystem::instance()
 {
     if (overrideFilesystem)
@@ -10,6 +10,18 @@ namespace sa
 
 using namespace std;
 
+struct FileStatus
+{
+    // Seconds since epoch
+    long long modificationTime;
+    unsigned long long size;
+
+    bool operator== (const FileStatus& other) const
+    {
+        return modificationTime == other.modificationTime && size == other.size;
+    }
+};
+
 class IFileSystem
 {
 public :
@@ -27,6 +39,12 @@ public :
     virtual string getCanonicalPath (string absoluteOrRelativePath) = 0;
     virtual string appendPath (string directory, string relativePath) = 0;
     virtual string getDirectoryPath (string absoluteOrRelativePath) = 0;
+
+    // Returns false if the file does not exist
+    virtual bool getFileStatus (string absoluteOrRelativePath, FileStatus& status) = 0;
+
+    // A hint: the system may read the file into its cache in the background, errors are ignored
+    virtual void prefetchFile (string absoluteOrRelativePath) = 0;
 };
 
 class FileSystem : public IFileSystem
@@ -47,6 +65,10 @@ public :
     string appendPath (string directory, string relativePath);
     string getDirectoryPath (string absoluteOrRelativePath);
 
+    bool getFileStatus (string absoluteOrRelativePath, FileStatus& status);
+
+    void prefetchFile (string absoluteOrRelativePath);
+
     static IFileSystem& instance();
 
     // Caller owns the filesystem object
@@ -0,0 +1,47 @@
+#include "HeaderRegistry.h"
+#include "BinaryData.h"
+#include "Debug.h"
+
+#include <boost/interprocess/anonymous_shared_memory.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+using namespace sa;
+using namespace std;
+
+static_assert (ATOMIC_LLONG_LOCK_FREE == 2, "Slots shared by processes must be lock-free");
+
+sa::HeaderRegistry::HeaderRegistry (uint32_t capacity) :
+    slots (nullptr), mask (1)
+{
+    while (mask < capacity)
+        mask <<= 1;
+
+    // Zero filled: every slot is empty
+    region.reset (new boost::interprocess::mapped_region (
+        boost::interprocess::anonymous_shared_memory (sizeof (atomic <uint64_t>) * mask)));
+    slots = static_cast <atomic <uint64_t>*> (region->get_address());
+    mask--;
+}
+
+sa::HeaderRegistry::~HeaderRegistry()
+{}
+
+bool sa::HeaderRegistry::claim (const string& canonicalPath, const string& contents)
+{
+    // The path & the contents
+    uint64_t key = hashBytes (hashString (hashOffsetBasis, canonicalPath), contents.data(), contents.length());
+
+    // Zero marks empty slots
+    key = key ? key : 1;
+
+    for (uint32_t i = 0, position = static_cast <uint32_t> (key) & mask; i <= mask; i++, position = (position + 1) & mask)
+    {
+        uint64_t expected = 0;
+        if (slots[position].compare_exchange_strong (expected, key, memory_order_acq_rel, memory_order_acquire))
+            return true;
+        if (expected == key)
+            return false;
+    }
+
+    return true;
+}
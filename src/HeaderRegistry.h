@@ -0,0 +1,54 @@
+#ifndef STYLE_ANALYZER_HEADER_REGISTRY_H
+#define STYLE_ANALYZER_HEADER_REGISTRY_H
+
+/* Header registry: project headers found while grabbing are claimed, the process claiming a header grabs it.
+
+   A header is known by the hash of its canonical path & its contents: every version of a header gets one file context,
+   however many sources include it. The table lives in anonymous shared memory: a registry created before worker
+   processes are forked (see WorkerPool.h) is shared by all of them.
+   - claims are lock-free: compare & swap of 64-bit slots, open addressing
+   - a claim is never released: a header claimed by a worker which crashed before sending its contexts is not grabbed
+   - when the table is full, claims always succeed: headers may be grabbed more than once
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace boost
+{
+namespace interprocess
+{
+class mapped_region;
+}
+}
+
+namespace sa
+{
+
+using std::string;
+using std::unique_ptr;
+
+class HeaderRegistry
+{
+public :
+    // Capacity is rounded up to a power of two
+    explicit HeaderRegistry (uint32_t capacity = 1 << 18);
+    ~HeaderRegistry();
+
+    // Returns true if the header is claimed by the caller, false if it was claimed before
+    bool claim (const string& canonicalPath, const string& contents);
+
+private :
+    HeaderRegistry (const HeaderRegistry&) = delete;
+    HeaderRegistry& operator= (const HeaderRegistry&) = delete;
+
+    unique_ptr <boost::interprocess::mapped_region> region;
+    std::atomic <uint64_t>* slots;
+    uint32_t mask;
+};
+
+}
+
+#endif // STYLE_ANALYZER_HEADER_REGISTRY_H
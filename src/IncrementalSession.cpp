@@ -0,0 +1,60 @@
+#include "IncrementalSession.h"
+#include "ApplicationLog.h"
+#include "Trace.h"
+
+using namespace sa;
+using namespace std;
+
+string sa::IncrementalSessionException::toString() const
+{
+    return "Incremental session: " + reason;
+}
+
+sa::IncrementalSession::IncrementalSession (string fileName, string contents, vector <string> compilerOptions) :
+    fileName (fileName), compilerOptions (compilerOptions), index (false, false), unit (nullptr), isBroken (false)
+{
+    saTraceScope ("Start incremental session", "file", fileName);
+
+    vector <CXUnsavedFile> unsavedFiles = { CXUnsavedFile { this->fileName.c_str(), contents.data(), contents.length() } };
+    unit = index.parseTranslationUnit (fileName, compilerOptions, clang_defaultEditingTranslationUnitOptions(),
+                                       unsavedFiles);
+    if (!unit)
+        throw IncrementalSessionException (__ORIGIN__, "failed to parse '" + fileName + "'");
+
+    fileContext = FileContext::create (unit, contents);
+
+    // The preamble is precompiled on the first reparse: done here, not on the first edit
+    reparse();
+    saLog ("Incremental session for '%1' started") << fileName;
+}
+
+void sa::IncrementalSession::reparse()
+{
+    if (isBroken)
+        throw IncrementalSessionException (__ORIGIN__, "translation unit of '" + fileName + "' is lost after a failure");
+
+    saTraceScope ("Reparse translation unit", "file", fileName);
+
+    const string& contents = fileContext->getFileContents();
+    CXUnsavedFile unsavedFile = CXUnsavedFile { fileName.c_str(), contents.data(), contents.length() };
+
+    if (clang_reparseTranslationUnit (unit, 1, &unsavedFile, clang_defaultReparseOptions (unit)) != 0)
+    {
+        // libclang allows nothing but disposal of a unit failed to reparse
+        unit.dispose();
+        isBroken = true;
+        throw IncrementalSessionException (__ORIGIN__, "failed to reparse '" + fileName + "'");
+    }
+}
+
+void sa::IncrementalSession::applyEdit (uint32_t offset, uint32_t nRemovedBytes, const string& insertedText)
+{
+    fileContext->editContents (offset, nRemovedBytes, insertedText);
+    reparse();
+    fileContext->updateSubcontexts (unit, offset, nRemovedBytes, static_cast <uint32_t> (insertedText.length()));
+}
+
+void sa::IncrementalSession::setContents (const string& contents)
+{
+    applyEdit (0, static_cast <uint32_t> (fileContext->getFileContents().length()), contents);
+}
@@ -0,0 +1,85 @@
+#ifndef STYLE_ANALYZER_INCREMENTAL_SESSION_H
+#define STYLE_ANALYZER_INCREMENTAL_SESSION_H
+
+/* Incremental analysis of one source being edited (i. e. by an IDE plugin).
+
+   The session keeps the translation unit & the file context alive between edits. An edit replaces a byte range
+   of the source: the unit is reparsed with the new text as an unsaved file (the preamble, includes at the top
+   of the file, is precompiled once & reused), the indentation context gets the tokens around the edit only
+   (see IndentationContext::update). Nothing is read from disk but the includes.
+*/
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FileContext.h"
+#include "LibclangHelpers.h"
+
+namespace sa
+{
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+class IncrementalSessionException : public Exception
+{
+public :
+    IncrementalSessionException (const char* fileOrigin, int lineOrigin, const char* functionOrigin, string reason) :
+        Exception (fileOrigin, lineOrigin, functionOrigin, "Incremental session: " + reason),
+        reason (reason)
+    {}
+
+    string toString() const;
+
+private :
+    string reason;
+};
+
+class IncrementalSession
+{
+public :
+    IncrementalSession (string fileName, string contents, vector <string> compilerOptions);
+
+    // Replaces nRemovedBytes at offset with the text
+    void applyEdit (uint32_t offset, uint32_t nRemovedBytes, const string& insertedText);
+
+    // Replaces the whole source
+    void setContents (const string& contents);
+
+    const string& getFileName() const
+    {
+        return fileName;
+    }
+
+    FileContext& getFileContext()
+    {
+        return *fileContext;
+    }
+
+    ClangTranslationUnit& getTranslationUnit()
+    {
+        return unit;
+    }
+
+private :
+    IncrementalSession (const IncrementalSession&) = delete;
+    IncrementalSession& operator= (const IncrementalSession&) = delete;
+
+    string fileName;
+    vector <string> compilerOptions;
+
+    ClangIndex index;
+    ClangTranslationUnit unit;
+    unique_ptr <FileContext> fileContext;
+
+    // A failed reparse leaves the unit unusable
+    bool isBroken;
+
+    void reparse();
+};
+
+}
+
+#endif // STYLE_ANALYZER_INCREMENTAL_SESSION_H
@@ -3,6 +3,8 @@
 #include "ApplicationLog.h"
 #include "FileContext.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace sa;
 
@@ -14,79 +16,196 @@ unsigned getSourceLocationOffset (CXSourceLocation location)
     return offset;
 }
 
-unique_ptr <IndentationContext> IndentationContext::create (FileContext& fileContext, CXTranslationUnit unit)
+// Spaces before the next token: on its line only, if there is a newline
+static TokenInterval measureInterval (const string& fileContents, uint32_t beginOffset, uint32_t endOffset)
 {
-    unique_ptr <IndentationContext> context (new IndentationContext);
+    TokenInterval interval = TokenInterval { false, 0 };
+
+    for (uint32_t j = beginOffset; j < endOffset; j++)
+    {
+        if (fileContents[j] == ' ')
+        {
+            interval.nSpaces++;
+        }
+        else if (fileContents[j] == '\n')
+        {
+            interval.isAfterNewline = true;
+            interval.nSpaces = 0;
+        }
+    }
+
+    return interval;
+}
+
+unique_ptr <IndentationContext> IndentationContext::create (FileContext& fileContext, CXTranslationUnit unit, CXFile file)
+{
+    unique_ptr <IndentationContext> context (new IndentationContext (fileContext.getArena()));
+    context->fileContents = &fileContext.getFileContents();
+
+    context->tokenizeFile (unit, file, context->tokenStream);
+    context->measureIntervals (fileContext.getFileContents(), 0, context->getNumTokens());
+
+    return context;
+}
+
+void IndentationContext::update (FileContext& fileContext, CXTranslationUnit unit, uint32_t editOffset,
+                                 uint32_t nRemovedBytes, uint32_t nInsertedBytes)
+{
+    const string& fileContents = fileContext.getFileContents();
+    uint32_t removedEnd = editOffset + nRemovedBytes;
+
+    // Tokens touching the edit may change too (i. e. an identifier gets longer): they are tokenized again
+    auto firstChanged = lower_bound (tokenStream.begin(), tokenStream.end(), editOffset,
+                                     [] (const Token& token, uint32_t offset) { return token.fileBufferEndOffset < offset; });
+    auto firstUnchanged = upper_bound (firstChanged, tokenStream.end(), removedEnd,
+                                       [] (uint32_t offset, const Token& token) { return offset < token.fileBufferOffset; });
+
+    for (auto it = firstUnchanged; it != tokenStream.end(); it++)
+    {
+        it->fileBufferOffset = it->fileBufferOffset - nRemovedBytes + nInsertedBytes;
+        it->fileBufferEndOffset = it->fileBufferEndOffset - nRemovedBytes + nInsertedBytes;
+    }
+
+    // Lexing goes on from the last token kept up to the first one unchanged, inclusive: if it comes out the same,
+    // the edit has not changed tokens after it (i. e. by opening a comment)
+    uint32_t rangeBegin = firstChanged == tokenStream.begin() ? 0 : (firstChanged - 1)->fileBufferEndOffset;
+    uint32_t rangeEnd = firstUnchanged == tokenStream.end() ? static_cast <uint32_t> (fileContents.length()) :
+                                                              firstUnchanged->fileBufferEndOffset;
+
+    CXFile file = clang_getFile (unit, fileContext.getFileName().c_str());
+    saAssert (file);
+    CXSourceRange range = clang_getRange (clang_getLocationForOffset (unit, file, rangeBegin),
+                                          clang_getLocationForOffset (unit, file, rangeEnd));
+    TokenVector tokens (tokenStream.get_allocator());
+    tokenize (unit, range, rangeBegin, rangeEnd, tokens);
+
+    // Offsets of unchanged tokens are moved already: the same offsets are the same text
+    if (firstUnchanged != tokenStream.end())
+    {
+        if (tokens.empty() || tokens.back().fileBufferOffset != firstUnchanged->fileBufferOffset ||
+            tokens.back().fileBufferEndOffset != firstUnchanged->fileBufferEndOffset)
+        {
+            saLog ("Indentation context update: tokens after the edit changed, tokenizing the whole file");
+            tokenStream.clear();
+            tokenizeFile (unit, file, tokenStream);
+            measureIntervals (fileContents, 0, getNumTokens());
+            return;
+        }
+
+        tokens.pop_back();
+    }
+
+    uint32_t firstChangedIndex = static_cast <uint32_t> (firstChanged - tokenStream.begin());
+    uint32_t nReplaced = static_cast <uint32_t> (firstUnchanged - firstChanged);
+    saLog ("Indentation context update: %1 tokens replaced by %2 at token %3") << nReplaced << tokens.size()
+        << firstChangedIndex;
 
-    CXSourceRange range = clang_getCursorExtent (clang_getTranslationUnitCursor (unit));
+    tokenStream.erase (firstChanged, firstUnchanged);
+    tokenStream.insert (tokenStream.begin() + firstChangedIndex, tokens.begin(), tokens.end());
+
+    // The interval before the first new token changes as well
+    measureIntervals (fileContents, firstChangedIndex > 0 ? firstChangedIndex - 1 : 0,
+                      firstChangedIndex + static_cast <uint32_t> (tokens.size()));
+}
+
+uint32_t IndentationContext::findToken (uint32_t fileBufferOffset) const
+{
+    auto it = upper_bound (tokenStream.begin(), tokenStream.end(), fileBufferOffset,
+                           [] (uint32_t offset, const Token& token) { return offset < token.fileBufferEndOffset; });
+    return static_cast <uint32_t> (it - tokenStream.begin());
+}
+
+boost::string_ref IndentationContext::getTokenClassName (unsigned tokenIndex) const
+{
+    switch (tokenStream[tokenIndex].tokenKind)
+    {
+        case CXToken_Identifier: return "identifier";
+        case CXToken_Literal:    return "literal";
+        case CXToken_Comment:    return "comment";
+        case CXToken_Keyword:
+        case CXToken_Punctuation:
+            break;
+    }
+    return getTokenValue (tokenIndex);
+}
+
+void IndentationContext::tokenize (CXTranslationUnit unit, CXSourceRange range, uint32_t beginOffset, uint32_t endOffset,
+                                   TokenVector& result) const
+{
     CXToken* tokens;
     unsigned int nTokens;
     clang_tokenize (unit, range, &tokens, &nTokens);
 
-    string fileContents = fileContext.getFileContents();
-
-    //CXSourceLocation begin = clang_getRangeStart (range);
-
-    unsigned previousTokenNextCharacterOffset = 0;
-    unsigned lastLineSpaceLevel = 0;
+    result.reserve (result.size() + nTokens);
 
     for (unsigned i = 0; i < nTokens; i++)
     {
         CXToken token = tokens[i];
-        string spelling = convertCXString (clang_getTokenSpelling (unit, token));
-
-        CXSourceRange tokenRange = clang_getTokenExtent (unit, token);
-        CXSourceLocation tokenBegin = clang_getRangeStart (tokenRange);
-        CXSourceLocation tokenLastCharacter = clang_getRangeEnd (tokenRange);
 
-        unsigned beginOffset = getSourceLocationOffset (tokenBegin);
         // FIXME: UTF8 support (???, multi-byte in identifiers)
-        unsigned endOffset = getSourceLocationOffset (tokenLastCharacter) + 1;
+        CXSourceRange extent = clang_getTokenExtent (unit, token);
+        unsigned tokenBeginOffset = getSourceLocationOffset (clang_getRangeStart (extent));
+        unsigned tokenEndOffset = getSourceLocationOffset (clang_getRangeEnd (extent));
+
+        // The range may catch tokens around it
+        if (tokenBeginOffset < beginOffset || tokenEndOffset > endOffset)
+            continue;
+
+        saLog ("Token: '%1', kind: %2, offset: %3") << fileContents->substr (tokenBeginOffset,
+                                                                             tokenEndOffset - tokenBeginOffset)
+            << cxTokenKindToString (clang_getTokenKind (token)) << static_cast <int> (tokenBeginOffset);
+
+        Token tokenCopy = Token();
+        tokenCopy.fileBufferOffset = tokenBeginOffset;
+        tokenCopy.fileBufferEndOffset = tokenEndOffset;
+        tokenCopy.tokenKind = clang_getTokenKind (token);
+        result.push_back (tokenCopy);
+    }
 
-        saLog ("Token: '%1', kind: %2, offset: %3") << spelling << cxTokenKindToString (clang_getTokenKind (token))
-                                                    << static_cast <int> (beginOffset);
-        //clang_disposeString (spelling);
+    // Tokens keep offsets only: the context does not refer to the unit
+    clang_disposeTokens (unit, tokens, nTokens);
+}
 
-        Token tokenCopy;
-        tokenCopy.token = token;
-        tokenCopy.fileBufferOffset = beginOffset;
-        tokenCopy.tokenValue = spelling;
+void IndentationContext::tokenizeFile (CXTranslationUnit unit, CXFile file, TokenVector& result) const
+{
+    uint32_t fileLength = static_cast <uint32_t> (fileContents->length());
+    CXSourceRange range = clang_getRange (clang_getLocationForOffset (unit, file, 0),
+                                          clang_getLocationForOffset (unit, file, fileLength));
+    tokenize (unit, range, 0, fileLength, result);
+}
 
-        if (i > 0)
+void IndentationContext::measureIntervals (const string& fileContents, uint32_t firstToken, uint32_t firstUnchangedToken)
+{
+    // Newline intervals are relative to the previous line: find out its space level
+    uint32_t lastLineSpaceLevel = 0;
+    for (uint32_t i = firstToken; i > 0; i--)
+    {
+        const Token& previous = tokenStream[i - 1];
+        if (previous.afterTokenInterval.interval.isAfterNewline)
         {
-            unsigned spaceCounter = 0;
-            bool wasNewline = false;
-
-            for (unsigned j = previousTokenNextCharacterOffset; j < beginOffset; j++)
-            {
-                if (fileContents[j] == ' ')
-                {
-                    spaceCounter++;
-                }
-                else if (fileContents[j] == '\n')
-                {
-                    wasNewline = true;
-                    spaceCounter = 0;
-                }
-            }
-
-            if (wasNewline)
-            {
-                unsigned offset = spaceCounter - lastLineSpaceLevel;
-                lastLineSpaceLevel = spaceCounter;
-                spaceCounter = offset;
-            }
-
-            TokenInterval& lastTokenInterval = context->tokenStream.back().afterTokenInterval.interval;
-            lastTokenInterval.isAfterNewline = wasNewline;
-            lastTokenInterval.nSpaces = spaceCounter;
+            lastLineSpaceLevel = measureInterval (fileContents, previous.fileBufferEndOffset,
+                                                  tokenStream[i].fileBufferOffset).nSpaces;
+            break;
         }
-
-        context->tokenStream.push_back (tokenCopy);
-        previousTokenNextCharacterOffset = endOffset;
     }
 
-    return context;
+    // Intervals between unchanged tokens are the same but the first newline one: it is relative to a changed level
+    for (uint32_t i = firstToken; i + 1 < tokenStream.size(); i++)
+    {
+        TokenInterval interval = measureInterval (fileContents, tokenStream[i].fileBufferEndOffset,
+                                                  tokenStream[i + 1].fileBufferOffset);
+        if (interval.isAfterNewline)
+        {
+            uint32_t offset = interval.nSpaces - lastLineSpaceLevel;
+            lastLineSpaceLevel = interval.nSpaces;
+            interval.nSpaces = offset;
+        }
+
+        tokenStream[i].afterTokenInterval.interval = interval;
+
+        if (i >= firstUnchangedToken && interval.isAfterNewline)
+            break;
+    }
 }
 
 /*void IndentationContext::addInvisibleModifier (IndentationContext::Token& token, string modifierName)
@@ -7,8 +7,10 @@
 #include <cstdint>
 #include <map>
 
+#include <boost/utility/string_ref.hpp>
 #include <clang-c/Index.h>
 
+#include "Arena.h"
 #include "Streams.h"
 
 namespace sa
@@ -63,12 +65,51 @@ public :
     string getInvisibleModifierName (InvisibleModifierId id) const;
     string getTokenClassName (TokenClassId id) const;*/
 
+    uint32_t getNumTokens() const
+    {
+        return static_cast <uint32_t> (tokenStream.size());
+    }
+
+    uint32_t getTokenOffset (unsigned tokenIndex) const
+    {
+        return tokenStream[tokenIndex].fileBufferOffset;
+    }
+
+    // Tokens keep no text of their own: values are taken from the file contents
+    boost::string_ref getTokenValue (unsigned tokenIndex) const
+    {
+        const Token& token = tokenStream[tokenIndex];
+        return boost::string_ref (fileContents->data() + token.fileBufferOffset,
+                                  token.fileBufferEndOffset - token.fileBufferOffset);
+    }
+
+    // Keywords & punctuation are classes of their own, other tokens are "identifier", "literal" or "comment"
+    boost::string_ref getTokenClassName (unsigned tokenIndex) const;
+
+    // Spaces are relative to the previous line if the interval has a newline; nothing is before the first token
+    TokenInterval getIntervalBefore (unsigned tokenIndex) const
+    {
+        return tokenIndex > 0 ? tokenStream[tokenIndex - 1].afterTokenInterval.interval : TokenInterval { false, 0 };
+    }
+
+    // The first token ending after the offset (getNumTokens() if none)
+    uint32_t findToken (uint32_t fileBufferOffset) const;
+
     void save (IOutputStream* stream);
     static unique_ptr <IndentationContext> load (IInputStream* stream);
-    static unique_ptr <IndentationContext> create (FileContext& fileContext, CXTranslationUnit unit);
+    // The file of the unit the file context is made of: the source or a header. Tokens are allocated from the arena
+    // of the file context.
+    static unique_ptr <IndentationContext> create (FileContext& fileContext, CXTranslationUnit unit, CXFile file);
+
+    // The file context contents & the unit have nRemovedBytes at editOffset replaced with nInsertedBytes already:
+    // tokens around the edit are tokenized again & spliced in, intervals are measured again up to the next line.
+    void update (FileContext& fileContext, CXTranslationUnit unit, uint32_t editOffset, uint32_t nRemovedBytes,
+                 uint32_t nInsertedBytes);
 
 private :
-    IndentationContext() = default;
+    explicit IndentationContext (Arena* arena = nullptr) :
+        fileContents (nullptr), tokenStream (ArenaAllocator <Token> (arena))
+    {}
 
     IndentationContext (const IndentationContext&) = delete;
     IndentationContext& operator= (const IndentationContext&) = delete;
@@ -81,17 +122,20 @@ private :
 
     struct Token
     {
-        uint32_t fileBufferOffset;
-        string tokenValue;
+        uint32_t fileBufferOffset, fileBufferEndOffset;
+        CXTokenKind tokenKind;
 
         TokenClassId tokenClass;
         AnnotatedTokenInterval afterTokenInterval;
-
-        CXToken token;
     };
 
+    typedef vector <Token, ArenaAllocator <Token>> TokenVector;
+
+    // The contents of the file context owning this one
+    const string* fileContents;
+
     //AnnotatedTokenInterval beforeFirstTokenInterval;
-    vector <Token> tokenStream;
+    TokenVector tokenStream;
 
     map <string, TokenClassId> tokenClassNameToId;
     map <string, InvisibleModifierId> invisibleModifierNameToId;
@@ -100,6 +144,14 @@ private :
     void addInvisibleModifier (Token& token, string modifierName);
 
     void assignTokenTypes();
+
+    // Appends tokens of the range lying within [beginOffset, endOffset)
+    void tokenize (CXTranslationUnit unit, CXSourceRange range, uint32_t beginOffset, uint32_t endOffset,
+                   TokenVector& result) const;
+    void tokenizeFile (CXTranslationUnit unit, CXFile file, TokenVector& result) const;
+
+    // Intervals after tokens from firstToken on, until a newline one between tokens from firstUnchangedToken on
+    void measureIntervals (const string& fileContents, uint32_t firstToken, uint32_t firstUnchangedToken);
 };
 
 }
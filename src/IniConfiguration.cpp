@@ -1,6 +1,15 @@
 #include "IniConfiguration.h"
 #include "FileSystem.h"
 #include "FileStreams.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <cstdlib>
+#include <thread>
 
 using namespace sa;
 using namespace std;
@@ -10,29 +19,403 @@ IniFileLocation IniFileLocation::invalidLocation()
     return IniFileLocation { static_cast <IniFileId> (0), 0 };
 }
 
+uint32_t sa::hashIniKey (const char* s, size_t length)
+{
+    uint32_t hash = iniKeyHashBasis;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ static_cast <unsigned char> (toLowerIniKeyCharacter (s[i]))) * 16777619u;
+    return hash;
+}
+
+static bool parseIniBoolean (const string& value, bool& result)
+{
+    if (value != "true" && value != "false")
+        return false;
+
+    result = value == "true";
+    return true;
+}
+
+static bool parseIniInteger (const string& value, int& result)
+{
+    errno = 0;
+    char* end = nullptr;
+    long number = strtol (value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno == ERANGE || number < INT_MIN || number > INT_MAX)
+        return false;
+
+    result = static_cast <int> (number);
+    return true;
+}
+
+uint32_t IniConfiguration::findSlot (const IniKey& key) const
+{
+    if (base)
+    {
+        uint32_t slot = base->findSlot (key);
+        if (slot != noSlot)
+            return slot;
+    }
+
+    uint32_t index = findLocalIndex (key);
+    return index == noSlot ? noSlot : baseSlotCount + index;
+}
+
+uint32_t IniConfiguration::findLocalIndex (const IniKey& key) const
+{
+    if (slotTable.empty())
+        return noSlot;
+
+    size_t mask = slotTable.size() - 1;
+    for (size_t position = key.hash & mask; slotTable[position]; position = (position + 1) & mask)
+    {
+        uint32_t index = slotTable[position] - 1;
+        const IniProperty& property = properties[index];
+        if (property.keyHash != key.hash || property.key.length() != key.length)
+            continue;
+
+        // Stored keys are lowercase
+        size_t i = 0;
+        while (i < key.length && toLowerIniKeyCharacter (key.name[i]) == property.key[i])
+            i++;
+
+        if (i == key.length)
+            return index;
+    }
+
+    return noSlot;
+}
+
+uint32_t IniConfiguration::getSlot (const IniKey& key)
+{
+    uint32_t slot = findSlot (key);
+    if (slot != noSlot)
+        return slot;
+
+    uint32_t index = static_cast <uint32_t> (properties.size());
+    properties.push_back (IniProperty());
+
+    IniProperty& property = properties.back();
+    property.key.resize (key.length);
+    for (size_t i = 0; i < key.length; i++)
+        property.key[i] = toLowerIniKeyCharacter (key.name[i]);
+    property.keyHash = key.hash;
+    property.used = property.defined = false;
+    property.cachedValues = 0;
+
+    // Load factor is kept under one half
+    if (properties.size() * 2 > slotTable.size())
+        rebuildSlotTable (max <size_t> (16, slotTable.size() * 2));
+    else
+    {
+        size_t mask = slotTable.size() - 1;
+        size_t position = key.hash & mask;
+        while (slotTable[position])
+            position = (position + 1) & mask;
+        slotTable[position] = index + 1;
+    }
+
+    return baseSlotCount + index;
+}
+
+void IniConfiguration::rebuildSlotTable (size_t size)
+{
+    slotTable.assign (size, 0);
+
+    size_t mask = size - 1;
+    for (uint32_t index = 0; index < properties.size(); index++)
+    {
+        size_t position = properties[index].keyHash & mask;
+        while (slotTable[position])
+            position = (position + 1) & mask;
+        slotTable[position] = index + 1;
+    }
+}
+
+const IniProperty* IniConfiguration::findOverride (uint32_t slot) const
+{
+    auto override = overrides.find (slot);
+    return override != overrides.end() ? &override->second : nullptr;
+}
+
+const IniProperty& IniConfiguration::getBaseProperty (uint32_t slot) const
+{
+    const IniProperty* override = findOverride (slot);
+    return override ? *override : base->getProperty (slot);
+}
+
+bool IniConfiguration::isShared (uint32_t slot) const
+{
+    return isFrozen() || (slot < baseSlotCount && base->isFrozen() && !findOverride (slot));
+}
+
+struct sa::IniConfiguration::UsageCounters
+{
+    uint64_t id;
+    uint32_t nSlots;
+
+    mutex countersMutex;
+    vector < pair <std::thread::id, unique_ptr <vector <uint32_t> > > > threadCounters;
+
+    static atomic <uint64_t> lastId;
+
+    vector <uint32_t>& getThreadCounters();
+};
+
+atomic <uint64_t> sa::IniConfiguration::UsageCounters::lastId (0);
+
+vector <uint32_t>& IniConfiguration::UsageCounters::getThreadCounters()
+{
+    // Threads usually read a single frozen configuration, so the lock is taken once per thread
+    struct LastCounters
+    {
+        uint64_t id;
+        vector <uint32_t>* counters;
+    };
+    static thread_local LastCounters last = { 0, nullptr };
+
+    if (last.id == id)
+        return *last.counters;
+
+    lock_guard <mutex> lock (countersMutex);
+
+    std::thread::id self = std::this_thread::get_id();
+    auto found = find_if (threadCounters.begin(), threadCounters.end(),
+                          [self] (const pair <std::thread::id, unique_ptr <vector <uint32_t> > >& entry)
+                          {
+                              return entry.first == self;
+                          });
+
+    if (found == threadCounters.end())
+    {
+        threadCounters.push_back (make_pair (self, unique_ptr <vector <uint32_t> > (new vector <uint32_t> (nSlots, 0))));
+        found = threadCounters.end() - 1;
+    }
+
+    last = LastCounters { id, found->second.get() };
+    return *last.counters;
+}
+
+void IniConfiguration::markUsed (const IniProperty& property, uint32_t slot) const
+{
+    if (!isShared (slot))
+        property.used = true;
+    else if (isFrozen())
+        usage->getThreadCounters()[slot]++;
+    else
+        base->markUsed (property, slot);
+}
+
+IniProperty& IniConfiguration::getWritableProperty (uint32_t slot)
+{
+    if (slot >= baseSlotCount)
+        return properties[slot - baseSlotCount];
+
+    auto override = overrides.find (slot);
+    if (override == overrides.end())
+        override = overrides.insert (make_pair (slot, base->getProperty (slot))).first;
+
+    return override->second;
+}
+
+const string& IniConfiguration::getFileName (IniFileId fileId) const
+{
+    return fileId < baseFileCount ? base->getFileName (fileId) : fileNamesUsed[fileId - baseFileCount];
+}
+
+unique_ptr <IniConfiguration> IniConfiguration::createLayer (shared_ptr <const IniConfiguration> base)
+{
+    saAssert (base);
+    unique_ptr <IniConfiguration> layer (new IniConfiguration);
+
+    // Layers of layers refer to the same base, the thin part is copied
+    if (base->base)
+    {
+        *layer = *base;
+        layer->usage.reset();
+        return layer;
+    }
+
+    layer->base = base;
+    layer->baseSlotCount = base->getNumSlots();
+    layer->baseFileCount = static_cast <uint32_t> (base->fileNamesUsed.size());
+    return layer;
+}
+
+shared_ptr <const IniConfiguration> IniConfiguration::freeze (unique_ptr <IniConfiguration> configuration)
+{
+    saAssert (configuration && !configuration->isFrozen());
+
+    // Readers would not cache anything, so everything cacheable is computed now
+    for (uint32_t slot = 0; slot < configuration->getNumSlots(); slot++)
+    {
+        if (configuration->isShared (slot))
+            continue;
+
+        const IniProperty& property = configuration->getProperty (slot);
+        if (!property.defined || property.values.size() != 1)
+            continue;
+
+        if (parseIniInteger (property.values[0], property.cachedInteger))
+            property.cachedValues |= IniProperty::CACHED_INTEGER;
+        if (parseIniBoolean (property.values[0], property.cachedBoolean))
+            property.cachedValues |= IniProperty::CACHED_BOOLEAN;
+    }
+
+    configuration->usage = make_shared <UsageCounters>();
+    configuration->usage->id = UsageCounters::lastId.fetch_add (1, memory_order_relaxed) + 1;
+    configuration->usage->nSlots = configuration->getNumSlots();
+
+    return shared_ptr <const IniConfiguration> (move (configuration));
+}
+
+vector <string> IniConfiguration::getUnusedProperties() const
+{
+    // Frozen configurations (this one or the base) count reads per thread
+    vector <uint32_t> nUses (getNumSlots(), 0);
+    for (const IniConfiguration* counted: { base.get(), this })
+    {
+        if (!counted || !counted->isFrozen())
+            continue;
+
+        lock_guard <mutex> lock (counted->usage->countersMutex);
+        for (auto& entry: counted->usage->threadCounters)
+            for (uint32_t slot = 0; slot < entry.second->size(); slot++)
+                nUses[slot] += (*entry.second)[slot];
+    }
+
+    vector <string> unused;
+    for (uint32_t slot = 0; slot < getNumSlots(); slot++)
+    {
+        const IniProperty& property = getProperty (slot);
+        if (property.defined && !property.used && !nUses[slot])
+            unused.push_back (property.key);
+    }
+    return unused;
+}
+
+void IniConfiguration::overrideWith (const IniConfiguration& other)
+{
+    saAssert (&other != this);
+
+    // Other's files are appended, so value origins stay resolvable
+    IniFileId fileIdOffset = baseFileCount + static_cast <IniFileId> (fileNamesUsed.size());
+    for (IniFileId fileId = 0; fileId < other.baseFileCount + other.fileNamesUsed.size(); fileId++)
+    {
+        fileNamesUsed.push_back (other.getFileName (fileId));
+
+        IniFileLocation parent = fileId < other.baseFileCount ? other.base->includedWith[fileId] :
+                                                                other.includedWith[fileId - other.baseFileCount];
+
+        // Roots of other's inclusions (pointing to themselves) are attached to the main file: include chains end
+        if (parent.fileId >= fileId)
+            includedWith.push_back (IniFileLocation { 0, 0 });
+        else
+            includedWith.push_back (IniFileLocation { parent.fileId + fileIdOffset, parent.line });
+    }
+
+    for (uint32_t slot = 0; slot < other.getNumSlots(); slot++)
+    {
+        const IniProperty& source = other.getProperty (slot);
+        if (!source.defined)
+            continue;
+
+        IniProperty& target = getWritableProperty (getSlot (IniKey (source.key)));
+        target.values = source.values;
+        target.valuesDefinedAt = source.valuesDefinedAt;
+        for (IniFileLocation& location: target.valuesDefinedAt)
+            if (location.isValid())
+                location.fileId += fileIdOffset;
+        target.valuesChanged();
+    }
+}
+
 IniProperty::Accessor IniConfiguration::operator[] (const string& key)
 {
-    return IniProperty::Accessor (*this, key);
+    return IniProperty::Accessor (*this, findSlot (IniKey (key)), key);
+}
+
+IniProperty::Accessor IniConfiguration::operator[] (const IniKey& key)
+{
+    uint32_t slot = findSlot (key);
+    return IniProperty::Accessor (*this, slot, slot == noSlot ? string (key.name, key.length) : string());
 }
 
-IniProperty::Accessor::Accessor (IniConfiguration& parent, string key) :
-    parent (parent), key (key)
+IniProperty::Accessor IniConfiguration::operator[] (IniPropertyHandle handle)
 {
-    key = toLower (key);
+    // Nothing to define by an invalid handle: its key is not known
+    if (!handle.isValid())
+        return static_cast <const IniConfiguration&> (*this)[handle];
+
+    saAssert (handle.slot < getNumSlots());
+    return IniProperty::Accessor (*this, handle.slot, string());
 }
 
+IniProperty::Accessor IniConfiguration::operator[] (const string& key) const
+{
+    return IniProperty::Accessor (*this, findSlot (IniKey (key)), key);
+}
+
+IniProperty::Accessor IniConfiguration::operator[] (const IniKey& key) const
+{
+    uint32_t slot = findSlot (key);
+    return IniProperty::Accessor (*this, slot, slot == noSlot ? string (key.name, key.length) : string());
+}
+
+IniProperty::Accessor IniConfiguration::operator[] (IniPropertyHandle handle) const
+{
+    saAssert (!handle.isValid() || handle.slot < getNumSlots());
+    return IniProperty::Accessor (*this, handle.slot, string());
+}
+
+IniPropertyHandle IniConfiguration::getHandle (const IniKey& key)
+{
+    return IniPropertyHandle { getSlot (key) };
+}
+
+IniPropertyHandle IniConfiguration::findHandle (const IniKey& key) const
+{
+    return IniPropertyHandle { findSlot (key) };
+}
+
+IniProperty::Accessor::Accessor (IniConfiguration& parent, uint32_t slot, string key) :
+    parent (parent), writableParent (&parent), slot (slot), key (slot == IniConfiguration::noSlot ? key : string())
+{}
+
+IniProperty::Accessor::Accessor (const IniConfiguration& parent, uint32_t slot, string key) :
+    parent (parent), writableParent (nullptr), slot (slot), key (slot == IniConfiguration::noSlot ? key : string())
+{}
+
 const IniProperty& IniProperty::Accessor::getProperty() const
 {
-    if (parent.properties.count (key) != 1)
+    if (slot == IniConfiguration::noSlot || !parent.getProperty (slot).defined)
         throw IniConfigurationException (__ORIGIN__, IniConfigurationException::Type::UNDEFINED_INI_PROPERTY,
-                                         "Undefined property '" + key + "' read attempt.");
-    return parent.properties[key];
+                                         "Undefined property '" + (slot == IniConfiguration::noSlot ?
+                                                                   toLower (key) : parent.getProperty (slot).key) +
+                                         "' read attempt.");
+
+    const IniProperty& property = parent.getProperty (slot);
+    parent.markUsed (property, slot);
+    return property;
 }
 
 IniProperty& IniProperty::Accessor::getProperty()
 {
-    parent.properties[key].used = true;
-    return parent.properties[key];
+    if (!writableParent)
+        throw IniConfigurationException (__ORIGIN__, IniConfigurationException::Type::READ_ONLY_INI_CONFIGURATION,
+                                         "Property '" + (slot == IniConfiguration::noSlot ? toLower (key) :
+                                                         parent.getProperty (slot).key) +
+                                         "' write attempt: configuration is read-only.");
+
+    if (slot == IniConfiguration::noSlot)
+        slot = writableParent->getSlot (IniKey (key));
+
+    return writableParent->getWritableProperty (slot);
+}
+
+bool IniProperty::Accessor::isDefined() const
+{
+    return slot != IniConfiguration::noSlot && parent.getProperty (slot).defined;
 }
 
 const vector <string>& IniProperty::Accessor::asVector() const
@@ -47,18 +430,44 @@ string IniProperty::Accessor::asString() const
 
 bool IniProperty::Accessor::asBoolean() const
 {
+    const IniProperty& property = getProperty();
+    if (property.cachedValues & IniProperty::CACHED_BOOLEAN)
+        return property.cachedBoolean;
+
     string value = asString();
-    // FIXME: handle errors & throw exception
-    return value == "true";
+    bool result = false;
+    if (!parseIniBoolean (value, result))
+        throw IniConfigurationException (__ORIGIN__, IniConfigurationException::Type::INVALID_INI_PROPERTY_VALUE,
+                                         "Boolean value ('true' or 'false') expected in property '" + property.key +
+                                         "', '" + value + "' met.");
+
+    if (!parent.isShared (slot))
+    {
+        property.cachedBoolean = result;
+        property.cachedValues |= IniProperty::CACHED_BOOLEAN;
+    }
+    return result;
 }
 
 int IniProperty::Accessor::asInteger() const
 {
-    stringstream t (*this);
-    int number;
-    // FIXME: handle errors & throw exception
-    t >> number;
-    return number;
+    const IniProperty& property = getProperty();
+    if (property.cachedValues & IniProperty::CACHED_INTEGER)
+        return property.cachedInteger;
+
+    string value = asString();
+    int result = 0;
+    if (!parseIniInteger (value, result))
+        throw IniConfigurationException (__ORIGIN__, IniConfigurationException::Type::INVALID_INI_PROPERTY_VALUE,
+                                         "Integer value expected in property '" + property.key + "', '" + value +
+                                         "' met.");
+
+    if (!parent.isShared (slot))
+    {
+        property.cachedInteger = result;
+        property.cachedValues |= IniProperty::CACHED_INTEGER;
+    }
+    return result;
 }
 
 IniProperty::Accessor::operator string() const
@@ -70,11 +479,16 @@ IniProperty::Accessor::operator string() const
     return values[0];
 }
 
-string IniProperty::Accessor::resolveRelativePath (unsigned index, string transformedPath)
+string IniProperty::Accessor::resolveRelativePath (unsigned index, string transformedPath) const
 {
-    IniProperty& property = getProperty();
+    // Resolutions are cached in place: reading paths through a layer does not copy the property
+    const IniProperty& property = getProperty();
     saAssert (index >= 0 && index < property.valuesDefinedAt.size());
 
+    if (index < property.resolvedPaths.size() && !property.resolvedPaths[index].second.empty() &&
+        property.resolvedPaths[index].first == transformedPath)
+        return property.resolvedPaths[index].second;
+
     IniFileLocation location = property.valuesDefinedAt[index];
     if (!location.isValid())
         throw InvalidArgumentException (__ORIGIN__,
@@ -83,13 +497,20 @@ string IniProperty::Accessor::resolveRelativePath (unsigned index, string transf
 
     IFileSystem& fileSystem = FileSystem::instance();
 
-    string relativeTo = parent.fileNamesUsed[location.fileId];
+    string relativeTo = parent.getFileName (location.fileId);
     string newPath = fileSystem.appendPath (fileSystem.getDirectoryPath (relativeTo), transformedPath);
-    if (fileSystem.fileExists (newPath))
-        return newPath;
-    else
+    if (!fileSystem.fileExists (newPath))
         throw FileNotFoundException (__ORIGIN__, transformedPath,
-                                     " referenced in a property '" + key + "' declared in '" + relativeTo + "'.");
+                                     " referenced in a property '" + property.key + "' declared in '" + relativeTo + "'.");
+
+    if (parent.isShared (slot))
+        return newPath;
+
+    if (property.resolvedPaths.size() <= index)
+        property.resolvedPaths.resize (property.values.size());
+    property.resolvedPaths[index] = make_pair (transformedPath, newPath);
+
+    return newPath;
 }
 
 ostream& sa::operator<< (ostream& stream, const IniProperty::Accessor& accessor)
@@ -108,152 +529,258 @@ string IniConfigurationException::toString() const
     return description;
 }
 
-unique_ptr <IniConfiguration::IniToken> IniConfiguration::tokenizeStreamContents (IInputStream* stream, IniFileId fileId)
+unique_ptr <IniTokenizedFile> IniConfiguration::tokenizeStreamContents (IInputStream* stream, IniFileId fileId)
 {
+    unique_ptr <IniTokenizedFile> file (new IniTokenizedFile);
+
     auto fileLength = stream->getNumBytesRemaining();
-    unique_ptr <char[]> buffer (new char[fileLength + 1]);
-    buffer[fileLength] = 0;
-    auto nRead = stream->read (buffer.get(), fileLength);
+    file->source.resize (fileLength);
+    auto nRead = fileLength ? stream->read (&file->source[0], fileLength) : 0;
     saAssert (nRead == fileLength);
 
-    string fileContents (buffer.get());
-    unique_ptr <IniConfiguration::IniToken> rawTokens = tokenizeStringContents (fileContents, fileId);
-    return rawTokens;
+    tokenizeStringContents (*file, fileId);
+    return file;
 }
 
-namespace sa
+string IniTokenizedFile::getContents (const IniToken& token) const
 {
+    const string& storage = token.isEscaped ? escapedContents : source;
+    return storage.substr (token.contentsBegin, token.contentsLength);
+}
 
-class IniParser
+bool IniTokenizedFile::contentsEqual (const IniToken& token, const char* s) const
 {
-public :
-    typedef IniConfiguration::IniToken Token;
-
-    unique_ptr <Token> firstToken;
-    IniConfiguration& configuration;
+    const string& storage = token.isEscaped ? escapedContents : source;
+    return storage.compare (token.contentsBegin, token.contentsLength, s) == 0;
+}
 
-    Token* current;
-    bool isUngotToken;
+const IniTokenizedFile& IniConfiguration::getTokenizedContents (IniCachedFile& file, IniFileId fileId)
+{
+    lock_guard <mutex> lock (file.tokenizeMutex);
 
-    string currentSection;
+    // Not marked as tokenized on errors: the next configuration including the file reports them too
+    if (!file.isTokenized)
+    {
+        tokenizeStringContents (file.contents, fileId);
+        file.isTokenized = true;
+    }
 
-    IniParser (IniConfiguration& configuration, unique_ptr <Token> first) :
-        firstToken (move (first)), configuration (configuration), current (nullptr), isUngotToken (false)
-    {}
+    return file.contents;
+}
 
-    void preprocess (IRelativeStreamsManager* includeManager, IInputStream* sourceStream)
+shared_ptr <IniCachedFile> IniFileCache::get (string fileName)
+{
+    IFileSystem& fileSystem = FileSystem::instance();
+    if (!fileSystem.fileExists (fileName))
+        throw FileNotFoundException (__ORIGIN__, fileName, "(ini file)");
+
+    string canonicalName = fileSystem.getCanonicalPath (fileName);
+
+    // Ini files are small: they are read every time & compared. Modification times have a resolution of a second,
+    // an edit keeping the size within the same second would go unnoticed otherwise.
+    // Read outside of the lock: files of different configurations may be read concurrently.
+    string source;
+    unique_ptr <UniversalInputStream> stream = UniversalInputStream::openInputStream (canonicalName,
+                                                                                       RelativeInputStreamFlags::NONE);
+    uint32_t length = stream->getNumBytesRemaining();
+    source.resize (length);
+    if (length)
+        saVerify (stream->read (&source[0], length) == length);
+
+    lock_guard <mutex> lock (cacheMutex);
+    auto it = files.find (canonicalName);
+    if (it != files.end() && it->second->contents.source == source)
     {
-        saAssert (configuration.fileNamesUsed.size() == 1);
-        saAssert (configuration.fileNamesUsed.size() == configuration.includedWith.size());
-
-        vector < unique_ptr <IInputStream> > childStreams;
+        metrics::iniFileCacheHits.add();
+        return it->second;
+    }
 
-        Token* previous = nullptr;
-        Token* now = firstToken.get();
+    metrics::iniFileCacheMisses.add();
 
-        while (now)
-        {
-            if (now->type == Token::Type::SHARP_INCLUDE_OPERATOR)
-            {
-                Token* inclusionKeyword = now->next.get();
-                if (!inclusionKeyword || inclusionKeyword->type != Token::Type::IDENTIFIER
-                        || inclusionKeyword->contents != "include")
-                    syntaxError (now, "Expected 'include' keyword after sharp symbol.");
+    shared_ptr <IniCachedFile> file (new IniCachedFile);
+    file->fileName = canonicalName;
+    file->contents.source = move (source);
 
-                Token* fileName = inclusionKeyword->next.get();
-                if (!fileName || (fileName->type != Token::Type::INCLUSION_LITERAL
-                                  && fileName->type != Token::Type::STRING_LITERAL))
-                    syntaxError (now, "Expected inclusion filename.");
+    // Configurations still using a replaced file keep it alive
+    files[canonicalName] = file;
+    return file;
+}
 
-                Token* newLine = fileName->next.get();
-                if (!newLine || newLine->type != Token::Type::NEWLINE)
-                    syntaxError (fileName, "Unexpected tokens after inclusion directive.");
+void IniFileCache::clear()
+{
+    lock_guard <mutex> lock (cacheMutex);
+    files.clear();
+}
 
-                string includeWhat = fileName->contents;
-                bool localInclusion = fileName->type == Token::Type::INCLUSION_LITERAL;
+IniFileCache& IniFileCache::instance()
+{
+    static IniFileCache theInstance;
+    return theInstance;
+}
 
-                IniFileId fileId = fileName->location.fileId;
-                IInputStream* tokenStream = fileId ? childStreams[fileId - 1].get() : sourceStream;
+IniCachedInputStream::IniCachedInputStream (shared_ptr <IniCachedFile> file) :
+    file (file), position (0)
+{}
 
-                IniRelativeInputStreamFlags flags
-                    = localInclusion ?
-                      IniRelativeInputStreamFlags::LOCAL_INCLUSION :
-                      IniRelativeInputStreamFlags::GLOBAL_INCLUSION;
+IniCachedInputStream::~IniCachedInputStream()
+{}
 
-                unique_ptr <IInputStream> relative
-                    = includeManager->openInputStream (includeManager->getInputStreamId (tokenStream),
-                                                       includeWhat, &flags, RelativeInputStreamFlags::NONE);
+uint32_t IniCachedInputStream::read (char* buffer, uint32_t nBytes)
+{
+    uint32_t nRead = min (nBytes, getNumBytesRemaining());
+    memcpy (buffer, file->contents.source.data() + position, nRead);
+    position += nRead;
+    return nRead;
+}
 
-                if (!relative)
-                    throw IniConfigurationException (__ORIGIN__, IniConfigurationException::Type::INVALID_INI_SYNTAX,
-                                                     "Include file not found: " + string (localInclusion ? "\"" : "<") +
-                                                     includeWhat + string (localInclusion ? "\"" : ">") + ".");
+uint32_t IniCachedInputStream::getNumBytesRemaining() const
+{
+    return static_cast <uint32_t> (file->contents.source.length()) - position;
+}
 
-                if (UniversalInputStream* universal = dynamic_cast <UniversalInputStream*> (relative.get()))
-                    configuration.fileNamesUsed.push_back (universal->isFileStream() ?
-                                                           universal->getSourceFileName() :
-                                                           universal->getSourceBufferName());
-                else
-                    configuration.fileNamesUsed.push_back ("<unknown source>");
+namespace sa
+{
 
-                configuration.includedWith.push_back (fileName->location);
+class IniParser
+{
+public :
+    typedef IniToken Token;
+    typedef IniTokenizedFile TokenizedFile;
 
-                IniFileId newId = static_cast <IniFileId> (configuration.includedWith.size() - 1);
-                unique_ptr <Token> includedStream = configuration.tokenizeStreamContents (relative.get(), newId);
+    // Recursive inclusions would exhaust the stack otherwise
+    static const unsigned maxInclusionDepth = 64;
 
-                childStreams.push_back (move (relative));
+    IniConfiguration& configuration;
+    IRelativeStreamsManager* includeManager;
 
-                getLastToken (includedStream.get())->next = move (newLine->next);
+    // Included streams are kept open until the end of loading: stream ids are assigned by their addresses
+    vector < unique_ptr <IInputStream> > childStreams;
 
-                now = firstToken.get();
+    // Sections are not reset on file boundaries, as if included files were pasted in place of the directive
+    string currentSection;
 
-                if (previous)
-                    previous->next = move (includedStream);
-                else
-                    firstToken = move (includedStream);
-            }
-            else
-            {
-                previous = now;
-                now = now->next.get();
-            }
-        }
+    // File being parsed
+    const TokenizedFile* file;
+    IInputStream* fileStream;
+    IniFileId fileId;
+    size_t current;
+    unsigned inclusionDepth;
 
-    }
+    IniParser (IniConfiguration& configuration, IRelativeStreamsManager* includeManager) :
+        configuration (configuration), includeManager (includeManager),
+        file (nullptr), fileStream (nullptr), fileId (0), current (0), inclusionDepth (0)
+    {}
 
-    static Token* getLastToken (Token* list)
+    void parseFile (IInputStream* stream, IniFileId id)
     {
-        saAssert (list);
-        while (list->next)
-            list = list->next.get();
-        return list;
-    }
+        unique_ptr <TokenizedFile> tokenized;
+        const TokenizedFile* contents;
 
-    void parseConfiguration()
-    {
-        current = firstToken.get();
+        if (IniCachedInputStream* cached = dynamic_cast <IniCachedInputStream*> (stream))
+            contents = &configuration.getTokenizedContents (cached->getCachedFile(), id);
+        else
+        {
+            tokenized = configuration.tokenizeStreamContents (stream, id);
+            contents = tokenized.get();
+        }
+
+        const TokenizedFile* parentFile = file;
+        IInputStream* parentStream = fileStream;
+        IniFileId parentId = fileId;
+        size_t parentCurrent = current;
+
+        file = contents;
+        fileStream = stream;
+        fileId = id;
+        current = 0;
 
-        while (current)
+        while (current < file->tokens.size())
             parseLine();
+
+        file = parentFile;
+        fileStream = parentStream;
+        fileId = parentId;
+        current = parentCurrent;
     }
 
     void parseLine()
     {
-        if (current->type == Token::Type::NEWLINE)
+        const Token& token = file->tokens[current];
+
+        if (token.type == Token::Type::NEWLINE)
             return void (getNextToken());
 
-        if (current->type == Token::Type::OPEN_BRACKET_OPERATOR)
+        if (token.type == Token::Type::SHARP_INCLUDE_OPERATOR)
+            return void (parseInclusionLine());
+        else if (token.type == Token::Type::OPEN_BRACKET_OPERATOR)
             return void (parseSectionHeaderLine());
         else
             return void (parseKeyValueLine());
     }
 
+    void parseInclusionLine()
+    {
+        const Token& sharp = expected (Token::Type::SHARP_INCLUDE_OPERATOR);
+
+        const Token& inclusionKeyword = file->tokens[current];
+        if (inclusionKeyword.type != Token::Type::IDENTIFIER || !file->contentsEqual (inclusionKeyword, "include"))
+            syntaxError (sharp, "Expected 'include' keyword after sharp symbol.");
+        getNextToken();
+
+        const Token& fileName = file->tokens[current];
+        if (fileName.type != Token::Type::INCLUSION_LITERAL && fileName.type != Token::Type::STRING_LITERAL)
+            syntaxError (sharp, "Expected inclusion filename.");
+        getNextToken();
+
+        if (file->tokens[current].type != Token::Type::NEWLINE)
+            syntaxError (fileName, "Unexpected tokens after inclusion directive.");
+        getNextToken();
+
+        if (inclusionDepth == maxInclusionDepth)
+            syntaxError (fileName, "Inclusion depth limit exceeded (recursive inclusion?).");
+
+        string includeWhat = file->getContents (fileName);
+        bool localInclusion = fileName.type == Token::Type::INCLUSION_LITERAL;
+
+        IniRelativeInputStreamFlags flags
+            = localInclusion ?
+              IniRelativeInputStreamFlags::LOCAL_INCLUSION :
+              IniRelativeInputStreamFlags::GLOBAL_INCLUSION;
+
+        unique_ptr <IInputStream> relative
+            = includeManager->openInputStream (includeManager->getInputStreamId (fileStream),
+                                               includeWhat, &flags, RelativeInputStreamFlags::NONE);
+
+        if (!relative)
+            throw IniConfigurationException (__ORIGIN__, IniConfigurationException::Type::INVALID_INI_SYNTAX,
+                                             "Include file not found: " + string (localInclusion ? "\"" : "<") +
+                                             includeWhat + string (localInclusion ? "\"" : ">") + ".");
+
+        if (UniversalInputStream* universal = dynamic_cast <UniversalInputStream*> (relative.get()))
+            configuration.fileNamesUsed.push_back (universal->isFileStream() ?
+                                                   universal->getSourceFileName() :
+                                                   universal->getSourceBufferName());
+        else if (IniCachedInputStream* cached = dynamic_cast <IniCachedInputStream*> (relative.get()))
+            configuration.fileNamesUsed.push_back (cached->getCachedFile().fileName);
+        else
+            configuration.fileNamesUsed.push_back ("<unknown source>");
+
+        configuration.includedWith.push_back (IniFileLocation { fileId, fileName.line });
+
+        IniFileId newId = static_cast <IniFileId> (configuration.includedWith.size() - 1);
+        childStreams.push_back (move (relative));
+
+        inclusionDepth++;
+        parseFile (childStreams.back().get(), newId);
+        inclusionDepth--;
+    }
+
     void parseSectionHeaderLine()
     {
         expected (Token::Type::OPEN_BRACKET_OPERATOR);
 
-        if (current->type == Token::Type::IDENTIFIER)
-            currentSection = expected (Token::Type::IDENTIFIER)->contents;
+        if (file->tokens[current].type == Token::Type::IDENTIFIER)
+            currentSection = file->getContents (expected (Token::Type::IDENTIFIER));
         else
             currentSection = "";
 
@@ -263,10 +790,10 @@ public :
 
     void parseKeyValueLine()
     {
-        string keyName = expected (Token::Type::IDENTIFIER)->contents;
+        string keyName = file->getContents (expected (Token::Type::IDENTIFIER));
 
         bool append = false;
-        if (current->type == Token::Type::OPEN_BRACKET_OPERATOR)
+        if (file->tokens[current].type == Token::Type::OPEN_BRACKET_OPERATOR)
         {
             getNextToken();
             expected (Token::Type::CLOSE_BRACKET_OPERATOR);
@@ -275,51 +802,36 @@ public :
 
         expected (Token::Type::ASSIGNMENT_OPERATOR);
 
-        string value = expected (Token::Type::STRING_LITERAL)->contents;
-        IniFileLocation location = expected (Token::Type::NEWLINE)->location;
+        string value = file->getContents (expected (Token::Type::STRING_LITERAL));
+        IniFileLocation location { fileId, expected (Token::Type::NEWLINE).line };
 
         if (!currentSection.empty())
             keyName = currentSection + "." + keyName;
 
-        keyName = toLower (keyName);
         configuration[keyName].push_back (value, !append, location);
     }
 
-    Token* expected (Token::Type tokenType)
+    const Token& expected (Token::Type tokenType)
     {
-        saAssert (current);
-        if (current->type != tokenType)
-            syntaxError (current, "Expected " + toString (tokenType) + ", " + toString (current->type) + " met.");
+        saAssert (current < file->tokens.size());
+        const Token& token = file->tokens[current];
+        if (token.type != tokenType)
+            syntaxError (token, "Expected " + toString (tokenType) + ", " + toString (token.type) + " met.");
 
-        Token* was = current;
         getNextToken();
-        return was;
-    }
-
-    void ungetToken()
-    {
-        saAssert (!isUngotToken);
-        isUngotToken = true;
+        return token;
     }
 
-    Token* getNextToken()
+    void getNextToken()
     {
-        if (isUngotToken)
-        {
-            isUngotToken = false;
-            return current;
-        }
-
-        saAssert (current);
-        current = current->next.get();
-        return current;
+        saAssert (current < file->tokens.size());
+        current++;
     }
 
-    ATTRIBUTE_NORETURN void syntaxError (Token* after, string description)
+    ATTRIBUTE_NORETURN void syntaxError (const Token& after, string description)
     {
-        saAssert (after);
         description = "Invalid ini file syntax: " + description + "\n"
-                      + configuration.getSourceString (after->location.line, after->location.fileId);
+                      + configuration.getSourceString (after.line, fileId);
         throw IniConfigurationException (__ORIGIN__, IniConfigurationException::Type::INVALID_INI_SYNTAX, description);
     }
 
@@ -351,26 +863,12 @@ unique_ptr <IniConfiguration> IniConfiguration::load (string iniSourceName, IInp
     IniFileId mainFileId = static_cast <IniFileId> (0);
     configuration->includedWith.push_back (IniFileLocation { mainFileId, 0 });
 
-    unique_ptr <IniConfiguration::IniToken> tokens = configuration->tokenizeStreamContents (stream, mainFileId);
-    IniParser parser (*configuration.get(), move (tokens));
-    parser.preprocess (includeManager, stream);
-    parser.parseConfiguration();
+    IniParser parser (*configuration.get(), includeManager);
+    parser.parseFile (stream, mainFileId);
 
     return configuration;
 }
 
-void IniConfiguration::appendToken (IniConfiguration::IniToken*& appendTo, IniConfiguration::IniToken::Type type,
-                                    string contents, IniFileId fileId, unsigned line)
-{
-    saAssert (appendTo);
-    appendTo->next.reset (new IniConfiguration::IniToken);
-    appendTo = appendTo->next.get();
-
-    appendTo->type = type;
-    appendTo->location = IniFileLocation { fileId, line };
-    appendTo->contents = contents;
-}
-
 string IniConfiguration::getSourceString (unsigned int line, IniFileId fileId)
 {
     string sourceString = "at " + fileNamesUsed[fileId] + ":" + toString (line);
@@ -394,13 +892,23 @@ constexpr bool IniConfiguration::isIdentifierSymbol (char c, bool first)
     return (!first && (c >= '0' && c <= '9')) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c == '_') || (c == '.');
 }
 
-unique_ptr <IniConfiguration::IniToken> IniConfiguration::tokenizeStringContents (string contents, IniFileId fileId)
+void IniConfiguration::tokenizeStringContents (IniTokenizedFile& file, IniFileId fileId)
 {
-    const char* buffer = contents.c_str();
+    // The terminating zero is used as the end of file marker
+    const char* buffer = file.source.c_str();
     const char* current = buffer;
 
-    unique_ptr <IniToken> tokenStream (new IniToken { IniToken::Type::NEWLINE, "", IniFileLocation { fileId, 0 }, nullptr });
-    IniToken* lastToken = tokenStream.get();
+    vector <IniToken>& tokens = file.tokens;
+    tokens.clear();
+    file.escapedContents.clear();
+    // Rough estimate: a short key-value line takes five tokens
+    tokens.reserve (file.source.length() / 8 + 1);
+
+    auto appendToken = [&] (IniToken::Type type, const char* contentsBegin, const char* contentsEnd, unsigned line)
+    {
+        tokens.push_back (IniToken { type, false, static_cast <uint32_t> (contentsBegin - buffer),
+                                     static_cast <uint32_t> (contentsEnd - contentsBegin), line });
+    };
 
     unsigned currentLine = 1;
     const char* lastLineBeginning = current;
@@ -428,7 +936,7 @@ unique_ptr <IniConfiguration::IniToken> IniConfiguration::tokenizeStringContents
         if (*current == '\n' || *current == '\0')
         {
             currentLine++;
-            appendToken (lastToken, IniToken::Type::NEWLINE, "", fileId, currentLine);
+            appendToken (IniToken::Type::NEWLINE, current, current, currentLine);
             if (!*current)
                 break;
             current++;
@@ -439,7 +947,7 @@ unique_ptr <IniConfiguration::IniToken> IniConfiguration::tokenizeStringContents
             if (current != lastLineBeginning)
                 invalidToken ("'#' met not in the beginning of the line.", fileId, currentLine);
 
-            appendToken (lastToken, IniToken::Type::SHARP_INCLUDE_OPERATOR, "", fileId, currentLine);
+            appendToken (IniToken::Type::SHARP_INCLUDE_OPERATOR, current, current, currentLine);
             current++;
         }
         else if (*current == '=' || *current == '[' || *current == ']')
@@ -448,27 +956,29 @@ unique_ptr <IniConfiguration::IniToken> IniConfiguration::tokenizeStringContents
             if (*current == '[') type = IniToken::Type::OPEN_BRACKET_OPERATOR;
             if (*current == ']') type = IniToken::Type::CLOSE_BRACKET_OPERATOR;
 
-            appendToken (lastToken, type, "", fileId, currentLine);
+            appendToken (type, current, current, currentLine);
             current++;
         }
         else if (isIdentifierSymbol (*current, true))
         {
-            string contents = "";
-            contents += *current;
+            const char* identifierBegin = current;
             current++;
 
             while (isIdentifierSymbol (*current, false))
-                contents += *(current++);
+                current++;
 
-            appendToken (lastToken, IniToken::Type::IDENTIFIER, contents, fileId, currentLine);
+            appendToken (IniToken::Type::IDENTIFIER, identifierBegin, current, currentLine);
         }
         else if (*current == '<' || *current == '"')
         {
-            string contents = "";
-
             bool inclusion = *current == '<';
             current++;
 
+            // Literals without escape sequences are not copied
+            const char* literalBegin = current;
+            size_t escapedBegin = file.escapedContents.length();
+            bool isEscaped = false;
+
             bool escaped = false;
             while (true)
             {
@@ -486,7 +996,7 @@ unique_ptr <IniConfiguration::IniToken> IniConfiguration::tokenizeStringContents
                     else if (!(c == '\\' || c == '>' || c == '"'))
                         invalidToken (string ("Invalid escape sequence '\\") + c + "'.", fileId, currentLine);
 
-                    contents += c;
+                    file.escapedContents += c;
                     escaped = false;
                     continue;
                 }
@@ -496,15 +1006,23 @@ unique_ptr <IniConfiguration::IniToken> IniConfiguration::tokenizeStringContents
 
                 if (c == '\\')
                 {
-                    escaped = true;
+                    if (!isEscaped)
+                        file.escapedContents.append (literalBegin, current - 1);
+                    isEscaped = escaped = true;
                     continue;
                 }
 
-                contents += c;
+                if (isEscaped)
+                    file.escapedContents += c;
             }
 
-            appendToken (lastToken, inclusion ? IniToken::Type::INCLUSION_LITERAL : IniToken::Type::STRING_LITERAL,
-                         contents, fileId, currentLine);
+            IniToken::Type type = inclusion ? IniToken::Type::INCLUSION_LITERAL : IniToken::Type::STRING_LITERAL;
+            if (isEscaped)
+                tokens.push_back (IniToken { type, true, static_cast <uint32_t> (escapedBegin),
+                                             static_cast <uint32_t> (file.escapedContents.length() - escapedBegin),
+                                             currentLine });
+            else
+                appendToken (type, literalBegin, current - 1, currentLine);
         }
         else
         {
@@ -512,8 +1030,6 @@ unique_ptr <IniConfiguration::IniToken> IniConfiguration::tokenizeStringContents
                           + "' (code " + toString (*reinterpret_cast <const unsigned char*> (current)) + ".", fileId, currentLine);
         }
     }
-
-    return tokenStream;
 }
 
 IniIncludeManager::~IniIncludeManager() {}
@@ -571,11 +1087,7 @@ unique_ptr <IInputStream> IniIncludeManager::openInputStream (IRelativeStreamsMa
 
         string relative = tryRelative (directory, relativeName);
         if (FileSystem::instance().fileExists (relative))
-        {
-            unique_ptr <IInputStream> stream (UniversalInputStream::openInputStream (relative, flags));
-            addStream (stream.get(), relative);
-            return stream;
-        }
+            return openInputStream (relative, flags);
     }
 
     throw FileNotFoundException (__ORIGIN__, relativeName,
@@ -584,7 +1096,12 @@ unique_ptr <IInputStream> IniIncludeManager::openInputStream (IRelativeStreamsMa
 
 unique_ptr <IInputStream> IniIncludeManager::openInputStream (string fileName, RelativeInputStreamFlags flags)
 {
-    unique_ptr <IInputStream> stream (UniversalInputStream::openInputStream (fileName, flags));
+    unique_ptr <IInputStream> stream;
+    if (flags == RelativeInputStreamFlags::NONE)
+        stream.reset (new IniCachedInputStream (IniFileCache::instance().get (fileName)));
+    else
+        stream = UniversalInputStream::openInputStream (fileName, flags);
+
     addStream (stream.get(), fileName);
     return stream;
 }
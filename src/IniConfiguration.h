@@ -35,6 +35,21 @@
    - require methods
      cfg["a"].requireSingle()
    - issues list & exceptions. Warnings (ignored value) if no errors.
+   - key handles for hot lookups: a key is resolved once, later accesses are array indexing
+     IniPropertyHandle files = cfg.getHandle (saIniKey ("datagrabbing.files")); // key hash computed at compile time
+     cfg[files].asVector();
+     constCfg.findHandle (saIniKey ("datagrabbing.files")); // read-only configurations: invalid if undefined
+   - typed values (integer, boolean, resolved paths) are parsed on the first request and cached in the property
+   - layered configurations: a shared immutable base with a thin override layer per job
+     shared_ptr <const IniConfiguration> base = ...;
+     unique_ptr <IniConfiguration> job = IniConfiguration::createLayer (base); // nothing is copied
+     job->overrideWith (jobOverrides);                                          // copies overridden properties only
+   - frozen configurations: immutable, readable from any number of threads without locks
+     shared_ptr <const IniConfiguration> shared = IniConfiguration::freeze (move (cfg));
+     (*shared)["a"].asInteger();         // typed values were computed by freeze, nothing is written on reads
+     shared->getUnusedProperties();      // merges per-thread usage counters, call once readers are done
+   - binary snapshots of loaded configurations (see IniConfigurationSnapshot.cpp): loaded without parsing,
+     rebuilt when any file of the include graph changes
 
    Notes:
    - case-insensitive keys
@@ -43,13 +58,16 @@
 #ifndef STYLE_ANALYZER_INI_CONFIGURATION_H
 #define STYLE_ANALYZER_INI_CONFIGURATION_H
 
+#include <deque>
 #include <map>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <iostream>
 
 #include "Streams.h"
+#include "FileSystem.h"
 
 // TODO: Relative paths support library
 
@@ -60,6 +78,8 @@ using std::map;
 using std::string;
 using std::vector;
 using std::unique_ptr;
+using std::shared_ptr;
+using std::mutex;
 using std::pair;
 using std::ostream;
 
@@ -78,15 +98,97 @@ struct IniFileLocation
     static IniFileLocation invalidLocation();
 };
 
+constexpr char toLowerIniKeyCharacter (char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast <char> (c - 'A' + 'a') : c;
+}
+
+static constexpr uint32_t iniKeyHashBasis = 2166136261u;
+
+// Case-insensitive FNV-1a, usable in constant expressions
+constexpr uint32_t hashIniKeyLiteral (const char* s, uint32_t hash = iniKeyHashBasis)
+{
+    return *s ? hashIniKeyLiteral (s + 1, (hash ^ static_cast <unsigned char> (toLowerIniKeyCharacter (*s))) * 16777619u) :
+                hash;
+}
+
+// Same as hashIniKeyLiteral, but not recursive
+uint32_t hashIniKey (const char* s, size_t length);
+
+// A key with precomputed hash. Refers to the key string, does not own it.
+class IniKey
+{
+public :
+    template <size_t N>
+    constexpr explicit IniKey (const char (&name)[N]) :
+        name (name), length (N - 1), hash (hashIniKeyLiteral (name))
+    {}
+
+    explicit IniKey (const string& name) :
+        name (name.data()), length (name.length()), hash (hashIniKey (name.data(), name.length()))
+    {}
+
+    const char* name;
+    size_t length;
+    uint32_t hash;
+};
+
+// Forces the hash of a literal key to be computed at compile time
+#define saIniKey(name) ([]() -> sa::IniKey { constexpr sa::IniKey key (name); return key; }())
+
+// Resolved key of a particular configuration: stays valid as long as the configuration lives
+class IniPropertyHandle
+{
+public :
+    uint32_t slot;
+
+    // Handles found for undefined keys (see IniConfiguration::findHandle) are invalid: never defined, never read
+    bool isValid() const
+    {
+        return slot != ~0u;
+    }
+};
+
 template <typename T>
 const T& assign (class IniProperty& p, const T& rhs);
 
 class IniConfiguration;
+class IniIncludeManager;
 
 class IniProperty
 {
+    friend class IniConfiguration;
+
     vector <IniFileLocation> valuesDefinedAt;
-    bool used;
+
+    // Set by reads (frozen configurations count reads per thread instead)
+    mutable bool used;
+
+    // Slots may exist for properties never assigned (e. g. handles of undefined keys)
+    bool defined;
+    uint32_t keyHash;
+
+    // Typed values are parsed on the first request and dropped when values change
+    enum CachedValue : uint8_t
+    {
+        CACHED_INTEGER = 1 << 0,
+        CACHED_BOOLEAN = 1 << 1
+    };
+
+    mutable uint8_t cachedValues;
+    mutable int cachedInteger;
+    mutable bool cachedBoolean;
+
+    // Per value index: path passed to resolveRelativePath & its resolution (empty if not resolved)
+    mutable vector < pair <string, string> > resolvedPaths;
+
+    void valuesChanged()
+    {
+        defined = true;
+        used = false;
+        cachedValues = 0;
+        resolvedPaths.clear();
+    }
 
 public :
     string key;
@@ -94,7 +196,13 @@ public :
 
     class Accessor
     {
-        IniConfiguration& parent;
+        const IniConfiguration& parent;
+
+        // nullptr for accessors of constant configurations: writes are not allowed
+        IniConfiguration* writableParent;
+        uint32_t slot;
+
+        // Key of a property without a slot yet: the slot is created on the first write
         string key;
 
         friend ostream& operator<< (ostream&, const Accessor&);
@@ -103,10 +211,13 @@ public :
         IniProperty& getProperty();
     public :
 
-        Accessor (IniConfiguration& parent, string key);
+        Accessor (IniConfiguration& parent, uint32_t slot, string key);
+        Accessor (const IniConfiguration& parent, uint32_t slot, string key);
 
         operator string() const;
 
+        bool isDefined() const;
+
         template <typename T>
         bool operator== (T& x) const
         {
@@ -122,8 +233,8 @@ public :
         friend const T& assign (IniProperty& p, const T& rhs)
         {
             p.values.assign (1, toString (rhs));
-            p.valuesDefinedAt.push_back (IniFileLocation::invalidLocation());
-            p.used = false;
+            p.valuesDefinedAt.assign (1, IniFileLocation::invalidLocation());
+            p.valuesChanged();
 
             return rhs;
         }
@@ -141,7 +252,7 @@ public :
 
             p.values.push_back (toString (value));
             p.valuesDefinedAt.push_back (IniFileLocation::invalidLocation());
-            p.used = false;
+            p.valuesChanged();
         }
 
         template <typename T>
@@ -159,13 +270,112 @@ public :
 
             p.values.push_back (toString (value));
             p.valuesDefinedAt.push_back (location);
-            p.used = false;
+            p.valuesChanged();
         }
 
-        string resolveRelativePath (unsigned index, string transformedPath);
+        string resolveRelativePath (unsigned index, string transformedPath) const;
+    };
+};
+
+class IniToken
+{
+public :
+    enum class Type
+    {
+        // a key or identifier-like operator (e. g. '<key> unite <separator>' construction)
+        // identifiers may contain: A-Z, a-z, 0-9, ., _
+        // 'contents' contains identifier
+        IDENTIFIER,
+        // =, 'contents' empty
+        ASSIGNMENT_OPERATOR,
+        // quoted string, 'contents' contains string with escapes replaced
+        STRING_LITERAL,
+        // string quoted with '<>', used in includes, 'contents' contains string with escapes replaced
+        INCLUSION_LITERAL,
+        // [, 'contents' empty
+        OPEN_BRACKET_OPERATOR,
+        // ], 'contents' empty
+        CLOSE_BRACKET_OPERATOR,
+        // #, 'contents' empty. If not first character of line, invalid token exception is thrown.
+        SHARP_INCLUDE_OPERATOR,
+        // end of line/file marker
+        NEWLINE
     };
+
+    Type type;
+
+    // Contents are a view into the source (or into escaped contents, if the literal had escape sequences)
+    bool isEscaped;
+    uint32_t contentsBegin, contentsLength;
+
+    // File is implied by the tokenized file the token belongs to
+    unsigned line;
+};
+
+// Tokens of a single file, stored contiguously. Every file ends with a NEWLINE token.
+class IniTokenizedFile
+{
+public :
+    string source;
+    string escapedContents;
+    vector <IniToken> tokens;
+
+    string getContents (const IniToken& token) const;
+    bool contentsEqual (const IniToken& token, const char* s) const;
+};
+
+// An ini file read by IniIncludeManager: shared by all configurations including it (see IniFileCache)
+class IniCachedFile
+{
+public :
+    string fileName;
+
+    // Tokenized by the first configuration parsing the file: tokenization errors need inclusion context
+    IniTokenizedFile contents;
+    bool isTokenized = false;
+    mutex tokenizeMutex;
 };
 
+// Process-wide cache of ini files opened by include managers. A file is tokenized once while its contents stay the same:
+// it is read again every time to compare.
+class IniFileCache
+{
+public :
+    shared_ptr <IniCachedFile> get (string fileName);
+    void clear();
+
+    static IniFileCache& instance();
+
+private :
+    IniFileCache() = default;
+
+    mutex cacheMutex;
+
+    // By canonical path
+    map <string, shared_ptr <IniCachedFile> > files;
+};
+
+// Input stream over a cached file. IniConfiguration::load takes tokens from the cache instead of tokenizing again.
+class IniCachedInputStream : public IInputStream
+{
+public :
+    explicit IniCachedInputStream (shared_ptr <IniCachedFile> file);
+    ~IniCachedInputStream();
+
+    uint32_t read (char* buffer, uint32_t nBytes);
+    uint32_t getNumBytesRemaining() const;
+
+    IniCachedFile& getCachedFile() const
+    {
+        return *file;
+    }
+
+private :
+    shared_ptr <IniCachedFile> file;
+    uint32_t position;
+};
+
+
 enum class IniRelativeInputStreamFlags : uint32_t
 {
     // File included by #include "..."
@@ -182,9 +392,36 @@ class IniConfiguration
 
 public :
     IniProperty::Accessor operator[] (const string& key);
+    IniProperty::Accessor operator[] (const IniKey& key);
+    IniProperty::Accessor operator[] (IniPropertyHandle handle);
+
+    // Read-only access, the only one frozen configurations have
+    IniProperty::Accessor operator[] (const string& key) const;
+    IniProperty::Accessor operator[] (const IniKey& key) const;
+    IniProperty::Accessor operator[] (IniPropertyHandle handle) const;
+
+    // Resolves the key once. Handles of undefined keys are valid too: the property may be defined later.
+    IniPropertyHandle getHandle (const IniKey& key);
+
+    // Resolves the key without adding it: the handle of a key never met is invalid. Accessors of invalid handles
+    // are read-only & not defined, reads throw (without the key: it is not known).
+    IniPropertyHandle findHandle (const IniKey& key) const;
+
+    // Defined properties of the other configuration replace properties of this one (values & origins)
+    void overrideWith (const IniConfiguration& other);
+
+    // A view over the base configuration: reads fall through to the base, the first write to a property copies it
+    // into the layer. Handles of the base stay valid in the layer. A layer of a layer shares the same base.
+    // The base must not change while layers exist.
+    static unique_ptr <IniConfiguration> createLayer (shared_ptr <const IniConfiguration> base);
 
-    // TODO: Make it save file info for entries coming from file
-    void overrideWith (IniConfiguration& other);
+    // Computes all cached typed values and makes the configuration immutable: concurrent reads are data race free.
+    // Property usage is counted per thread. A layer may be frozen too, its base must not be used by other threads then.
+    static shared_ptr <const IniConfiguration> freeze (unique_ptr <IniConfiguration> configuration);
+
+    // Keys of defined properties never read. Usage counters of a frozen configuration are merged,
+    // so threads reading it must be finished.
+    vector <string> getUnusedProperties() const;
 
     // Issue messages would contain 'on line <..> of <iniSourceName>'
     // Include manager would be used for opening input streams only
@@ -192,57 +429,85 @@ public :
     static unique_ptr <IniConfiguration> load (string iniSourceName, IInputStream* stream,
                                                IRelativeStreamsManager* includeManager);
 
-private :
-    class IniToken
-    {
-    public :
-        enum class Type
-        {
-            // a key or identifier-like operator (e. g. '<key> unite <separator>' construction)
-            // identifiers may contain: A-Z, a-z, 0-9, ., _
-            // 'contents' contains identifier
-            IDENTIFIER,
-            // =, 'contents' empty
-            ASSIGNMENT_OPERATOR,
-            // quoted string, 'contents' contains string with escapes replaced
-            STRING_LITERAL,
-            // string quoted with '<>', used in includes, 'contents' contains string with escapes replaced
-            INCLUSION_LITERAL,
-            // [, 'contents' empty
-            OPEN_BRACKET_OPERATOR,
-            // ], 'contents' empty
-            CLOSE_BRACKET_OPERATOR,
-            // #, 'contents' empty. If not first character of line, invalid token exception is thrown.
-            SHARP_INCLUDE_OPERATOR,
-            // end of line/file marker
-            NEWLINE
-        };
-
-        Type type;
-        string contents;
-        IniFileLocation location;
-        unique_ptr <IniToken> next;
-    };
+    // Stores defined properties & the include graph with the size & content hash of every file
+    void saveSnapshot (IOutputStream* stream) const;
 
-    static constexpr bool isIdentifierSymbol (char c, bool first);
+    // nullptr if the snapshot is missing, invalid or outdated (some file of the include graph changed)
+    static unique_ptr <IniConfiguration> loadSnapshot (string snapshotFileName);
 
-    void appendToken (IniToken*& appendTo, IniToken::Type type, string contents, IniFileId fileId, unsigned line);
+    // Loads the snapshot if it is up to date, otherwise loads the ini file & rewrites the snapshot
+    static unique_ptr <IniConfiguration> loadWithSnapshot (string iniFileName, string snapshotFileName,
+                                                           IniIncludeManager* includeManager);
+
+private :
+    static constexpr bool isIdentifierSymbol (char c, bool first);
 
     string getSourceString (unsigned line, IniFileId fileId);
 
     ATTRIBUTE_NORETURN void invalidToken (string description, IniFileId fileId, unsigned line);
 
-    map <string, IniProperty> properties;
+    static const uint32_t noSlot = ~0u;
+
+    // Slot of a property never changes, so handles are plain indices.
+    // Slots below baseSlotCount belong to the base (layers only), properties of the configuration itself follow.
+    // Properties never move: references given by accessors (e. g. asVector) survive adding other keys.
+    deque <IniProperty> properties;
+
+    // Open addressing hash table: index in properties + 1, 0 for empty entries. Size is a power of two.
+    vector <uint32_t> slotTable;
+
+    shared_ptr <const IniConfiguration> base;
+    uint32_t baseSlotCount = 0, baseFileCount = 0;
+
+    // Base properties written through the layer, by slot
+    map <uint32_t, IniProperty> overrides;
+
+    uint32_t findSlot (const IniKey& key) const;
+    uint32_t findLocalIndex (const IniKey& key) const;
+    uint32_t getSlot (const IniKey& key);
+    void rebuildSlotTable (size_t size);
+
+    uint32_t getNumSlots() const
+    {
+        return baseSlotCount + static_cast <uint32_t> (properties.size());
+    }
+
+    const IniProperty& getProperty (uint32_t slot) const
+    {
+        return slot >= baseSlotCount ? properties[slot - baseSlotCount] : getBaseProperty (slot);
+    }
+
+    const IniProperty& getBaseProperty (uint32_t slot) const;
+    const IniProperty* findOverride (uint32_t slot) const;
+    IniProperty& getWritableProperty (uint32_t slot);
+
+    // The property may be read concurrently (it belongs to a frozen configuration): nothing is cached in it
+    bool isShared (uint32_t slot) const;
+
+    // Read counters of frozen configurations: one array per reading thread, written by its thread only
+    struct UsageCounters;
+    shared_ptr <UsageCounters> usage;
+
+    bool isFrozen() const
+    {
+        return usage != nullptr;
+    }
+
+    void markUsed (const IniProperty& property, uint32_t slot) const;
 
+    // File ids of a layer continue file ids of its base
     vector <string> fileNamesUsed;
+    const string& getFileName (IniFileId fileId) const;
 
     // The following property is helf: file id of included file is more than file id of parent
     // If it is not true, the file is 'root' of inclusions
     vector <IniFileLocation> includedWith;
 
-    unique_ptr <IniToken> tokenizeStreamContents (IInputStream* stream, IniFileId fileId);
+    // File id is used for error messages only
+    unique_ptr <IniTokenizedFile> tokenizeStreamContents (IInputStream* stream, IniFileId fileId);
+    const IniTokenizedFile& getTokenizedContents (IniCachedFile& file, IniFileId fileId);
 
-    unique_ptr <IniToken> tokenizeStringContents (string contents, IniFileId iniFileId);
+    void tokenizeStringContents (IniTokenizedFile& file, IniFileId fileId);
 };
 
 class IniConfigurationException : public Exception
@@ -253,7 +518,8 @@ public :
         INVALID_INI_TOKEN,
         INVALID_INI_SYNTAX,
         INVALID_INI_PROPERTY_VALUE,
-        UNDEFINED_INI_PROPERTY
+        UNDEFINED_INI_PROPERTY,
+        READ_ONLY_INI_CONFIGURATION
     };
 
     IniConfigurationException (const char* fileOrigin, int lineOrigin,
@@ -283,6 +549,7 @@ public :
     unique_ptr <IInputStream> openInputStream (StreamId relativeTo, string relativeName,
                                                void* nameTypeFlagsPointer, RelativeInputStreamFlags flags);
 
+    // Files are opened through IniFileCache (unless flags are passed)
     unique_ptr <IInputStream> openInputStream (string fileName, RelativeInputStreamFlags flags);
     unique_ptr <IInputStream> openInputStream (string fileName, string fileContents);
 
@@ -0,0 +1,202 @@
+/* Binary snapshots of loaded ini configurations.
+
+   Format (native byte order):
+   - header: magic, version (32-bit)
+   - files of the include graph (count, then for every file):
+     name, included with (file id & line), whether it is a real file, size & content hash (64-bit)
+   - defined properties (count, then for every property):
+     key, number of values, then value, file id & line for every value
+   Records & hashes are written & read by src/BinaryData.h.
+
+   A snapshot is up to date if every file of the include graph is a real file with the same contents & the root file
+   is the one loaded (see loadWithSnapshot).
+   Contents of files of the same size are always hashed: modification times have a resolution of a second,
+   an edit keeping the size within the same second would go unnoticed (ini files are small, hashing is cheap).
+*/
+
+#include "IniConfiguration.h"
+#include "BinaryData.h"
+#include "FileSystem.h"
+#include "FileStreams.h"
+#include "Metrics.h"
+#include "ApplicationLog.h"
+
+#include <cstdio>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+using namespace sa;
+using namespace std;
+
+static const uint32_t snapshotMagic = 0x53494153; // "SAIS"
+static const uint32_t snapshotVersion = 2;
+
+void IniConfiguration::saveSnapshot (IOutputStream* stream) const
+{
+    saAssert (!base);
+    IFileSystem& fileSystem = FileSystem::instance();
+
+    BinaryWriter writer;
+    writer.writeInteger (snapshotMagic);
+    writer.writeInteger (snapshotVersion);
+
+    writer.writeInteger (static_cast <uint32_t> (fileNamesUsed.size()));
+    for (size_t i = 0; i < fileNamesUsed.size(); i++)
+    {
+        // Memory buffers & system headers can not be checked: snapshots including them are never up to date
+        FileStatus status = FileStatus { 0, 0 };
+        bool isRealFile = fileSystem.getFileStatus (fileNamesUsed[i], status);
+
+        // Snapshots may be loaded from another working directory
+        writer.writeString (isRealFile ? fileSystem.getCanonicalPath (fileNamesUsed[i]) : fileNamesUsed[i]);
+        writer.writeInteger (includedWith[i].fileId);
+        writer.writeInteger (includedWith[i].line);
+
+        writer.writeInteger (isRealFile ? 1 : 0);
+        writer.writeInteger64 (status.size);
+        writer.writeInteger64 (isRealFile ? hashFileContents (fileNamesUsed[i]) : 0);
+    }
+
+    uint32_t nDefined = 0;
+    for (const IniProperty& property: properties)
+        nDefined += property.defined ? 1 : 0;
+
+    writer.writeInteger (nDefined);
+    for (const IniProperty& property: properties)
+    {
+        if (!property.defined)
+            continue;
+
+        writer.writeString (property.key);
+        writer.writeInteger (static_cast <uint32_t> (property.values.size()));
+        for (size_t i = 0; i < property.values.size(); i++)
+        {
+            writer.writeString (property.values[i]);
+            writer.writeInteger (property.valuesDefinedAt[i].fileId);
+            writer.writeInteger (property.valuesDefinedAt[i].line);
+        }
+    }
+
+    saVerify (writer.contents.length() <= UINT32_MAX);
+    stream->write (writer.contents.data(), static_cast <uint32_t> (writer.contents.length()));
+}
+
+unique_ptr <IniConfiguration> IniConfiguration::loadSnapshot (string snapshotFileName)
+{
+    IFileSystem& fileSystem = FileSystem::instance();
+    if (!fileSystem.fileExists (snapshotFileName))
+        return nullptr;
+
+    using namespace boost::interprocess;
+
+    unique_ptr <mapped_region> region;
+    try
+    {
+        file_mapping mapping (snapshotFileName.c_str(), read_only);
+        region.reset (new mapped_region (mapping, read_only));
+    }
+    catch (interprocess_exception&)
+    {
+        return nullptr;
+    }
+
+    BinaryReader reader (static_cast <const char*> (region->get_address()), region->get_size());
+    if (reader.readInteger() != snapshotMagic || reader.readInteger() != snapshotVersion)
+        return nullptr;
+
+    unique_ptr <IniConfiguration> configuration (new IniConfiguration);
+
+    uint32_t nFiles = reader.readInteger();
+    for (uint32_t i = 0; i < nFiles && reader.isOk(); i++)
+    {
+        string fileName = reader.readString();
+        IniFileLocation location;
+        location.fileId = reader.readInteger();
+        location.line = reader.readInteger();
+
+        bool isRealFile = reader.readInteger() != 0;
+        uint64_t size = reader.readInteger64();
+        uint64_t hash = reader.readInteger64();
+
+        // A file is included by an earlier one (the root by itself): ids read are used as indices, cycles would
+        // never end getSourceString
+        bool isIncludedEarlier = i == 0 ? location.fileId == 0 : location.fileId < i;
+
+        FileStatus status;
+        if (!reader.isOk() || !isIncludedEarlier || !isRealFile || !fileSystem.getFileStatus (fileName, status))
+            return nullptr;
+
+        // Touched but not changed files keep the snapshot valid
+        if (status.size != size || hashFileContents (fileName) != hash)
+            return nullptr;
+
+        configuration->fileNamesUsed.push_back (fileName);
+        configuration->includedWith.push_back (location);
+    }
+
+    uint32_t nProperties = reader.readInteger();
+    for (uint32_t i = 0; i < nProperties && reader.isOk(); i++)
+    {
+        string key = reader.readString();
+        IniProperty& property = configuration->properties[configuration->getSlot (IniKey (key))];
+
+        uint32_t nValues = reader.readInteger();
+        for (uint32_t j = 0; j < nValues && reader.isOk(); j++)
+        {
+            property.values.push_back (reader.readString());
+
+            IniFileLocation location;
+            location.fileId = reader.readInteger();
+            location.line = reader.readInteger();
+            if (location.fileId >= nFiles)
+                return nullptr;
+
+            property.valuesDefinedAt.push_back (location);
+        }
+
+        property.valuesChanged();
+    }
+
+    if (!reader.isOk() || !reader.isAtEnd() || configuration->fileNamesUsed.empty())
+        return nullptr;
+
+    return configuration;
+}
+
+unique_ptr <IniConfiguration> IniConfiguration::loadWithSnapshot (string iniFileName, string snapshotFileName,
+                                                                  IniIncludeManager* includeManager)
+{
+    unique_ptr <IniConfiguration> configuration = loadSnapshot (snapshotFileName);
+
+    // A snapshot of another project is outdated too: its include graph tells nothing of this one
+    IFileSystem& fileSystem = FileSystem::instance();
+    string rootFileName = fileSystem.fileExists (iniFileName) ? fileSystem.getCanonicalPath (iniFileName) : iniFileName;
+    if (configuration && configuration->fileNamesUsed[0] != rootFileName)
+        configuration.reset();
+
+    if (configuration)
+    {
+        metrics::configurationSnapshotHits.add();
+        saLog ("Configuration loaded from snapshot '%1'") << snapshotFileName;
+        return configuration;
+    }
+
+    unique_ptr <IInputStream> stream = includeManager->openInputStream (iniFileName, RelativeInputStreamFlags::NONE);
+    configuration = load (iniFileName, stream.get(), includeManager);
+
+    // Written aside & renamed: concurrent runs never see a partial snapshot
+    string temporaryFileName = getTemporaryFileName (snapshotFileName);
+    {
+        unique_ptr <FileOutputStream> snapshot
+            = FileOutputStream::openOutputStream (temporaryFileName, RelativeOutputStreamFlags::BINARY);
+        configuration->saveSnapshot (snapshot.get());
+    }
+
+    if (rename (temporaryFileName.c_str(), snapshotFileName.c_str()) != 0)
+        throw InputOutputException (__ORIGIN__, "configuration snapshot '" + snapshotFileName + "'", "Rename");
+
+    metrics::configurationSnapshotMisses.add();
+    saLog ("Configuration snapshot '%1' rebuilt") << snapshotFileName;
+    return configuration;
+}
@@ -1,10 +1,44 @@
 #include "Internationalization.h"
+#include "TranslationCatalog.h"
+
+#include <cstring>
 
 using namespace sa;
 
-string sa::InternationalizationEngine::getTranslated (string pureString)
+const char* sa::InternationalizationEngine::getTranslated (const char* pureString)
+{
+    const TranslationCatalog* catalog = currentCatalog.load (memory_order_acquire);
+    if (!catalog)
+        return pureString;
+
+    const char* translated = catalog->find (pureString, strlen (pureString));
+    return translated ? translated : pureString;
+}
+
+string sa::InternationalizationEngine::getTranslated (const string& pureString)
+{
+    const TranslationCatalog* catalog = currentCatalog.load (memory_order_acquire);
+    if (!catalog)
+        return pureString;
+
+    const char* translated = catalog->find (pureString.data(), pureString.length());
+    return translated ? string (translated) : pureString;
+}
+
+void sa::InternationalizationEngine::setCatalog (unique_ptr <TranslationCatalog> catalog)
+{
+    lock_guard <mutex> lock (catalogsMutex);
+
+    currentCatalog.store (catalog.get(), memory_order_release);
+    if (catalog)
+        catalogs.push_back (move (catalog));
+
+    generation.fetch_add (1, memory_order_acq_rel);
+}
+
+void sa::InternationalizationEngine::loadCatalog (string fileName)
 {
-    return pureString;
+    setCatalog (TranslationCatalog::open (fileName));
 }
 
 InternationalizationEngine& sa::InternationalizationEngine::instance()
@@ -13,5 +47,9 @@ InternationalizationEngine& sa::InternationalizationEngine::instance()
     return theInstance;
 }
 
-sa::InternationalizationEngine::InternationalizationEngine()
+sa::InternationalizationEngine::InternationalizationEngine() :
+    currentCatalog (nullptr), generation (0)
+{}
+
+sa::InternationalizationEngine::~InternationalizationEngine()
 {}
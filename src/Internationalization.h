@@ -1,22 +1,57 @@
 #ifndef STYLE_ANALYZER_INTERNATIONALIZATION_H
 #define STYLE_ANALYZER_INTERNATIONALIZATION_H
 
+/* Translation of user-visible strings (log messages, reports).
+
+   Source strings are English, a translation catalog (see TranslationCatalog.h) may be loaded to replace them.
+   Format string literals are translated once per call site (see FormatCallSite in StringFormatter.h):
+   call sites remember the catalog generation they were resolved with, so switching the catalog only
+   increments the generation and every call site translates its string again on the next use.
+*/
+
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace sa
 {
 
 using namespace std;
 
+class TranslationCatalog;
+
 class InternationalizationEngine
 {
 public :
-    string getTranslated (string pureString);
+    ~InternationalizationEngine();
+
+    // String literals: the result is either the literal itself or a catalog string living as long as the engine
+    const char* getTranslated (const char* pureString);
+    string getTranslated (const string& pureString);
+
+    // Replaces the catalog in use, nullptr switches back to the source (English) strings.
+    // Catalogs replaced are kept alive, as other threads may still use their strings.
+    void setCatalog (unique_ptr <TranslationCatalog> catalog);
+    void loadCatalog (string fileName);
+
+    // Changes on every catalog switch
+    uint32_t getGeneration() const
+    {
+        return generation.load (memory_order_acquire);
+    }
 
     static InternationalizationEngine& instance();
 
 private :
     InternationalizationEngine();
+
+    atomic <const TranslationCatalog*> currentCatalog;
+    atomic <uint32_t> generation;
+
+    mutex catalogsMutex;
+    vector < unique_ptr <TranslationCatalog> > catalogs;
 };
 
 }
@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "LanguageServer.h"
+#include "ApplicationLog.h"
+#include "IncrementalSession.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+using namespace sa;
+using namespace std;
+
+using boost::property_tree::ptree;
+
+sa::TextLineIndex::TextLineIndex (const string& text) :
+    text (text)
+{
+    lineBegins.push_back (0);
+    for (size_t i = text.find ('\n'); i != string::npos; i = text.find ('\n', i + 1))
+        lineBegins.push_back (static_cast <uint32_t> (i + 1));
+}
+
+uint32_t sa::TextLineIndex::getOffset (uint32_t line, uint32_t character) const
+{
+    if (line >= lineBegins.size())
+        return static_cast <uint32_t> (text.length());
+
+    uint32_t offset = lineBegins[line];
+    for (uint32_t nUnits = 0; nUnits < character && offset < text.length() && text[offset] != '\n'; )
+    {
+        unsigned char lead = static_cast <unsigned char> (text[offset]);
+
+        // UTF-8 sequence of the code point: 4 bytes are 2 UTF-16 units
+        offset++;
+        while (offset < text.length() && (static_cast <unsigned char> (text[offset]) & 0xC0) == 0x80)
+            offset++;
+        nUnits += lead >= 0xF0 ? 2 : 1;
+    }
+
+    return offset;
+}
+
+void sa::TextLineIndex::getPosition (uint32_t offset, uint32_t& line, uint32_t& character) const
+{
+    offset = min (offset, static_cast <uint32_t> (text.length()));
+    line = static_cast <uint32_t> (upper_bound (lineBegins.begin(), lineBegins.end(), offset) - lineBegins.begin() - 1);
+
+    character = 0;
+    for (uint32_t i = lineBegins[line]; i < offset; i++)
+    {
+        unsigned char byte = static_cast <unsigned char> (text[i]);
+        if ((byte & 0xC0) != 0x80)
+            character += byte >= 0xF0 ? 2 : 1;
+    }
+}
+
+string sa::convertUriToPath (const string& uri)
+{
+    string path = uri.compare (0, 7, "file://") == 0 ? uri.substr (7) : uri;
+
+    string result;
+    for (size_t i = 0; i < path.length(); i++)
+    {
+        if (path[i] == '%' && i + 2 < path.length() &&
+            isxdigit (static_cast <unsigned char> (path[i + 1])) &&
+            isxdigit (static_cast <unsigned char> (path[i + 2])))
+        {
+            result += static_cast <char> (stoi (path.substr (i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            result += path[i];
+        }
+    }
+
+    return result;
+}
+
+static string escapeJson (const string& s)
+{
+    string result;
+    for (char c: s)
+    {
+        switch (c)
+        {
+            case '"':  result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n";  break;
+            case '\r': result += "\\r";  break;
+            case '\t': result += "\\t";  break;
+
+            default:
+                if (static_cast <unsigned char> (c) < 0x20)
+                {
+                    char escaped[8];
+                    snprintf (escaped, sizeof escaped, "\\u%04x", static_cast <unsigned> (c));
+                    result += escaped;
+                }
+                else
+                {
+                    result += c;
+                }
+        }
+    }
+
+    return result;
+}
+
+// The parsed tree keeps no types: a numeric id is written back as a number
+static string formatRequestId (const string& id)
+{
+    bool isNumber = !id.empty() && all_of (id.begin(), id.end(),
+                                           [] (char c) { return isdigit (static_cast <unsigned char> (c)) || c == '-'; });
+    return isNumber ? id : "\"" + escapeJson (id) + "\"";
+}
+
+struct LanguageServer::Document
+{
+    string uri, fileName;
+    int64_t version;
+
+    // As the editor has it
+    string text;
+
+    // Analyzed text is the file context contents, diagnostics are for it
+    unique_ptr <IncrementalSession> session;
+    vector <StyleDiagnostic> diagnostics;
+
+    bool hasChanges, isFullCheckPending;
+    chrono::steady_clock::time_point firstChangeTime, analysisDeadline, fullCheckDeadline;
+};
+
+sa::LanguageServer::LanguageServer (const IniConfiguration& project, int inputFd, IOutputStream* outputStream) :
+    inputFd (inputFd), outputStream (outputStream), rules (StyleRules::load (project)), debounceInterval (20),
+    fullCheckDelay (300), isShutdownRequested (false), isExitRequested (false)
+{
+    if (project["datagrabbing.commonclangoptions"].isDefined())
+        compilerOptions = project["datagrabbing.commonclangoptions"].asVector();
+
+    if (project["languageserver.debouncemilliseconds"].isDefined())
+        debounceInterval = chrono::milliseconds (max (project["languageserver.debouncemilliseconds"].asInteger(), 0));
+
+    if (project["languageserver.fullcheckmilliseconds"].isDefined())
+        fullCheckDelay = chrono::milliseconds (max (project["languageserver.fullcheckmilliseconds"].asInteger(), 0));
+}
+
+sa::LanguageServer::~LanguageServer()
+{}
+
+int sa::LanguageServer::run()
+{
+    saLog ("Language server started");
+
+    while (!isExitRequested)
+    {
+        // Sleeps until input or the nearest scheduled analysis
+        int timeout = -1;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        for (const auto& it: documents)
+        {
+            const Document& document = *it.second;
+            if (!document.hasChanges && !document.isFullCheckPending)
+                continue;
+
+            chrono::steady_clock::time_point deadline = document.hasChanges ? document.analysisDeadline :
+                                                                             document.fullCheckDeadline;
+            int64_t wait = max <int64_t> (chrono::duration_cast <chrono::milliseconds> (deadline - now).count(), 0);
+            timeout = static_cast <int> (timeout < 0 ? wait : min <int64_t> (timeout, wait));
+        }
+
+        pollfd descriptor = pollfd { inputFd, POLLIN, 0 };
+        int nReady = poll (&descriptor, 1, timeout);
+        if (nReady < 0 && errno != EINTR)
+            break;
+
+        if (nReady > 0 && !readInput())
+        {
+            saLog ("Language server input ended");
+            break;
+        }
+
+        runScheduledAnalyses();
+    }
+
+    // The protocol: exit code 0 after 'shutdown' only
+    return isShutdownRequested ? 0 : 1;
+}
+
+bool sa::LanguageServer::readInput()
+{
+    char buffer[65536];
+    ssize_t nRead = read (inputFd, buffer, sizeof buffer);
+    if (nRead < 0 && errno == EINTR)
+        return true;
+    if (nRead <= 0)
+        return false;
+
+    inputBuffer.append (buffer, static_cast <size_t> (nRead));
+
+    // Header lines, an empty line, then 'Content-Length' bytes of the body
+    for (;;)
+    {
+        size_t headerEnd = inputBuffer.find ("\r\n\r\n");
+        if (headerEnd == string::npos)
+            return true;
+
+        bool isContentLengthFound = false;
+        string contentLengthValue;
+        istringstream headers (inputBuffer.substr (0, headerEnd));
+        for (string header; getline (headers, header); )
+        {
+            if (toLower (header.substr (0, 15)) == "content-length:")
+            {
+                isContentLengthFound = true;
+                size_t valueStart = header.find_first_not_of (" \t", 15), valueEnd = header.find_last_not_of (" \t\r");
+                contentLengthValue = valueStart <= valueEnd && valueEnd != string::npos ?
+                                     header.substr (valueStart, valueEnd + 1 - valueStart) : "";
+            }
+        }
+
+        if (!isContentLengthFound)
+        {
+            saError ("Language server: message without 'Content-Length' dropped");
+            inputBuffer.erase (0, headerEnd + 4);
+            continue;
+        }
+
+        // ASCII digits only: stoul takes signs & leading spaces, a negative length would wrap
+        size_t contentLength = 0;
+        bool isDigits = !contentLengthValue.empty() &&
+                        all_of (contentLengthValue.begin(), contentLengthValue.end(),
+                                [] (char c) { return c >= '0' && c <= '9'; });
+        try
+        {
+            if (isDigits)
+                contentLength = static_cast <size_t> (stoul (contentLengthValue));
+        }
+        catch (out_of_range&)
+        {
+            isDigits = false;
+        }
+
+        if (!isDigits)
+        {
+            // Not a number or out of range: the body can not be found, the headers are dropped alone
+            saError ("Language server: message with malformed 'Content-Length' (%1) dropped") << contentLengthValue;
+            inputBuffer.erase (0, headerEnd + 4);
+            continue;
+        }
+
+        if (contentLength > inputBuffer.length() - headerEnd - 4)
+            return true;
+
+        string body = inputBuffer.substr (headerEnd + 4, contentLength);
+        inputBuffer.erase (0, headerEnd + 4 + contentLength);
+        handleMessage (body);
+    }
+}
+
+void sa::LanguageServer::handleMessage (const string& body)
+{
+    ptree message;
+    try
+    {
+        istringstream stream (body);
+        boost::property_tree::read_json (stream, message);
+    }
+    catch (boost::property_tree::json_parser_error& e)
+    {
+        saError ("Language server: malformed message dropped: %1") << e.what();
+        return;
+    }
+
+    string method = message.get <string> ("method", "");
+    boost::optional <string> id = message.get_optional <string> ("id");
+
+    try
+    {
+        if (method == "initialize" && id)
+        {
+            sendResult (*id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2}},"
+                             "\"serverInfo\":{\"name\":\"style-analyzer\"}}");
+        }
+        else if (method == "shutdown" && id)
+        {
+            isShutdownRequested = true;
+            sendResult (*id, "null");
+        }
+        else if (method == "exit")
+        {
+            isExitRequested = true;
+        }
+        else if (method == "textDocument/didOpen")
+        {
+            openDocument (message.get <string> ("params.textDocument.uri"),
+                          message.get <int64_t> ("params.textDocument.version", 0),
+                          message.get <string> ("params.textDocument.text"));
+        }
+        else if (method == "textDocument/didClose")
+        {
+            closeDocument (message.get <string> ("params.textDocument.uri"));
+        }
+        else if (method == "textDocument/didChange")
+        {
+            auto it = documents.find (message.get <string> ("params.textDocument.uri"));
+            if (it == documents.end())
+                return;
+
+            Document& document = *it->second;
+            document.version = message.get <int64_t> ("params.textDocument.version", document.version);
+
+            for (const auto& change: message.get_child ("params.contentChanges"))
+            {
+                const string& text = change.second.get <string> ("text");
+                boost::optional <const ptree&> range = change.second.get_child_optional ("range");
+                if (!range)
+                {
+                    document.text = text;
+                    continue;
+                }
+
+                TextLineIndex index (document.text);
+                uint32_t begin = index.getOffset (range->get <uint32_t> ("start.line"),
+                                                  range->get <uint32_t> ("start.character"));
+                uint32_t end = index.getOffset (range->get <uint32_t> ("end.line"), range->get <uint32_t> ("end.character"));
+                document.text.replace (begin, max (begin, end) - begin, text);
+            }
+
+            // Typing delays the analysis, but not for long
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if (!document.hasChanges)
+                document.firstChangeTime = now;
+            document.hasChanges = true;
+            document.analysisDeadline = min (now + debounceInterval, document.firstChangeTime + 2 * debounceInterval);
+        }
+        else if (id && method.compare (0, 2, "$/") != 0)
+        {
+            sendError (*id, -32601, "Method not found: " + method);
+        }
+    }
+    catch (boost::property_tree::ptree_error& e)
+    {
+        saError ("Language server: malformed '%1' message: %2") << method << e.what();
+        if (id)
+            sendError (*id, -32602, e.what());
+    }
+}
+
+void sa::LanguageServer::sendMessage (const string& body)
+{
+    string message = "Content-Length: " + to_string (body.length()) + "\r\n\r\n" + body;
+    outputStream->write (message.data(), static_cast <uint32_t> (message.length()));
+}
+
+void sa::LanguageServer::sendResult (const string& id, const string& result)
+{
+    sendMessage ("{\"jsonrpc\":\"2.0\",\"id\":" + formatRequestId (id) + ",\"result\":" + result + "}");
+}
+
+void sa::LanguageServer::sendError (const string& id, int code, const string& message)
+{
+    sendMessage ("{\"jsonrpc\":\"2.0\",\"id\":" + formatRequestId (id) + ",\"error\":{\"code\":" + to_string (code) +
+                 ",\"message\":\"" + escapeJson (message) + "\"}}");
+}
+
+void sa::LanguageServer::openDocument (const string& uri, int64_t version, const string& text)
+{
+    unique_ptr <Document> document (new Document());
+    document->uri = uri;
+    document->fileName = convertUriToPath (uri);
+    document->version = version;
+    document->text = text;
+
+    // Analyzed at once: there is nothing to show yet
+    document->hasChanges = true;
+    document->firstChangeTime = document->analysisDeadline = chrono::steady_clock::now();
+    document->isFullCheckPending = false;
+
+    saLog ("Language server: document '%1' opened") << document->fileName;
+    documents[uri] = move (document);
+}
+
+void sa::LanguageServer::closeDocument (const string& uri)
+{
+    auto it = documents.find (uri);
+    if (it == documents.end())
+        return;
+
+    it->second->diagnostics.clear();
+    publishDiagnostics (*it->second);
+    documents.erase (it);
+}
+
+void sa::LanguageServer::runScheduledAnalyses()
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+    for (auto& it: documents)
+    {
+        Document& document = *it.second;
+
+        try
+        {
+            if (document.hasChanges && document.analysisDeadline <= now)
+                analyzeChanges (document);
+            else if (!document.hasChanges && document.isFullCheckPending && document.fullCheckDeadline <= now)
+                checkWholeDocument (document);
+        }
+        catch (Exception& e)
+        {
+            // The session starts anew on the next edit
+            saError ("Language server: analysis of '%1' failed:\n%2") << document.fileName << e.toString();
+            document.session.reset();
+            document.hasChanges = document.isFullCheckPending = false;
+        }
+    }
+}
+
+void sa::LanguageServer::analyzeChanges (Document& document)
+{
+    saTraceScope ("Analyze changes", "file", document.fileName);
+    document.hasChanges = false;
+
+    if (document.session)
+    {
+        updateDiagnostics (document);
+    }
+    else
+    {
+        document.session.reset (new IncrementalSession (document.fileName, document.text, compilerOptions));
+        document.diagnostics = checkStyle (document.session->getFileContext(), rules, 0, UINT32_MAX);
+    }
+
+    publishDiagnostics (document);
+
+    double seconds = chrono::duration <double> (chrono::steady_clock::now() - document.firstChangeTime).count();
+    metrics::lspPublishSeconds.observe (seconds);
+    saLog ("Language server: %1 diagnostics of '%2' version %3 published %4 ms after the edit")
+        << document.diagnostics.size() << document.fileName << document.version << seconds * 1000;
+}
+
+void sa::LanguageServer::updateDiagnostics (Document& document)
+{
+    // The edits since the last analysis as one: the text between the common prefix & suffix
+    const string& oldText = document.session->getFileContext().getFileContents();
+    const string& newText = document.text;
+
+    size_t maxCommon = min (oldText.length(), newText.length());
+    size_t prefix = static_cast <size_t> (mismatch (oldText.begin(), oldText.begin() + static_cast <ptrdiff_t> (maxCommon),
+                                                    newText.begin()).first - oldText.begin());
+    size_t suffix = 0;
+    while (suffix < maxCommon - prefix && oldText[oldText.length() - 1 - suffix] == newText[newText.length() - 1 - suffix])
+        suffix++;
+
+    if (prefix == oldText.length() && prefix == newText.length())
+        return;
+
+    // Typed text is checked first, the rest of the file later
+    document.isFullCheckPending = true;
+    document.fullCheckDeadline = chrono::steady_clock::now() + fullCheckDelay;
+
+    uint32_t nRemoved = static_cast <uint32_t> (oldText.length() - prefix - suffix);
+    uint32_t nInserted = static_cast <uint32_t> (newText.length() - prefix - suffix);
+    document.session->applyEdit (static_cast <uint32_t> (prefix), nRemoved, newText.substr (prefix, nInserted));
+
+    // Changed lines & the next one: its indentation is relative to them
+    size_t rangeBegin = newText.rfind ('\n', prefix == 0 ? 0 : prefix - 1);
+    rangeBegin = rangeBegin == string::npos || prefix == 0 ? 0 : rangeBegin + 1;
+    size_t rangeEnd = newText.find ('\n', prefix + nInserted);
+    if (rangeEnd != string::npos)
+        rangeEnd = newText.find ('\n', rangeEnd + 1);
+    rangeEnd = rangeEnd == string::npos ? newText.length() : rangeEnd + 1;
+
+    uint32_t oldRangeEnd = static_cast <uint32_t> (rangeEnd) - nInserted + nRemoved;
+    vector <StyleDiagnostic> diagnostics = checkStyle (document.session->getFileContext(), rules,
+                                                       static_cast <uint32_t> (rangeBegin), static_cast <uint32_t> (rangeEnd));
+
+    for (const StyleDiagnostic& diagnostic: document.diagnostics)
+    {
+        if (diagnostic.fileBufferOffset < rangeBegin)
+            diagnostics.push_back (diagnostic);
+        else if (diagnostic.fileBufferOffset >= oldRangeEnd)
+        {
+            diagnostics.push_back (diagnostic);
+            diagnostics.back().fileBufferOffset = diagnostic.fileBufferOffset - nRemoved + nInserted;
+        }
+    }
+
+    stable_sort (diagnostics.begin(), diagnostics.end(), [] (const StyleDiagnostic& a, const StyleDiagnostic& b)
+                 { return a.fileBufferOffset < b.fileBufferOffset; });
+    document.diagnostics = move (diagnostics);
+}
+
+void sa::LanguageServer::checkWholeDocument (Document& document)
+{
+    saTraceScope ("Check whole document", "file", document.fileName);
+    document.isFullCheckPending = false;
+
+    vector <StyleDiagnostic> diagnostics = checkStyle (document.session->getFileContext(), rules, 0, UINT32_MAX);
+    if (diagnostics == document.diagnostics)
+        return;
+
+    document.diagnostics = move (diagnostics);
+    publishDiagnostics (document);
+}
+
+void sa::LanguageServer::publishDiagnostics (Document& document)
+{
+    // Diagnostics refer to the analyzed text, the same as the editor text unless the document is closed
+    const string& text = document.session ? document.session->getFileContext().getFileContents() : document.text;
+    TextLineIndex index (text);
+
+    string body = "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":\"" +
+                  escapeJson (document.uri) + "\",\"version\":" + to_string (document.version) + ",\"diagnostics\":[";
+
+    for (size_t i = 0; i < document.diagnostics.size(); i++)
+    {
+        const StyleDiagnostic& diagnostic = document.diagnostics[i];
+        uint32_t beginLine, beginCharacter, endLine, endCharacter;
+        index.getPosition (diagnostic.fileBufferOffset, beginLine, beginCharacter);
+        index.getPosition (diagnostic.fileBufferOffset + diagnostic.length, endLine, endCharacter);
+
+        body += string (i ? "," : "") + "{\"range\":{\"start\":{\"line\":" + to_string (beginLine) + ",\"character\":" +
+                to_string (beginCharacter) + "},\"end\":{\"line\":" + to_string (endLine) + ",\"character\":" +
+                to_string (endCharacter) + "}},\"severity\":2,\"code\":\"" + diagnostic.code +
+                "\",\"source\":\"style-analyzer\",\"message\":\"" + escapeJson (diagnostic.message) + "\"}";
+    }
+
+    sendMessage (body + "]}}");
+}
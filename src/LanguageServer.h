@@ -0,0 +1,105 @@
+#ifndef STYLE_ANALYZER_LANGUAGE_SERVER_H
+#define STYLE_ANALYZER_LANGUAGE_SERVER_H
+
+/* Language server: style diagnostics (see StyleDiagnostics.h) published to an editor as the user types.
+
+   'style-analyzer --lsp <project file>' speaks the Language Server Protocol (JSON-RPC, 'Content-Length' framed)
+   on stdin & stdout until the editor sends 'exit'. Logs go to the application log & stderr as usual.
+   - documents are kept in memory from 'textDocument/didOpen' to 'didClose', each in an IncrementalSession:
+     its translation unit is reused, an edit reparses it & updates the file context around the edit only
+   - edits (incremental synchronization) are applied to the text at once, the analysis runs when no edits came
+     for 'DebounceMilliseconds' (20 by default), at most twice as long after the first edit of a burst
+   - the changed lines & the line after them (its indentation is relative) are checked & published first,
+     diagnostics elsewhere are kept from the previous analysis, moved along the edit. The whole file is checked
+     'FullCheckMilliseconds' (300 by default) after an analysis & published again if anything differs
+   - the time from the first edit of a burst to the publication is logged & observed in sa_lsp_publish_seconds:
+     50 ms is the target
+   Keys are in the [languageServer] section, clang options are dataGrabbing.CommonClangOptions.
+   Protocol positions are lines & UTF-16 code units.
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IniConfiguration.h"
+#include "StyleDiagnostics.h"
+#include "Streams.h"
+
+namespace sa
+{
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+// Converts protocol positions to file buffer offsets & back
+class TextLineIndex
+{
+public :
+    explicit TextLineIndex (const string& text);
+
+    // Positions past the line end or the text end are clamped
+    uint32_t getOffset (uint32_t line, uint32_t character) const;
+
+    void getPosition (uint32_t offset, uint32_t& line, uint32_t& character) const;
+
+private :
+    const string& text;
+    vector <uint32_t> lineBegins;
+};
+
+// 'file:///a%20b.cpp' is '/a b.cpp'
+string convertUriToPath (const string& uri);
+
+class LanguageServer
+{
+public :
+    LanguageServer (const IniConfiguration& project, int inputFd, IOutputStream* outputStream);
+    ~LanguageServer();
+
+    // Serves until 'exit' or the end of input, returns the exit code
+    int run();
+
+private :
+    LanguageServer (const LanguageServer&) = delete;
+    LanguageServer& operator= (const LanguageServer&) = delete;
+
+    struct Document;
+
+    int inputFd;
+    IOutputStream* outputStream;
+
+    StyleRules rules;
+    vector <string> compilerOptions;
+    std::chrono::milliseconds debounceInterval, fullCheckDelay;
+
+    string inputBuffer;
+    std::map <string, unique_ptr <Document>> documents;
+    bool isShutdownRequested, isExitRequested;
+
+    // Returns false at the end of input
+    bool readInput();
+    void handleMessage (const string& body);
+
+    void sendMessage (const string& body);
+    void sendResult (const string& id, const string& result);
+    void sendError (const string& id, int code, const string& message);
+
+    void openDocument (const string& uri, int64_t version, const string& text);
+    void closeDocument (const string& uri);
+
+    void runScheduledAnalyses();
+    void analyzeChanges (Document& document);
+    // Changed lines are checked, diagnostics elsewhere are moved along the edit
+    void updateDiagnostics (Document& document);
+    void checkWholeDocument (Document& document);
+    void publishDiagnostics (Document& document);
+};
+
+}
+
+#endif // STYLE_ANALYZER_LANGUAGE_SERVER_H
@@ -15,9 +15,6 @@ sa::ClangIndex::~ClangIndex()
 {
     if (theIndex)
         clang_disposeIndex (theIndex);
-
-    for (auto it: unitsAllocated)
-        clang_disposeTranslationUnit (it);
 }
 
 sa::ClangIndex::operator CXIndex()
@@ -51,9 +48,15 @@ ClangTranslationUnit sa::ClangIndex::parseTranslationUnit (const char* sourceFil
 {
     saAssert (theIndex);
 
-    CXTranslationUnit unit = clang_parseTranslationUnit (theIndex, sourceFilename, commandLineArgs,
-                                                         nCommandLineArgs, unsavedFiles, nUnsavedFiles, options);
-    unitsAllocated.push_back (unit);
+    return ClangTranslationUnit (clang_parseTranslationUnit (theIndex, sourceFilename, commandLineArgs, nCommandLineArgs,
+                                                             unsavedFiles, nUnsavedFiles, options));
+}
+
+ClangTranslationUnit sa::ClangIndex::loadTranslationUnit (const string& astFilename)
+{
+    CXTranslationUnit unit = nullptr;
+    if (clang_createTranslationUnit2 (theIndex, astFilename.c_str(), &unit) != CXError_Success)
+        return ClangTranslationUnit (nullptr);
 
     return ClangTranslationUnit (unit);
 }
@@ -62,10 +65,46 @@ sa::ClangTranslationUnit::ClangTranslationUnit (CXTranslationUnit unit) :
     theUnit (unit)
 {}
 
+sa::ClangTranslationUnit::ClangTranslationUnit (ClangTranslationUnit&& other) :
+    theUnit (other.theUnit)
+{
+    other.theUnit = nullptr;
+}
+
+ClangTranslationUnit& sa::ClangTranslationUnit::operator= (ClangTranslationUnit&& other)
+{
+    if (this != &other)
+    {
+        dispose();
+        theUnit = other.theUnit;
+        other.theUnit = nullptr;
+    }
+
+    return *this;
+}
+
+sa::ClangTranslationUnit::~ClangTranslationUnit()
+{
+    dispose();
+}
+
+void sa::ClangTranslationUnit::dispose()
+{
+    if (theUnit)
+        clang_disposeTranslationUnit (theUnit);
+    theUnit = nullptr;
+}
+
 ClangDiagnostic::ClangDiagnostic (CXDiagnostic diagnostic) :
     diagnostic (diagnostic)
 {}
 
+ClangDiagnostic::ClangDiagnostic (ClangDiagnostic&& other) :
+    diagnostic (other.diagnostic)
+{
+    other.diagnostic = nullptr;
+}
+
 string sa::ClangDiagnostic::formatDiagnostic (unsigned int options)
 {
     return convertCXString (clang_formatDiagnostic (diagnostic, options));
@@ -73,7 +112,8 @@ string sa::ClangDiagnostic::formatDiagnostic (unsigned int options)
 
 ClangDiagnostic::~ClangDiagnostic()
 {
-    clang_disposeDiagnostic (diagnostic);
+    if (diagnostic)
+        clang_disposeDiagnostic (diagnostic);
 }
 
 CXDiagnosticSeverity ClangDiagnostic::getSeverity()
@@ -18,26 +18,41 @@ class ClangDiagnostic
 {
 public :
     ClangDiagnostic (CXDiagnostic diagnostic);
+    ClangDiagnostic (ClangDiagnostic&& other);
     ~ClangDiagnostic();
 
     string formatDiagnostic (unsigned options);
     CXDiagnosticSeverity getSeverity();
 
 private :
+    ClangDiagnostic (const ClangDiagnostic&) = delete;
+    ClangDiagnostic& operator= (const ClangDiagnostic&) = delete;
+
     CXDiagnostic diagnostic;
 };
 
+// Owns the unit: disposed with the object, must not outlive the index it was created with.
+// Objects made from the unit (contexts, strings) do not refer to it: dispose it as soon as they are made.
 class ClangTranslationUnit
 {
 public :
     ClangTranslationUnit (CXTranslationUnit unit);
+    ClangTranslationUnit (ClangTranslationUnit&& other);
+    ClangTranslationUnit& operator= (ClangTranslationUnit&& other);
+    ~ClangTranslationUnit();
 
     int getNumDiagnostics();
     ClangDiagnostic getDiagnostic (int i);
 
+    // Leaves a null unit
+    void dispose();
+
     operator CXTranslationUnit();
 
 private :
+    ClangTranslationUnit (const ClangTranslationUnit&) = delete;
+    ClangTranslationUnit& operator= (const ClangTranslationUnit&) = delete;
+
     CXTranslationUnit theUnit;
 };
 
@@ -57,11 +72,16 @@ public :
     ClangTranslationUnit parseTranslationUnit (const string& sourceFilename, const vector <string>& commandLineArgs,
                                                unsigned options = CXTranslationUnit_None);
 
+    // A unit saved by clang_saveTranslationUnit; a null unit if it can not be read
+    ClangTranslationUnit loadTranslationUnit (const string& astFilename);
+
     operator CXIndex ();
 
 private:
+    ClangIndex (const ClangIndex&) = delete;
+    ClangIndex& operator= (const ClangIndex&) = delete;
+
     CXIndex theIndex;
-    vector <CXTranslationUnit> unitsAllocated;
 };
 
 string cxTokenKindToString (CXTokenKind kind);
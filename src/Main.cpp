@@ -2,6 +2,8 @@
 #include <cstdio>
 #include <cassert>
 #include <cstdint>
+#include <chrono>
+#include <iterator>
 #include <boost/concept_check.hpp>
 
 #include "ProjectContext.h"
@@ -10,75 +12,79 @@
 #include "ApplicationLog.h"
 #include "IniConfiguration.h"
 #include "LibclangHelpers.h"
+#include "Internationalization.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "DataGrabbing.h"
+#include "LanguageServer.h"
+
+#include <unistd.h>
 
 using namespace std;
 
+// Written when the tool finishes, set by '--trace' or the common.tracefile key
+static string traceFileName;
+
+// Set by '--stdin': the source is read from stdin & grabbed under this name instead of dataGrabbing.Files
+static string stdinFileName;
+
+// Set by '--lsp': the tool serves an editor on stdin & stdout instead of grabbing data
+static bool isLanguageServerMode = false;
+
 void printTranslationUnitParseFailure()
 {
     printf ("Failed to parse translation unit\n");
 }
 
-void grabDataFromFile (sa::IniConfiguration& project, string file)
+void doDataGrabbing (const sa::IniConfiguration& project)
 {
-    saLog ("Grabbing data from file '%1'...") << file;
-
-    vector <string> compilerCommandLineOptions = project["datagrabbing.commonclangoptions"].asVector();
-
-    sa::ClangIndex index (false, true);
-
-    sa::ClangTranslationUnit unit = index.parseTranslationUnit (file, compilerCommandLineOptions);
-
-    if (!unit)
-        saError ("Translation unit not created, see stderr for more info");
-
-    int nDiagnostics = unit.getNumDiagnostics();
-    bool wereErrors = false;
+    saLog ("Data grabbing is enabled.");
 
-    for (int i = 0; i < nDiagnostics; i++)
+    if (stdinFileName.empty())
     {
-        sa::ClangDiagnostic diag = unit.getDiagnostic (i);
-        if (diag.getSeverity() == CXDiagnostic_Error || diag.getSeverity() == CXDiagnostic_Fatal)
-            wereErrors = true;
-
-        saLog (diag.formatDiagnostic (clang_defaultDiagnosticDisplayOptions()));
+        sa::grabProjectData (project);
+        return;
     }
 
-    if (wereErrors)
-        saError ("There were errors in a translation unit: grabbing impossible");
-
-    saLog ("Translation unit parsed successfully");
-
-    unique_ptr <sa::FileContext> fileContext = sa::FileContext::create (unit);
-    saAssert (fileContext);
-
-    saLog ("File context is ready to be serialized");
-
-    unique_ptr <sa::IOutputStream> contextOutputStream
-        = sa::FileOutputStream::openOutputStream (project["common.contextfilename"],
-                                                  sa::RelativeOutputStreamFlags::APPEND | sa::RelativeOutputStreamFlags::BINARY);
-
-    fileContext->save (contextOutputStream.get());
-
-    saLog ("Data grabbing finished for file '%1'") << file;
+    string contents ((istreambuf_iterator <char> (cin)), istreambuf_iterator <char>());
+    sa::grabProjectData (project, stdinFileName, contents);
 }
 
-void doDataGrabbing (sa::IniConfiguration& project)
+int processProjectFile (string projectFile, string snapshotFile)
 {
-    saLog ("Data grabbing is enabled.");
-    vector <string> files = project["datagrabbing.files"].asVector();
-    saLog ("Grabbing from files: %1") << files;
+    sa::IniIncludeManager includeManager;
+    unique_ptr <sa::IniConfiguration> project;
 
-    for (unsigned i = 0; i < files.size(); i++)
-        grabDataFromFile (project, project["datagrabbing.files"].resolveRelativePath (i, files[i]));
-}
+    {
+        saTraceScope ("Load configuration", "file", projectFile);
+        if (snapshotFile.empty())
+        {
+            unique_ptr <sa::IInputStream> projectIniFileStream
+                = includeManager.openInputStream (projectFile, sa::RelativeInputStreamFlags::NONE);
+            project = sa::IniConfiguration::load (projectFile, projectIniFileStream.get(), &includeManager);
+        }
+        else
+        {
+            project = sa::IniConfiguration::loadWithSnapshot (projectFile, snapshotFile, &includeManager);
+        }
+    }
 
-void processProjectFile (string projectFile)
-{
-    sa::IniIncludeManager includeManager;
-    unique_ptr <sa::IInputStream> projectIniFileStream
-        = includeManager.openInputStream (projectFile, sa::RelativeInputStreamFlags::NONE);
-    unique_ptr <sa::IniConfiguration> project (sa::IniConfiguration::load (projectFile, projectIniFileStream.get(),
-                                                                           &includeManager));
+    // Recording started by the key misses the configuration loading
+    if ((*project)["common.tracefile"].isDefined() && traceFileName.empty())
+    {
+        // Output file: relative to the working directory, like the context file
+        traceFileName = (*project)["common.tracefile"].asString();
+        sa::TraceRecorder::instance().startRecording();
+    }
+
+    // Messages are in English until the catalog is loaded
+    if ((*project)["common.translationcatalog"].isDefined())
+    {
+        string catalogFile = (*project)["common.translationcatalog"];
+        sa::InternationalizationEngine::instance().loadCatalog (
+            (*project)["common.translationcatalog"].resolveRelativePath (0, catalogFile));
+        saLog ("Translation catalog '%1' loaded") << catalogFile;
+    }
 
     string projectName = (*project)["project.name"];
     saLog ("Project name: '%1'") << projectName;
@@ -92,8 +98,44 @@ void processProjectFile (string projectFile)
             = sa::FileOutputStream::openOutputStream (contextFileName, sa::RelativeOutputStreamFlags::BINARY);
     }
 
-    if ((*project)["datagrabbing.enabled"].asBoolean())
-        doDataGrabbing (*project);
+    // Snapshots of runtime metrics for long runs, written until the project is processed
+    unique_ptr <sa::MetricsReporter> metricsReporter;
+    if ((*project)["common.metricsfile"].isDefined())
+    {
+        string metricsFile = (*project)["common.metricsfile"];
+
+        string format = "prometheus";
+        if ((*project)["common.metricsformat"].isDefined())
+            format = sa::toLower ((*project)["common.metricsformat"].asString());
+        if (format != "prometheus" && format != "json")
+            saError ("Unknown metrics format '%1', Prometheus text is written") << format;
+
+        int interval = 10;
+        if ((*project)["common.metricsinterval"].isDefined())
+            interval = (*project)["common.metricsinterval"].asInteger();
+
+        metricsReporter.reset (new sa::MetricsReporter (metricsFile, format == "json" ? sa::MetricsFormat::JSON :
+                                                                                        sa::MetricsFormat::PROMETHEUS,
+                                                        chrono::seconds (max (interval, 1))));
+    }
+
+    // Read-only from now on: may be shared by grabbing workers
+    shared_ptr <const sa::IniConfiguration> frozenProject = sa::IniConfiguration::freeze (move (project));
+
+    int exitCode = 0;
+    if (isLanguageServerMode)
+    {
+        unique_ptr <sa::FileOutputStream> outputStream = sa::FileOutputStream::openStandardOutput();
+        sa::LanguageServer server (*frozenProject, STDIN_FILENO, outputStream.get());
+        exitCode = server.run();
+    }
+    else if ((*frozenProject)["datagrabbing.enabled"].asBoolean() || !stdinFileName.empty())
+    {
+        doDataGrabbing (*frozenProject);
+    }
+
+    for (const string& key: frozenProject->getUnusedProperties())
+        saLog ("Warning: property '%1' is not used") << key;
 
     // Must be invoked from style analyzer temporary directory already.
     // Create 'sa-context' file
@@ -107,22 +149,49 @@ void processProjectFile (string projectFile)
 
     // Check what assertions are present. Create corresponding verifiers & run verification.
 
+    return exitCode;
 }
 
 int unsafeMain (int argc, char** argv)
 {
     saLog ("Entering unsafeMain");
 
-    if (argc != 2)
+    vector <string> arguments (argv + 1, argv + argc);
+
+    // Compiled project configuration, rebuilt when the project file or its includes change
+    string snapshotFile;
+    for (;;)
+    {
+        if (arguments.size() >= 2 && arguments[0] == "--lsp")
+        {
+            isLanguageServerMode = true;
+            arguments.erase (arguments.begin());
+        }
+        else if (arguments.size() >= 3 && (arguments[0] == "--config-snapshot" || arguments[0] == "--trace" ||
+                                           arguments[0] == "--stdin"))
+        {
+            string& value = arguments[0] == "--trace" ? traceFileName :
+                            arguments[0] == "--stdin" ? stdinFileName : snapshotFile;
+            value = arguments[1];
+            arguments.erase (arguments.begin(), arguments.begin() + 2);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (arguments.size() != 1)
     {
-        saLog ("Expected single parameter: path to project file.");
+        saLog ("Expected parameters: [--config-snapshot <snapshot file>] [--trace <trace file>] [--stdin <source file name>] "
+               "[--lsp] <path to project file>.");
         return 1;
     }
 
-    string projectFile = argv[1];
-    processProjectFile (projectFile);
+    if (!traceFileName.empty())
+        sa::TraceRecorder::instance().startRecording();
 
-    return 0;
+    return processProjectFile (arguments[0], snapshotFile);
 
 #if 0
     CXIndex clangIndex = clang_createIndex (0, 0);
@@ -213,11 +282,26 @@ int unsafeMain (int argc, char** argv)
 #endif
 }
 
+void writeTrace()
+{
+    if (!sa::TraceRecorder::instance().isRecording())
+        return;
+
+    sa::TraceRecorder::instance().stopRecording();
+    unique_ptr <sa::IOutputStream> traceStream
+        = sa::FileOutputStream::openOutputStream (traceFileName, sa::RelativeOutputStreamFlags::BINARY);
+    sa::TraceRecorder::instance().write (traceStream.get());
+
+    saLog ("Trace written to '%1'") << traceFileName;
+}
+
 int loggedMain (int argc, char** argv)
 {
+    int exitCode = 1;
+
     try
     {
-        return unsafeMain (argc, argv);
+        exitCode = unsafeMain (argc, argv);
     }
     catch (sa::Exception& e)
     {
@@ -232,7 +316,18 @@ int loggedMain (int argc, char** argv)
         saError ("Unknown exception leaves main.");
     }
 
-    return 1;
+    // Failed runs are traced too: the trace shows where the time went before the failure
+    try
+    {
+        writeTrace();
+    }
+    catch (sa::Exception& e)
+    {
+        saError ("Failed to write trace '%1':\n%2") << traceFileName << e.toString();
+        exitCode = 1;
+    }
+
+    return exitCode;
 }
 
 int main (int argc, char** argv)
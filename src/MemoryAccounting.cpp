@@ -0,0 +1,104 @@
+#include <atomic>
+#include <cstdio>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "MemoryAccounting.h"
+
+using namespace sa;
+using namespace std;
+
+namespace
+{
+
+struct ThreadAllocationCounters
+{
+    uint64_t nAllocations, nBytesAllocated;
+};
+
+// Trivially constructible: usable from operator new at any point of the thread life
+thread_local ThreadAllocationCounters threadCounters;
+
+atomic <bool> hooksInstalled (false);
+atomic <uint64_t> liveHeapBytes (0), peakLiveHeapBytes (0);
+
+}
+
+void sa::recordAllocation (size_t nBytes)
+{
+    threadCounters.nAllocations++;
+    threadCounters.nBytesAllocated += nBytes;
+
+    uint64_t live = liveHeapBytes.fetch_add (nBytes, memory_order_relaxed) + nBytes;
+    uint64_t peak = peakLiveHeapBytes.load (memory_order_relaxed);
+    while (live > peak && !peakLiveHeapBytes.compare_exchange_weak (peak, live, memory_order_relaxed))
+        ;
+}
+
+void sa::recordDeallocation (size_t nBytes)
+{
+    liveHeapBytes.fetch_sub (nBytes, memory_order_relaxed);
+}
+
+void sa::setAllocationHooksInstalled()
+{
+    hooksInstalled.store (true, memory_order_relaxed);
+}
+
+bool sa::areAllocationHooksInstalled()
+{
+    return hooksInstalled.load (memory_order_relaxed);
+}
+
+uint64_t sa::getThreadAllocations()
+{
+    return threadCounters.nAllocations;
+}
+
+uint64_t sa::getThreadBytesAllocated()
+{
+    return threadCounters.nBytesAllocated;
+}
+
+uint64_t sa::getLiveHeapBytes()
+{
+    return liveHeapBytes.load (memory_order_relaxed);
+}
+
+uint64_t sa::getPeakLiveHeapBytes()
+{
+    return peakLiveHeapBytes.load (memory_order_relaxed);
+}
+
+void sa::resetPeakLiveHeapBytes()
+{
+    peakLiveHeapBytes.store (liveHeapBytes.load (memory_order_relaxed), memory_order_relaxed);
+}
+
+uint64_t sa::getResidentBytes()
+{
+    FILE* statm = fopen ("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+
+    unsigned long long nTotalPages = 0, nResidentPages = 0;
+    int nRead = fscanf (statm, "%llu %llu", &nTotalPages, &nResidentPages);
+    fclose (statm);
+
+    long pageSize = sysconf (_SC_PAGESIZE);
+    if (nRead != 2 || pageSize <= 0)
+        return 0;
+
+    return nResidentPages * static_cast <uint64_t> (pageSize);
+}
+
+uint64_t sa::getPeakResidentBytes()
+{
+    struct rusage usage = rusage();
+    if (getrusage (RUSAGE_SELF, &usage) != 0 || usage.ru_maxrss < 0)
+        return 0;
+
+    // Kilobytes on Linux
+    return static_cast <uint64_t> (usage.ru_maxrss) * 1024;
+}
@@ -0,0 +1,42 @@
+#ifndef STYLE_ANALYZER_MEMORY_ACCOUNTING_H
+#define STYLE_ANALYZER_MEMORY_ACCOUNTING_H
+
+/* Heap & resident memory accounting.
+
+   Heap allocations are counted by the replaced global operator new & delete (src/MemoryHooks.cpp), linked into the
+   tool only: in other executables (unit tests, benchmarks) the heap counters stay zero, see areAllocationHooksInstalled().
+   - allocations & allocated bytes are counted per thread (the thread which allocated)
+   - live bytes (allocated & not freed yet) & their peak are process-wide
+   Sizes are the usable sizes of malloc blocks, so they are a bit larger than the requested ones.
+
+   Resident set size is sampled from /proc (Linux only, zero elsewhere), its peak comes from getrusage.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sa
+{
+
+// Called by the allocation hooks: must not allocate
+void recordAllocation (size_t nBytes);
+void recordDeallocation (size_t nBytes);
+void setAllocationHooksInstalled();
+
+bool areAllocationHooksInstalled();
+
+uint64_t getThreadAllocations();
+uint64_t getThreadBytesAllocated();
+
+uint64_t getLiveHeapBytes();
+uint64_t getPeakLiveHeapBytes();
+
+// The peak is measured from now on (i. e. per processed file)
+void resetPeakLiveHeapBytes();
+
+uint64_t getResidentBytes();
+uint64_t getPeakResidentBytes();
+
+}
+
+#endif // STYLE_ANALYZER_MEMORY_ACCOUNTING_H
@@ -0,0 +1,100 @@
+/* Replaced global allocation functions of the tool, see MemoryAccounting.h.
+   Blocks are plain malloc blocks: sizes are taken from malloc_usable_size, no headers are added,
+   so memory allocated by the default functions (i. e. in libraries) may be freed here safely. */
+
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+#include "MemoryAccounting.h"
+
+using namespace std;
+
+static struct AllocationHooksRegistration
+{
+    AllocationHooksRegistration()
+    {
+        sa::setAllocationHooksInstalled();
+    }
+} allocationHooksRegistration;
+
+static void* allocate (size_t size)
+{
+    for (;;)
+    {
+        if (void* memory = malloc (size ? size : 1))
+        {
+            sa::recordAllocation (malloc_usable_size (memory));
+            return memory;
+        }
+
+        new_handler handler = get_new_handler();
+        if (!handler)
+            throw bad_alloc();
+        handler();
+    }
+}
+
+static void deallocate (void* memory)
+{
+    if (!memory)
+        return;
+
+    sa::recordDeallocation (malloc_usable_size (memory));
+    free (memory);
+}
+
+void* operator new (size_t size)
+{
+    return allocate (size);
+}
+
+void* operator new[] (size_t size)
+{
+    return allocate (size);
+}
+
+void* operator new (size_t size, const nothrow_t&) noexcept
+{
+    try
+    {
+        return allocate (size);
+    }
+    catch (bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[] (size_t size, const nothrow_t&) noexcept
+{
+    try
+    {
+        return allocate (size);
+    }
+    catch (bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete (void* memory) noexcept
+{
+    deallocate (memory);
+}
+
+void operator delete[] (void* memory) noexcept
+{
+    deallocate (memory);
+}
+
+void operator delete (void* memory, const nothrow_t&) noexcept
+{
+    deallocate (memory);
+}
+
+void operator delete[] (void* memory, const nothrow_t&) noexcept
+{
+    deallocate (memory);
+}
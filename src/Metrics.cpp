@@ -0,0 +1,233 @@
+#include <cstdio>
+
+#include "Metrics.h"
+#include "FileStreams.h"
+#include "ApplicationLog.h"
+#include "Debug.h"
+
+using namespace sa;
+using namespace std;
+
+MetricCounter metrics::filesProcessed ("sa_files_processed_total", "Files processed successfully.");
+MetricCounter metrics::filesFailed ("sa_files_failed_total", "Files failed or rejected.");
+MetricCounter metrics::tokensTokenized ("sa_tokens_total", "Tokens of processed files.");
+MetricCounter metrics::contextBytesWritten ("sa_context_bytes_written_total", "Bytes written to the context file.");
+MetricCounter metrics::headersProcessed ("sa_headers_processed_total", "Project headers grabbed with the sources.");
+MetricCounter metrics::iniFileCacheHits ("sa_ini_file_cache_hits_total", "Ini files taken from the cache.");
+MetricCounter metrics::iniFileCacheMisses ("sa_ini_file_cache_misses_total", "Ini files new or changed, tokenized again.");
+MetricCounter metrics::configurationSnapshotHits ("sa_configuration_snapshot_hits_total",
+                                                  "Configurations loaded from a snapshot.");
+MetricCounter metrics::configurationSnapshotMisses ("sa_configuration_snapshot_misses_total",
+                                                    "Configuration snapshots rebuilt.");
+MetricCounter metrics::astCacheHits ("sa_ast_cache_hits_total", "Translation units loaded from the AST cache.");
+MetricCounter metrics::astCacheMisses ("sa_ast_cache_misses_total", "Translation units parsed with the AST cache enabled.");
+MetricHistogram metrics::parseSeconds ("sa_parse_seconds", "Translation unit parsing time.");
+MetricHistogram metrics::lspPublishSeconds ("sa_lsp_publish_seconds", "Language server: time from an edit to its diagnostics.");
+
+static const double histogramUpperBounds[] = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+
+sa::MetricCounter::MetricCounter (const char* name, const char* help) :
+    name (name), help (help), value (0)
+{
+    MetricsRegistry::instance().add (this);
+}
+
+sa::MetricHistogram::MetricHistogram (const char* name, const char* help) :
+    name (name), help (help), count (0), sumMicroseconds (0)
+{
+    static_assert (sizeof (histogramUpperBounds) / sizeof (histogramUpperBounds[0]) + 1 == nBuckets,
+                   "Every bucket except the last one needs an upper bound");
+
+    for (unsigned i = 0; i < nBuckets; i++)
+        bucketCounts[i].store (0, memory_order_relaxed);
+
+    MetricsRegistry::instance().add (this);
+}
+
+void sa::MetricHistogram::observe (double seconds)
+{
+    unsigned bucket = 0;
+    while (bucket + 1 < nBuckets && seconds > histogramUpperBounds[bucket])
+        bucket++;
+
+    bucketCounts[bucket].fetch_add (1, memory_order_relaxed);
+    count.fetch_add (1, memory_order_relaxed);
+    sumMicroseconds.fetch_add (static_cast <uint64_t> (max (seconds, 0.0) * 1e6), memory_order_relaxed);
+}
+
+unsigned sa::MetricHistogram::getNumBuckets()
+{
+    return nBuckets;
+}
+
+double sa::MetricHistogram::getBucketUpperBound (unsigned bucket)
+{
+    saAssert (bucket + 1 < nBuckets);
+    return histogramUpperBounds[bucket];
+}
+
+uint64_t sa::MetricHistogram::getBucketCount (unsigned bucket) const
+{
+    saAssert (bucket < nBuckets);
+    return bucketCounts[bucket].load (memory_order_relaxed);
+}
+
+uint64_t sa::MetricHistogram::getCount() const
+{
+    return count.load (memory_order_relaxed);
+}
+
+double sa::MetricHistogram::getSum() const
+{
+    return static_cast <double> (sumMicroseconds.load (memory_order_relaxed)) * 1e-6;
+}
+
+MetricsRegistry& sa::MetricsRegistry::instance()
+{
+    static MetricsRegistry theInstance;
+    return theInstance;
+}
+
+void sa::MetricsRegistry::add (MetricCounter* counter)
+{
+    counters.push_back (counter);
+}
+
+void sa::MetricsRegistry::add (MetricHistogram* histogram)
+{
+    histograms.push_back (histogram);
+}
+
+static string formatBound (unsigned bucket)
+{
+    if (bucket + 1 == MetricHistogram::getNumBuckets())
+        return "+Inf";
+
+    char bound[32];
+    snprintf (bound, sizeof (bound), "%g", MetricHistogram::getBucketUpperBound (bucket));
+    return bound;
+}
+
+static void writeString (IOutputStream* stream, const string& s)
+{
+    stream->write (s.data(), static_cast <uint32_t> (s.length()));
+}
+
+void sa::MetricsRegistry::writePrometheus (IOutputStream* stream) const
+{
+    string text;
+
+    for (const MetricCounter* counter: counters)
+    {
+        text += string ("# HELP ") + counter->getName() + " " + counter->getHelp() + "\n";
+        text += string ("# TYPE ") + counter->getName() + " counter\n";
+        text += string (counter->getName()) + " " + to_string (counter->get()) + "\n";
+    }
+
+    for (const MetricHistogram* histogram: histograms)
+    {
+        string name = histogram->getName();
+        text += "# HELP " + name + " " + histogram->getHelp() + "\n";
+        text += "# TYPE " + name + " histogram\n";
+
+        uint64_t cumulativeCount = 0;
+        for (unsigned i = 0; i < MetricHistogram::getNumBuckets(); i++)
+        {
+            cumulativeCount += histogram->getBucketCount (i);
+            text += name + "_bucket{le=\"" + formatBound (i) + "\"} " + to_string (cumulativeCount) + "\n";
+        }
+
+        char sum[32];
+        snprintf (sum, sizeof (sum), "%.6f", histogram->getSum());
+        text += name + "_sum " + sum + "\n";
+        text += name + "_count " + to_string (histogram->getCount()) + "\n";
+    }
+
+    writeString (stream, text);
+}
+
+void sa::MetricsRegistry::writeJson (IOutputStream* stream) const
+{
+    vector <string> entries;
+
+    for (const MetricCounter* counter: counters)
+        entries.push_back (string ("\"") + counter->getName() + "\": " + to_string (counter->get()));
+
+    for (const MetricHistogram* histogram: histograms)
+    {
+        string entry = string ("\"") + histogram->getName() + "\": {\"buckets\": {";
+        for (unsigned i = 0; i < MetricHistogram::getNumBuckets(); i++)
+            entry += (i ? ", \"" : "\"") + formatBound (i) + "\": " + to_string (histogram->getBucketCount (i));
+
+        char sum[32];
+        snprintf (sum, sizeof (sum), "%.6f", histogram->getSum());
+        entry += string ("}, \"sum\": ") + sum + ", \"count\": " + to_string (histogram->getCount()) + "}";
+        entries.push_back (entry);
+    }
+
+    string json = "{";
+    for (unsigned i = 0; i < entries.size(); i++)
+        json += (i ? ",\n " : "") + entries[i];
+    json += "}\n";
+
+    writeString (stream, json);
+}
+
+sa::MetricsReporter::MetricsReporter (string fileName, MetricsFormat format, chrono::milliseconds interval) :
+    fileName (fileName), format (format), interval (interval), stopRequested (false)
+{
+    writeSnapshot();
+    thread = std::thread (&MetricsReporter::run, this);
+}
+
+sa::MetricsReporter::~MetricsReporter()
+{
+    {
+        lock_guard <std::mutex> lock (mutex);
+        stopRequested = true;
+    }
+    stopCondition.notify_one();
+    thread.join();
+
+    try
+    {
+        writeSnapshot();
+    }
+    catch (Exception& e)
+    {
+        saError ("Failed to write metrics '%1':\n%2") << fileName << e.toString();
+    }
+}
+
+void sa::MetricsReporter::writeSnapshot()
+{
+    string temporaryFileName = fileName + ".tmp";
+
+    {
+        unique_ptr <FileOutputStream> stream = FileOutputStream::openOutputStream (temporaryFileName,
+                                                                                   RelativeOutputStreamFlags::BINARY);
+        if (format == MetricsFormat::JSON)
+            MetricsRegistry::instance().writeJson (stream.get());
+        else
+            MetricsRegistry::instance().writePrometheus (stream.get());
+    }
+
+    if (rename (temporaryFileName.c_str(), fileName.c_str()) != 0)
+        throw InputOutputException (__ORIGIN__, "file '" + fileName + "'", "Replacing by '" + temporaryFileName + "'");
+}
+
+void sa::MetricsReporter::run()
+{
+    unique_lock <std::mutex> lock (mutex);
+    while (!stopCondition.wait_for (lock, interval, [this] { return stopRequested; }))
+    {
+        // The log is not thread-safe: failures of periodic snapshots are not reported, the final one reports
+        try
+        {
+            writeSnapshot();
+        }
+        catch (Exception&)
+        {
+        }
+    }
+}
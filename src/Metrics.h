@@ -0,0 +1,178 @@
+#ifndef STYLE_ANALYZER_METRICS_H
+#define STYLE_ANALYZER_METRICS_H
+
+/* Runtime metrics: counters & histograms updated without locks, exported as Prometheus text or JSON.
+
+   Metrics are process-wide objects registered on construction, all of them are declared below (namespace metrics).
+   Updates are relaxed atomic additions: a snapshot taken concurrently is consistent per value, not across values.
+
+   Prometheus text format:
+   # HELP sa_files_processed_total Files processed successfully.
+   # TYPE sa_files_processed_total counter
+   sa_files_processed_total 12
+   Histograms export cumulative buckets (sa_x_bucket{le="0.5"}), sa_x_sum & sa_x_count.
+
+   JSON format: {"sa_files_processed_total": 12, "sa_parse_seconds": {"buckets": {"0.5": 3, ..., "+Inf": 12},
+   "sum": 1.5, "count": 12}}
+
+   MetricsReporter writes snapshots into a file periodically from a background thread. A snapshot replaces
+   the file at once (written next to it, then renamed), so readers never see a partial one.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Streams.h"
+
+namespace sa
+{
+
+using std::string;
+using std::vector;
+
+class MetricCounter
+{
+public :
+    MetricCounter (const char* name, const char* help);
+
+    void add (uint64_t n = 1)
+    {
+        value.fetch_add (n, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const
+    {
+        return value.load (std::memory_order_relaxed);
+    }
+
+    const char* getName() const
+    {
+        return name;
+    }
+
+    const char* getHelp() const
+    {
+        return help;
+    }
+
+private :
+    MetricCounter (const MetricCounter&) = delete;
+    MetricCounter& operator= (const MetricCounter&) = delete;
+
+    const char* name;
+    const char* help;
+    std::atomic <uint64_t> value;
+};
+
+// Observations in seconds, upper bounds of buckets are fixed (see Metrics.cpp)
+class MetricHistogram
+{
+public :
+    MetricHistogram (const char* name, const char* help);
+
+    void observe (double seconds);
+
+    static unsigned getNumBuckets();
+
+    // The last bucket is unbounded
+    static double getBucketUpperBound (unsigned bucket);
+
+    // Observations falling into the bucket exactly (not cumulative)
+    uint64_t getBucketCount (unsigned bucket) const;
+    uint64_t getCount() const;
+    double getSum() const;
+
+    const char* getName() const
+    {
+        return name;
+    }
+
+    const char* getHelp() const
+    {
+        return help;
+    }
+
+private :
+    MetricHistogram (const MetricHistogram&) = delete;
+    MetricHistogram& operator= (const MetricHistogram&) = delete;
+
+    static const unsigned nBuckets = 12;
+
+    const char* name;
+    const char* help;
+    std::atomic <uint64_t> bucketCounts[nBuckets];
+    std::atomic <uint64_t> count, sumMicroseconds;
+};
+
+class MetricsRegistry
+{
+public :
+    void add (MetricCounter* counter);
+    void add (MetricHistogram* histogram);
+
+    void writePrometheus (IOutputStream* stream) const;
+    void writeJson (IOutputStream* stream) const;
+
+    static MetricsRegistry& instance();
+
+private :
+    MetricsRegistry() = default;
+    MetricsRegistry (const MetricsRegistry&) = delete;
+    MetricsRegistry& operator= (const MetricsRegistry&) = delete;
+
+    // Filled during static initialization only
+    vector <MetricCounter*> counters;
+    vector <MetricHistogram*> histograms;
+};
+
+enum class MetricsFormat
+{
+    PROMETHEUS,
+    JSON
+};
+
+class MetricsReporter
+{
+public :
+    // Writes the first snapshot at once
+    MetricsReporter (string fileName, MetricsFormat format, std::chrono::milliseconds interval);
+
+    // Writes the final snapshot
+    ~MetricsReporter();
+
+private :
+    MetricsReporter (const MetricsReporter&) = delete;
+    MetricsReporter& operator= (const MetricsReporter&) = delete;
+
+    string fileName;
+    MetricsFormat format;
+    std::chrono::milliseconds interval;
+
+    std::mutex mutex;
+    std::condition_variable stopCondition;
+    bool stopRequested;
+    std::thread thread;
+
+    void writeSnapshot();
+    void run();
+};
+
+namespace metrics
+{
+
+extern MetricCounter filesProcessed, filesFailed, tokensTokenized, contextBytesWritten, headersProcessed;
+extern MetricCounter iniFileCacheHits, iniFileCacheMisses, configurationSnapshotHits, configurationSnapshotMisses;
+extern MetricCounter astCacheHits, astCacheMisses;
+extern MetricHistogram parseSeconds, lspPublishSeconds;
+
+}
+
+}
+
+#endif // STYLE_ANALYZER_METRICS_H
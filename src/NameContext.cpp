@@ -1,11 +1,126 @@
+#include <algorithm>
+
 #include "NameContext.h"
+#include "FileSystem.h"
+#include "LibclangHelpers.h"
 
 using namespace std;
 using namespace sa;
 
-unique_ptr <NameContext> sa::NameContext::create (CXTranslationUnit /*unit*/)
+static NameKind getNameKind (CXCursorKind kind)
+{
+    switch (kind)
+    {
+        case CXCursor_StructDecl:
+        case CXCursor_UnionDecl:
+        case CXCursor_ClassDecl:
+        case CXCursor_EnumDecl:
+        case CXCursor_TypedefDecl:
+        case CXCursor_TypeAliasDecl:
+        case CXCursor_ClassTemplate:
+            return NameKind::TYPE;
+
+        case CXCursor_FunctionDecl:
+        case CXCursor_CXXMethod:
+        case CXCursor_FunctionTemplate:
+            return NameKind::FUNCTION;
+
+        case CXCursor_VarDecl:
+        case CXCursor_FieldDecl:
+        case CXCursor_ParmDecl:
+            return NameKind::VARIABLE;
+
+        default:
+            return NameKind::OTHER;
+    }
+}
+
+static void addDeclaration (vector <NameDeclaration>& declarations, CXCursor cursor, unsigned offset)
+{
+    CXCursorKind kind = clang_getCursorKind (cursor);
+    string name = convertCXString (clang_getCursorSpelling (cursor));
+
+    // Operators & conversions are named by the language
+    NameKind nameKind = getNameKind (kind);
+    if (name.compare (0, 8, "operator") == 0 && kind == CXCursor_CXXMethod)
+        nameKind = NameKind::OTHER;
+
+    if (!name.empty())
+        declarations.push_back (NameDeclaration { name, nameKind, offset });
+}
+
+static void sortDeclarations (vector <NameDeclaration>& declarations)
+{
+    stable_sort (declarations.begin(), declarations.end(),
+                 [] (const NameDeclaration& a, const NameDeclaration& b) { return a.fileBufferOffset < b.fileBufferOffset; });
+}
+
+// Files are known by canonical names: a header included by different paths is the same
+static string getCanonicalFileName (const string& fileName)
 {
-    return unique_ptr <NameContext> (new NameContext);
+    IFileSystem& fileSystem = FileSystem::instance();
+    return fileSystem.fileExists (fileName) ? fileSystem.getCanonicalPath (fileName) : fileName;
+}
+
+namespace
+{
+
+struct DeclarationCollector
+{
+    CXFile file;
+    vector <NameDeclaration>& declarations;
+};
+
+}
+
+static CXChildVisitResult collectDeclaration (CXCursor cursor, CXCursor /*parent*/, CXClientData data)
+{
+    DeclarationCollector& collector = *static_cast <DeclarationCollector*> (data);
+
+    CXSourceLocation location = clang_getCursorLocation (cursor);
+    CXFile file = nullptr;
+    unsigned offset = 0;
+    clang_getFileLocation (location, &file, nullptr, nullptr, &offset);
+    if (!file || !clang_File_isEqual (file, collector.file))
+        return CXChildVisit_Continue;
+
+    if (clang_isDeclaration (clang_getCursorKind (cursor)))
+        addDeclaration (collector.declarations, cursor, offset);
+
+    return CXChildVisit_Recurse;
+}
+
+// Parameters of a template (with those of its template template parameters), not the names it declares
+static CXChildVisitResult collectTemplateParameter (CXCursor cursor, CXCursor parent, CXClientData data)
+{
+    switch (clang_getCursorKind (cursor))
+    {
+        case CXCursor_TemplateTypeParameter:
+        case CXCursor_NonTypeTemplateParameter:
+        case CXCursor_TemplateTemplateParameter:
+            return collectDeclaration (cursor, parent, data);
+
+        default:
+            return CXChildVisit_Continue;
+    }
+}
+
+unique_ptr <NameContext> sa::NameContext::create (CXTranslationUnit unit, CXFile file)
+{
+    unique_ptr <NameContext> context (new NameContext);
+    DeclarationCollector collector = DeclarationCollector { file, context->declarations };
+    clang_visitChildren (clang_getTranslationUnitCursor (unit), collectDeclaration, &collector);
+
+    sortDeclarations (context->declarations);
+    return context;
+}
+
+unique_ptr <NameContext> sa::NameContext::create (vector <NameDeclaration> declarations)
+{
+    unique_ptr <NameContext> context (new NameContext);
+    context->declarations = move (declarations);
+    sortDeclarations (context->declarations);
+    return context;
 }
 
 unique_ptr <NameContext> sa::NameContext::load (IInputStream* /*stream*/)
@@ -18,3 +133,180 @@ void sa::NameContext::save (IOutputStream* /*stream*/)
 {
 
 }
+
+sa::NameCollector::NameCollector (CXIndex index) :
+    action (clang_IndexAction_create (index)), nUnits (0)
+{}
+
+sa::NameCollector::~NameCollector()
+{
+    clang_IndexAction_dispose (action);
+}
+
+void sa::NameCollector::collect (CXTranslationUnit unit)
+{
+    startUnit (convertCXString (clang_getTranslationUnitSpelling (unit)));
+
+    IndexerCallbacks callbacks = IndexerCallbacks();
+    callbacks.indexDeclaration = indexDeclaration;
+
+    clang_indexTranslationUnit (action, this, &callbacks, sizeof (callbacks), CXIndexOpt_SuppressRedundantRefs, unit);
+    clang_visitChildren (clang_getTranslationUnitCursor (unit), collectAliasTemplate, this);
+    unitFiles.clear();
+}
+
+vector <NameDeclaration> sa::NameCollector::takeDeclarations (const string& fileName)
+{
+    vector <NameDeclaration> result;
+
+    auto it = declarations.find (getCanonicalFileName (fileName));
+    if (it != declarations.end())
+    {
+        result = move (it->second);
+        declarations.erase (it);
+    }
+
+    sortDeclarations (result);
+    return result;
+}
+
+void sa::NameCollector::dropDeclarations()
+{
+    for (const auto& it: declarations)
+        fileUnits.erase (it.first);
+    declarations.clear();
+}
+
+void sa::NameCollector::startUnit (const string& mainFileName)
+{
+    nUnits++;
+    unitFiles.clear();
+
+    // A source grabbed again is collected again
+    string canonicalName = getCanonicalFileName (mainFileName);
+    fileUnits.erase (canonicalName);
+    declarations.erase (canonicalName);
+}
+
+vector <NameDeclaration>* sa::NameCollector::getFileDeclarations (CXFile file, CXSourceLocation location)
+{
+    auto it = unitFiles.find (file);
+    if (it != unitFiles.end())
+        return it->second;
+
+    vector <NameDeclaration>* result = nullptr;
+    if (!clang_Location_isInSystemHeader (location))
+    {
+        // Files collected in a previous unit are skipped
+        string fileName = getCanonicalFileName (convertCXString (clang_getFileName (file)));
+        auto inserted = fileUnits.insert (make_pair (fileName, nUnits));
+        if (inserted.first->second == nUnits)
+            result = &declarations[fileName];
+    }
+
+    unitFiles[file] = result;
+    return result;
+}
+
+void sa::NameCollector::indexDeclaration (CXClientData clientData, const CXIdxDeclInfo* info)
+{
+    NameCollector& collector = *static_cast <NameCollector*> (clientData);
+    if (info->isImplicit)
+        return;
+
+    // Where the cursor is, as for visited declarations: declarations made by macros are where the macros are
+    CXSourceLocation location = clang_getCursorLocation (info->cursor);
+    CXFile file = nullptr;
+    unsigned offset = 0;
+    clang_getFileLocation (location, &file, nullptr, nullptr, &offset);
+    if (!file)
+        return;
+
+    vector <NameDeclaration>* fileDeclarations = collector.getFileDeclarations (file, location);
+    if (!fileDeclarations)
+        return;
+
+    // Templates are indexed by the declarations they make (i. e. a function, not a function template): the template
+    // is the cursor at the name, as visited. Its parameters are children of the template only.
+    CXCursor declarationCursor = info->cursor;
+    if (info->entityInfo->templateKind == CXIdxEntity_Template)
+    {
+        CXCursor templateCursor = clang_getCursor (clang_Cursor_getTranslationUnit (info->cursor), location);
+        CXCursorKind templateKind = clang_getCursorKind (templateCursor);
+        if (templateKind == CXCursor_FunctionTemplate || templateKind == CXCursor_ClassTemplate)
+            declarationCursor = templateCursor;
+    }
+
+    addDeclaration (*fileDeclarations, declarationCursor, offset);
+
+    if (info->entityInfo->templateKind == CXIdxEntity_Template ||
+        info->entityInfo->templateKind == CXIdxEntity_TemplatePartialSpecialization)
+    {
+        DeclarationCollector templateParameters = DeclarationCollector { file, *fileDeclarations };
+        clang_visitChildren (declarationCursor, collectTemplateParameter, &templateParameters);
+    }
+
+    // Alias templates are not indexed: they are looked for among the members of scopes indexed
+    switch (clang_getCursorKind (declarationCursor))
+    {
+        case CXCursor_Namespace:
+        case CXCursor_StructDecl:
+        case CXCursor_UnionDecl:
+        case CXCursor_ClassDecl:
+        case CXCursor_ClassTemplate:
+        case CXCursor_ClassTemplatePartialSpecialization:
+            clang_visitChildren (declarationCursor, collectAliasTemplate, &collector);
+            break;
+
+        default:
+            break;
+    }
+
+    // Function-local names (parameters, including those of function types, local variables, exception variables)
+    // are not indexed the same way: they are visited.
+    switch (clang_getCursorKind (info->cursor))
+    {
+        case CXCursor_FunctionDecl:
+        case CXCursor_CXXMethod:
+        case CXCursor_FunctionTemplate:
+        case CXCursor_Constructor:
+        case CXCursor_Destructor:
+        case CXCursor_ConversionFunction:
+        case CXCursor_VarDecl:
+        case CXCursor_FieldDecl:
+        case CXCursor_TypedefDecl:
+        case CXCursor_TypeAliasDecl:
+        {
+            DeclarationCollector localNames = DeclarationCollector { file, *fileDeclarations };
+            clang_visitChildren (info->cursor, collectDeclaration, &localNames);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+CXChildVisitResult sa::NameCollector::collectAliasTemplate (CXCursor cursor, CXCursor parent, CXClientData clientData)
+{
+    NameCollector& collector = *static_cast <NameCollector*> (clientData);
+    if (clang_getCursorKind (cursor) != CXCursor_TypeAliasTemplateDecl)
+        return CXChildVisit_Continue;
+
+    CXSourceLocation location = clang_getCursorLocation (cursor);
+    CXFile file = nullptr;
+    clang_getFileLocation (location, &file, nullptr, nullptr, nullptr);
+    if (!file)
+        return CXChildVisit_Continue;
+
+    vector <NameDeclaration>* fileDeclarations = collector.getFileDeclarations (file, location);
+    if (fileDeclarations)
+    {
+        // The alias template & its parameters, as visited
+        DeclarationCollector aliasTemplate = DeclarationCollector { file, *fileDeclarations };
+        if (collectDeclaration (cursor, parent, &aliasTemplate) == CXChildVisit_Recurse)
+            clang_visitChildren (cursor, collectTemplateParameter, &aliasTemplate);
+    }
+
+    return CXChildVisit_Continue;
+}
@@ -1,11 +1,16 @@
 #ifndef STYLE_ANALYZER_NAME_CONTEXT_H
 #define STYLE_ANALYZER_NAME_CONTEXT_H
 
+#include <cstdint>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <clang-c/Index.h>
 
+#include "LibclangHelpers.h"
 #include "Streams.h"
 
 namespace sa
@@ -13,20 +18,92 @@ namespace sa
 
 using std::ifstream;
 using std::ofstream;
+using std::string;
 using std::unique_ptr;
+using std::vector;
+
+enum class NameKind : uint8_t
+{
+    TYPE,
+    FUNCTION,
+    VARIABLE,
+    // Constructors, operators, namespaces, enumerators, etc.
+    OTHER
+};
+
+// A name declared in the file of the context (names the file takes from its includes are not)
+struct NameDeclaration
+{
+    string name;
+    NameKind kind;
+    uint32_t fileBufferOffset;
+};
 
 class NameContext
 {
 public :
+    // Ordered by offsets
+    const vector <NameDeclaration>& getDeclarations() const
+    {
+        return declarations;
+    }
+
     void save (IOutputStream* stream);
     static unique_ptr <NameContext> load (IInputStream* stream);
-    static unique_ptr <NameContext> create (CXTranslationUnit unit);
+
+    // Visits the cursors of the unit: for a single file of a unit parsed already (i. e. reparsed after an edit)
+    static unique_ptr <NameContext> create (CXTranslationUnit unit, CXFile file);
+
+    // Declarations collected by a NameCollector
+    static unique_ptr <NameContext> create (vector <NameDeclaration> declarations);
 
 private :
     NameContext() = default;
 
     NameContext (const NameContext&) = delete;
     NameContext& operator= (const NameContext&) = delete;
+
+    vector <NameDeclaration> declarations;
+};
+
+// Collects declarations of all files of a unit in a single pass (the indexing API, clang_indexTranslationUnit) instead of
+// a cursor visit per file. Units are indexed one after another in a session: declarations of a header are collected
+// from the first unit including it, headers taken are skipped in the next units. System headers are skipped.
+class NameCollector
+{
+public :
+    explicit NameCollector (CXIndex index);
+    ~NameCollector();
+
+    // Indexes the declarations of a unit parsed or loaded from the AST cache
+    void collect (CXTranslationUnit unit);
+
+    // Declarations of the file named so since they were collected, ordered by offsets; then they are forgotten
+    vector <NameDeclaration> takeDeclarations (const string& fileName);
+
+    // Declarations not taken are forgotten (i. e. of headers grabbed by another process): their files are collected
+    // again from the next unit including them
+    void dropDeclarations();
+
+private :
+    NameCollector (const NameCollector&) = delete;
+    NameCollector& operator= (const NameCollector&) = delete;
+
+    CXIndexAction action;
+
+    // By canonical file names; files are collected from a single unit, numbered from 1
+    std::map <string, vector <NameDeclaration>> declarations;
+    std::map <string, unsigned> fileUnits;
+    unsigned nUnits;
+
+    // Files of the unit indexed: where their declarations go, null for files skipped
+    std::map <CXFile, vector <NameDeclaration>*> unitFiles;
+
+    void startUnit (const string& mainFileName);
+    vector <NameDeclaration>* getFileDeclarations (CXFile file, CXSourceLocation location);
+
+    static void indexDeclaration (CXClientData clientData, const CXIdxDeclInfo* info);
+    static CXChildVisitResult collectAliasTemplate (CXCursor cursor, CXCursor parent, CXClientData clientData);
 };
 
 }
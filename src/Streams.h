@@ -96,7 +96,9 @@ enum class RelativeOutputStreamFlags : uint32_t
     NONE = 0,
 
     BINARY = 1 << 0,
-    APPEND = 1 << 1
+    APPEND = 1 << 1,
+    // Every write reaches the file at once (i. e. logs of a process which may crash)
+    UNBUFFERED = 1 << 2
 };
 
 RelativeOutputStreamFlags operator| (RelativeOutputStreamFlags a, RelativeOutputStreamFlags b);
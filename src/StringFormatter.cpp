@@ -1,125 +1,227 @@
 #include "StringFormatter.h"
 #include "Debug.h"
 
+#include <cstdio>
+#include <memory>
+
 using namespace sa;
 
 sa::IAfterformatAction::~IAfterformatAction()
 {}
 
-sa::IFormattable::~IFormattable()
-{}
+void sa::FormatBuffer::clear()
+{
+    contents.clear();
+}
 
-FormattableString::~FormattableString()
-{}
+void sa::FormatBuffer::appendUnsigned (uint64_t value)
+{
+    static const char digitPairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
 
-FormattableVector::~FormattableVector()
-{}
+    // Digits are written from the end, two at a time
+    char digits[20];
+    char* begin = digits + sizeof (digits);
 
-sa::FormatObjectsHolder::FormatObjectsHolder (std::string formatString, sa::IAfterformatAction* action) :
-    action (action), formatString (formatString)
-{}
+    while (value >= 100)
+    {
+        size_t pair = static_cast <size_t> (value % 100) * 2;
+        value /= 100;
+        *--begin = digitPairs[pair + 1];
+        *--begin = digitPairs[pair];
+    }
 
-sa::FormatObjectsHolder::FormatObjectsHolder()
-{}
+    if (value >= 10)
+    {
+        size_t pair = static_cast <size_t> (value) * 2;
+        *--begin = digitPairs[pair + 1];
+        *--begin = digitPairs[pair];
+    }
+    else
+    {
+        *--begin = static_cast <char> ('0' + value);
+    }
+
+    append (begin, static_cast <size_t> (digits + sizeof (digits) - begin));
+}
+
+void sa::FormatBuffer::appendSigned (int64_t value)
+{
+    if (value < 0)
+    {
+        append ('-');
+        // Negation in unsigned arithmetic is well-defined for the minimal value too
+        appendUnsigned (0 - static_cast <uint64_t> (value));
+    }
+    else
+    {
+        appendUnsigned (static_cast <uint64_t> (value));
+    }
+}
 
-sa::FormatObjectsHolder::operator string()
+void sa::FormatBuffer::appendFloatingPoint (double value)
 {
-    return format();
+    char digits[32];
+    int length = snprintf (digits, sizeof (digits), "%g", value);
+    saAssert (length > 0 && static_cast <size_t> (length) < sizeof (digits));
+    append (digits, static_cast <size_t> (length));
 }
 
-sa::FormatObjectsHolder::~FormatObjectsHolder()
+void sa::FormatBuffer::appendArgument (const FormatArgument& argument)
 {
-    if (action)
-        action->fire (format());
+    switch (argument.type)
+    {
+        case FormatArgument::Type::SIGNED_INTEGER:   return appendSigned (argument.signedValue);
+        case FormatArgument::Type::UNSIGNED_INTEGER: return appendUnsigned (argument.unsignedValue);
+        case FormatArgument::Type::FLOATING_POINT:   return appendFloatingPoint (argument.floatingPointValue);
+        case FormatArgument::Type::STRING:           return append (argument.stringValue.data, argument.stringValue.length);
+
+        case FormatArgument::Type::CUSTOM:
+            return argument.customValue.formatter (*this, argument.customValue.object);
+    }
+
+    saUnreachable ("Invalid format argument type.");
 }
 
-FormatObjectsHolder sa::FormatObjectsHolder::operator<< (unique_ptr <IFormattable> argument)
+FormatBuffer* sa::FormatBuffer::acquireThreadBuffer()
 {
-    FormatObjectsHolder newObject (move (*this));
-    newObject.arguments.push_back (move (argument));
-    return move (newObject);
+    static thread_local FormatBuffer threadBuffer;
+
+    if (threadBuffer.isAcquired)
+        return new FormatBuffer;
+
+    threadBuffer.isAcquired = true;
+    threadBuffer.clear();
+    return &threadBuffer;
 }
 
-std::string sa::FormatObjectsHolder::format()
+void sa::FormatBuffer::releaseThreadBuffer (FormatBuffer* buffer)
 {
-    string result = "";
+    if (buffer->isAcquired)
+        buffer->isAcquired = false;
+    else
+        delete buffer;
+}
 
-    bool wasPercent = false;
-    for (char c: formatString)
-    {
-        if (c == '%')
-        {
-            if (wasPercent)
-            {
-                wasPercent = false;
-                result += '%';
-            }
-            else
-            {
-                wasPercent = true;
-            }
+sa::FormatString::FormatString (string source) :
+    source (source)
+{
+    uint32_t literalBegin = 0;
+    uint32_t length = static_cast <uint32_t> (source.length());
 
+    for (uint32_t i = 0; i < length; i++)
+    {
+        if (source[i] != '%')
             continue;
-        }
 
-        if (wasPercent)
+        saAssert (i + 1 < length);
+        char specifier = source[i + 1];
+
+        if (specifier == '%')
+        {
+            // The first percent sign goes to the literal, the second one is skipped
+            segments.push_back (Segment { literalBegin, i + 1 - literalBegin, noArgument });
+        }
+        else
         {
-            unsigned number = static_cast <unsigned char> (c) - '1';
-            saAssert (number >= 0 && number < arguments.size());
+            saAssert (specifier >= '1' && specifier <= '9');
+            uint32_t index = static_cast <uint32_t> (specifier - '1');
 
-            result += formatSimple (arguments[number].get());
-            wasPercent = false;
-            continue;
+            segments.push_back (Segment { literalBegin, i - literalBegin, index });
+            nArgumentsRequired = max (nArgumentsRequired, index + 1);
         }
 
-        result += c;
+        i++;
+        literalBegin = i + 1;
     }
-    return result;
+
+    if (literalBegin < length)
+        segments.push_back (Segment { literalBegin, length - literalBegin, noArgument });
 }
 
-string sa::FormatObjectsHolder::formatSimple (IFormattable* object)
+void sa::FormatString::format (FormatBuffer& buffer, const FormatArgument* arguments, unsigned nArguments) const
 {
-    saAssert (object);
+    saAssert (nArgumentsRequired <= nArguments);
 
-    if (FormattableString* theString = dynamic_cast <FormattableString*> (object))
-    {
-        return theString->contents;
-    }
-    else if (FormattableVector* theVector = dynamic_cast <FormattableVector*> (object))
+    const char* data = source.data();
+    for (const Segment& segment: segments)
     {
-        string result = "{ ";
-        if (theVector->elements.empty())
-            result += "empty";
+        buffer.append (data + segment.literalBegin, segment.literalLength);
 
-        for (unsigned i = 0; i < theVector->elements.size(); i++)
-        {
-            if (i > 0)
-                result += ", ";
-            result += '"';
-            result += formatSimple (theVector->elements[i].get());
-            result += '"';
-        }
-        result += " }";
-        return result;
+        if (segment.argumentIndex != noArgument)
+            buffer.appendArgument (arguments[segment.argumentIndex]);
     }
+}
+
+const FormatString& sa::FormatCallSite::resolve (const char* literal, bool translate)
+{
+    InternationalizationEngine& engine = InternationalizationEngine::instance();
+
+    const FormatString* cached = parsed.load (memory_order_acquire);
+    if (cached && (!translate || cached->generation == engine.getGeneration()))
+        return *cached;
+
+    uint32_t generation = engine.getGeneration();
+    unique_ptr <FormatString> fresh (new FormatString (translate ? engine.getTranslated (literal) : literal));
+    fresh->id = lastId.fetch_add (1, memory_order_relaxed) + 1;
+    fresh->generation = generation;
+    fresh->replaced.reset (cached);
+
+    // Some other thread may have resolved the same call site concurrently
+    if (parsed.compare_exchange_strong (cached, fresh.get(), memory_order_acq_rel))
+        return *fresh.release();
+
+    fresh->replaced.release();
+    return *cached;
+}
+
+atomic <uint32_t> sa::FormatCallSite::lastId (0);
+
+sa::FormatObjectsHolder::FormatObjectsHolder (const string& format, FormatCallSite& /*site*/, bool translate) :
+    ownedFormatString (translate ? saTranslate (format) : format), formatString (&ownedFormatString),
+    action (nullptr), nArguments (0)
+{}
+
+sa::FormatObjectsHolder::FormatObjectsHolder (const string& format, FormatCallSite& /*site*/, bool translate,
+                                              const IAfterformatAction& action) :
+    ownedFormatString (translate ? saTranslate (format) : format), formatString (&ownedFormatString),
+    action (&action), nArguments (0)
+{}
+
+sa::FormatObjectsHolder::~FormatObjectsHolder()
+{
+    if (action)
+        action->fire (getMessage());
+}
+
+sa::FormatObjectsHolder::operator string() const
+{
+    return getMessage().toString();
+}
 
-    saUnreachable ("Not supported IFormattable instance.");
+FormatMessage sa::FormatObjectsHolder::getMessage() const
+{
+    return FormatMessage (*formatString, arguments, nArguments);
+}
+
+string sa::FormatMessage::toString() const
+{
+    FormatBuffer buffer;
+    format (buffer);
+    return buffer.getContents();
 }
 
-unique_ptr <IFormattable> sa::wrapFormattable (string s)
+FormatArgument& sa::FormatObjectsHolder::addArgument()
 {
-    unique_ptr <IFormattable> result (new FormattableString);
-    FormattableString* theString = dynamic_cast <FormattableString*> (result.get());
-    theString->contents = s;
-    return result;
+    saAssert (nArguments < FormatString::maxArguments);
+    return arguments[nArguments++];
 }
 
-unique_ptr <IFormattable> sa::wrapFormattable (int x)
+void sa::FormatObjectsHolder::own (FormatArgument& stored, string&& argument)
 {
-    unique_ptr <IFormattable> result (new FormattableString);
-    FormattableString* theString = dynamic_cast <FormattableString*> (result.get());
-    std::stringstream s;
-    s << x;
-    theString->contents = s.str();
-    return result;
+    string& owned = ownedStrings[&stored - arguments];
+    owned = move (argument);
+    stored = makeFormatArgument (owned);
 }
@@ -15,14 +15,32 @@
    saError ("something") << objects;      - error entry (see ApplicationLog.h) + translation
 
    Module internals:
-   - global function wrapFormattable should construct a wrapper around every acceptable object type (see IFormattable)
    - format strings do not longer define the type of accepted object, but how to handle it
-   - format strings contain index of passed object to operate on (e. g. %1)
+   - format strings contain index of passed object to operate on (e. g. %1, up to %9); %% is a percent sign
+   - format strings are parsed into FormatString objects once. Every macro expansion owns a static FormatCallSite,
+     so string literals are parsed (and translated) on the first use only, or the first use after a translation
+     catalog switch. Non-literal format strings (e. g. std::string variables) are parsed on every use.
+   - FormatObjectsHolder is a non-movable temporary, every operator<< returns a reference to it.
+     Arguments are stored inline as FormatArgument objects: no heap allocations per argument.
+   - lvalue arguments are referenced, not copied, so they must outlive the statement (the usual case for variables).
+     Temporary strings are moved into the holder, other temporary objects are formatted immediately.
+     C string pointers are copied, as they may point into temporaries (e. g. 'temporary.c_str()'); literals are not.
+   - argument types are checked at compile time: makeFormatArgument must be overloaded for every formattable type
+     (see the overloads below), an unsupported type results in a compilation error.
+   - output is written to a FormatBuffer.
+   - actions (see IAfterformatAction) get a FormatMessage: the parsed format string & captured arguments.
+     The text is produced only if the action really needs it (e. g. the binary log stores typed arguments instead).
    - later clang-like formatting system may be used
      (see http://clang.llvm.org/docs/InternalsManual.html, "The Diagnostics Subsystem")
 */
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "Internationalization.h"
@@ -31,78 +49,370 @@ namespace sa
 {
 using namespace std;
 
-class IFormattable
+class FormatBuffer;
+
+class FormatArgument
 {
 public :
-    virtual ~IFormattable();
+    enum class Type
+    {
+        SIGNED_INTEGER,
+        UNSIGNED_INTEGER,
+        FLOATING_POINT,
+        STRING,
+        // Arbitrary object formatted by a function pointer (e. g. vectors)
+        CUSTOM
+    };
+
+    typedef void (*CustomFormatter) (FormatBuffer& buffer, const void* object);
+
+    struct StringValue
+    {
+        const char* data;
+        size_t length;
+    };
+
+    struct CustomValue
+    {
+        const void* object;
+        CustomFormatter formatter;
+    };
+
+    Type type;
+
+    union
+    {
+        int64_t signedValue;
+        uint64_t unsignedValue;
+        double floatingPointValue;
+        StringValue stringValue;
+        CustomValue customValue;
+    };
 };
 
-class FormattableVector : public IFormattable
+class FormatBuffer
 {
 public :
-    vector < unique_ptr <IFormattable> > elements;
+    FormatBuffer() = default;
+
+    void clear();
+
+    const string& getContents() const
+    {
+        return contents;
+    }
 
-    ~FormattableVector();
+    void append (const char* data, size_t length)
+    {
+        contents.append (data, length);
+    }
+
+    void append (const string& s)
+    {
+        contents.append (s);
+    }
+
+    void append (char c)
+    {
+        contents.push_back (c);
+    }
+
+    void appendSigned (int64_t value);
+    void appendUnsigned (uint64_t value);
+    void appendFloatingPoint (double value);
+    void appendArgument (const FormatArgument& argument);
+
+    // Reused buffer of the calling thread. Nested usage (formatting inside of formatting) falls back to a new buffer.
+    static FormatBuffer* acquireThreadBuffer();
+    static void releaseThreadBuffer (FormatBuffer* buffer);
+
+private :
+    FormatBuffer (const FormatBuffer&) = delete;
+    FormatBuffer& operator= (const FormatBuffer&) = delete;
+
+    string contents;
+    bool isAcquired = false;
 };
 
-class FormattableString : public IFormattable
+class FormatString
 {
 public :
-    string contents;
+    static const unsigned maxArguments = 9;
+
+    FormatString() = default;
+    explicit FormatString (string source);
+
+    const string& getSource() const
+    {
+        return source;
+    }
+
+    // Maximal argument index used plus one
+    unsigned getNumArgumentsRequired() const
+    {
+        return nArgumentsRequired;
+    }
+
+    // Process-unique positive id of format strings cached by call sites, 0 for runtime format strings
+    uint32_t getId() const
+    {
+        return id;
+    }
+
+    void format (FormatBuffer& buffer, const FormatArgument* arguments, unsigned nArguments) const;
+
+private :
+    friend class FormatCallSite;
+
+    static const uint32_t noArgument = ~0u;
+
+    // Literal source substring followed by an argument (if any)
+    struct Segment
+    {
+        uint32_t literalBegin, literalLength;
+        uint32_t argumentIndex;
+    };
+
+    string source;
+    vector <Segment> segments;
+    unsigned nArgumentsRequired = 0;
+    uint32_t id = 0;
+
+    // Translation catalog generation the string was translated with (see InternationalizationEngine)
+    uint32_t generation = 0;
+
+    // The string this one replaced at the same call site: references to it may still be in use
+    unique_ptr <const FormatString> replaced;
+};
+
+// Every saFormat* macro expansion owns a static call site, which caches the parsed format string literal.
+// The object is constant-initialized, so no static initialization guards are involved.
+// Translated strings are resolved again once the translation catalog generation changes.
+class FormatCallSite
+{
+public :
+    constexpr FormatCallSite() :
+        parsed (nullptr)
+    {}
+
+    const FormatString& resolve (const char* literal, bool translate);
+
+private :
+    FormatCallSite (const FormatCallSite&) = delete;
+    FormatCallSite& operator= (const FormatCallSite&) = delete;
+
+    // Never freed: lives as long as the call site does
+    atomic <const FormatString*> parsed;
+
+    static atomic <uint32_t> lastId;
+};
+
+// A format string with captured arguments. Arguments are views, valid while the originating holder lives.
+class FormatMessage
+{
+public :
+    FormatMessage (const FormatString& formatString, const FormatArgument* arguments, unsigned nArguments) :
+        formatString (formatString), arguments (arguments), nArguments (nArguments)
+    {}
 
-    ~FormattableString();
+    const FormatString& getFormatString() const
+    {
+        return formatString;
+    }
+
+    unsigned getNumArguments() const
+    {
+        return nArguments;
+    }
+
+    const FormatArgument& getArgument (unsigned index) const
+    {
+        return arguments[index];
+    }
+
+    void format (FormatBuffer& buffer) const
+    {
+        formatString.format (buffer, arguments, nArguments);
+    }
+
+    string toString() const;
+
+private :
+    const FormatString& formatString;
+    const FormatArgument* arguments;
+    unsigned nArguments;
 };
 
-unique_ptr <IFormattable> wrapFormattable (string s);
-unique_ptr <IFormattable> wrapFormattable (int x);
+inline FormatArgument makeFormatArgument (const char* s)
+{
+    FormatArgument argument;
+    argument.type = FormatArgument::Type::STRING;
+    argument.stringValue.data = s;
+    argument.stringValue.length = strlen (s);
+    return argument;
+}
+
+inline FormatArgument makeFormatArgument (const string& s)
+{
+    FormatArgument argument;
+    argument.type = FormatArgument::Type::STRING;
+    argument.stringValue.data = s.data();
+    argument.stringValue.length = s.length();
+    return argument;
+}
+
+inline FormatArgument makeFormatArgument (bool value)
+{
+    return makeFormatArgument (value ? "true" : "false");
+}
 
 template <class T>
-unique_ptr <IFormattable> wrapFormattable (vector <T>& object)
+typename enable_if <is_integral <T>::value && is_signed <T>::value, FormatArgument>::type makeFormatArgument (T value)
 {
-    unique_ptr <IFormattable> result (new FormattableVector);
-    FormattableVector* theVector = dynamic_cast <FormattableVector*> (result.get());
-    for (auto& element: object)
-        theVector->elements.push_back (move (wrapFormattable (element)));
-    return result;
+    FormatArgument argument;
+    argument.type = FormatArgument::Type::SIGNED_INTEGER;
+    argument.signedValue = static_cast <int64_t> (value);
+    return argument;
+}
+
+template <class T>
+typename enable_if <is_integral <T>::value && is_unsigned <T>::value && !is_same <T, bool>::value, FormatArgument>::type
+makeFormatArgument (T value)
+{
+    FormatArgument argument;
+    argument.type = FormatArgument::Type::UNSIGNED_INTEGER;
+    argument.unsignedValue = static_cast <uint64_t> (value);
+    return argument;
+}
+
+template <class T>
+typename enable_if <is_floating_point <T>::value, FormatArgument>::type makeFormatArgument (T value)
+{
+    FormatArgument argument;
+    argument.type = FormatArgument::Type::FLOATING_POINT;
+    argument.floatingPointValue = static_cast <double> (value);
+    return argument;
+}
+
+template <class T>
+void formatVector (FormatBuffer& buffer, const void* object)
+{
+    const vector <T>& theVector = *static_cast <const vector <T>*> (object);
+
+    buffer.append ("{ ", 2);
+    if (theVector.empty())
+        buffer.append ("empty", 5);
+
+    for (size_t i = 0; i < theVector.size(); i++)
+    {
+        if (i > 0)
+            buffer.append (", ", 2);
+        buffer.append ('"');
+        buffer.appendArgument (makeFormatArgument (theVector[i]));
+        buffer.append ('"');
+    }
+    buffer.append (" }", 2);
+}
+
+template <class T>
+FormatArgument makeFormatArgument (const vector <T>& object)
+{
+    FormatArgument argument;
+    argument.type = FormatArgument::Type::CUSTOM;
+    argument.customValue.object = &object;
+    argument.customValue.formatter = &formatVector <T>;
+    return argument;
 }
 
 class IAfterformatAction
 {
 public :
     virtual ~IAfterformatAction();
-    virtual void fire (string formattedString) = 0;
+    virtual void fire (const FormatMessage& message) const = 0;
 };
 
 class FormatObjectsHolder
 {
 public :
-    FormatObjectsHolder (string formatString, IAfterformatAction* action);
+    // String literals: parsed once per call site
+    template <size_t N>
+    FormatObjectsHolder (const char (&formatLiteral)[N], FormatCallSite& site, bool translate) :
+        formatString (&site.resolve (formatLiteral, translate)), action (nullptr), nArguments (0)
+    {}
+
+    // The action must outlive the holder (a temporary passed to the constructor does)
+    template <size_t N>
+    FormatObjectsHolder (const char (&formatLiteral)[N], FormatCallSite& site, bool translate,
+                         const IAfterformatAction& action) :
+        formatString (&site.resolve (formatLiteral, translate)), action (&action), nArguments (0)
+    {}
+
+    // Runtime format strings: parsed on every use
+    FormatObjectsHolder (const string& format, FormatCallSite& site, bool translate);
+    FormatObjectsHolder (const string& format, FormatCallSite& site, bool translate, const IAfterformatAction& action);
+
     ~FormatObjectsHolder();
 
-    operator string();
+    operator string() const;
+
+    FormatMessage getMessage() const;
 
+    // Lvalues (referenced) and scalar rvalues (copied)
     template <class T>
-    FormatObjectsHolder operator<< (T argument)
+    typename enable_if <!is_pointer <T>::value, FormatObjectsHolder&>::type operator<< (const T& argument)
     {
-        return move (*this << wrapFormattable (argument));
+        addArgument() = makeFormatArgument (argument);
+        return *this;
     }
 
-    FormatObjectsHolder operator<< (unique_ptr <IFormattable> argument);
+    // C strings (copied): the holder may be formatted after the buffer they point to is gone
+    template <class T>
+    typename enable_if <is_pointer <T>::value, FormatObjectsHolder&>::type operator<< (const T& argument)
+    {
+        FormatArgument& stored = addArgument();
+        own (stored, string (argument));
+        return *this;
+    }
+
+    // Temporary objects are owned by the holder
+    template <class T>
+    typename enable_if <is_class <T>::value, FormatObjectsHolder&>::type operator<< (T&& argument)
+    {
+        FormatArgument& stored = addArgument();
+        own (stored, move (argument));
+        return *this;
+    }
 
 private :
-    FormatObjectsHolder();
-    FormatObjectsHolder (FormatObjectsHolder&&) = default;
+    FormatObjectsHolder (const FormatObjectsHolder&) = delete;
+    FormatObjectsHolder& operator= (const FormatObjectsHolder&) = delete;
+
+    FormatString ownedFormatString;
+    const FormatString* formatString;
 
-    unique_ptr <IAfterformatAction> action;
-    string formatString;
-    vector < unique_ptr <IFormattable> > arguments;
+    const IAfterformatAction* action;
 
-    string format();
-    string formatSimple (IFormattable* object);
+    unsigned nArguments;
+    FormatArgument arguments[FormatString::maxArguments];
+    string ownedStrings[FormatString::maxArguments];
+
+    FormatArgument& addArgument();
+
+    void own (FormatArgument& stored, string&& argument);
+
+    template <class T>
+    void own (FormatArgument& stored, T&& argument)
+    {
+        FormatBuffer buffer;
+        buffer.appendArgument (makeFormatArgument (static_cast <const T&> (argument)));
+        own (stored, string (buffer.getContents()));
+    }
 };
 
-#define saFormatPure(x) sa::FormatObjectsHolder (x, nullptr)
-#define saFormat(x) sa::FormatObjectsHolder (saTranslate (x), nullptr)
+#define saFormatCallSite() ([]() -> sa::FormatCallSite& { static sa::FormatCallSite site; return site; }())
+
+#define saFormatPure(x) sa::FormatObjectsHolder (x, saFormatCallSite(), false)
+#define saFormat(x) sa::FormatObjectsHolder (x, saFormatCallSite(), true)
 
 }
 
@@ -0,0 +1,182 @@
+#include <algorithm>
+
+#include "StyleDiagnostics.h"
+#include "StringFormatter.h"
+
+using namespace sa;
+using namespace std;
+
+static NamingStyle parseNamingStyle (const IniConfiguration& project, const char* key, NamingStyle defaultStyle)
+{
+    if (!project[key].isDefined())
+        return defaultStyle;
+
+    string style = project[key].asString();
+    if (style == "lowerCamelCase") return NamingStyle::LOWER_CAMEL_CASE;
+    if (style == "UpperCamelCase") return NamingStyle::UPPER_CAMEL_CASE;
+    if (style == "snake_case")     return NamingStyle::SNAKE_CASE;
+    if (style == "UPPER_CASE")     return NamingStyle::UPPER_CASE;
+    if (style == "any")            return NamingStyle::ANY;
+
+    throw InvalidArgumentException (__ORIGIN__, "Unknown naming style '" + style + "' of '" + key + "'", "project");
+}
+
+const char* sa::getNamingStyleName (NamingStyle style)
+{
+    switch (style)
+    {
+        case NamingStyle::ANY:              return "any";
+        case NamingStyle::LOWER_CAMEL_CASE: return "lowerCamelCase";
+        case NamingStyle::UPPER_CAMEL_CASE: return "UpperCamelCase";
+        case NamingStyle::SNAKE_CASE:       return "snake_case";
+        case NamingStyle::UPPER_CASE:       return "UPPER_CASE";
+    }
+    saUnreachable ("Invalid naming style.");
+}
+
+StyleRules sa::StyleRules::load (const IniConfiguration& project)
+{
+    StyleRules rules = StyleRules { 4, NamingStyle::UPPER_CAMEL_CASE, NamingStyle::LOWER_CAMEL_CASE,
+                                    NamingStyle::LOWER_CAMEL_CASE };
+
+    if (project["style.indentwidth"].isDefined())
+        rules.indentWidth = static_cast <uint32_t> (max (project["style.indentwidth"].asInteger(), 1));
+
+    rules.typeNames = parseNamingStyle (project, "style.typenames", rules.typeNames);
+    rules.functionNames = parseNamingStyle (project, "style.functionnames", rules.functionNames);
+    rules.variableNames = parseNamingStyle (project, "style.variablenames", rules.variableNames);
+    return rules;
+}
+
+bool sa::matchesNamingStyle (const string& name, NamingStyle style)
+{
+    // Leading & trailing underscores are decoration (i. e. reserved names), digits fit any style
+    size_t begin = name.find_first_not_of ('_'), end = name.find_last_not_of ('_');
+    if (style == NamingStyle::ANY || begin == string::npos)
+        return true;
+
+    bool hasLower = false, hasUpper = false, hasUnderscore = false;
+    for (size_t i = begin; i <= end; i++)
+    {
+        hasLower |= islower (static_cast <unsigned char> (name[i])) != 0;
+        hasUpper |= isupper (static_cast <unsigned char> (name[i])) != 0;
+        hasUnderscore |= name[i] == '_';
+    }
+
+    switch (style)
+    {
+        case NamingStyle::ANY:              return true;
+        case NamingStyle::LOWER_CAMEL_CASE: return !hasUnderscore && !isupper (static_cast <unsigned char> (name[begin]));
+        case NamingStyle::UPPER_CAMEL_CASE: return !hasUnderscore && !islower (static_cast <unsigned char> (name[begin]));
+        case NamingStyle::SNAKE_CASE:       return !hasUpper;
+        case NamingStyle::UPPER_CASE:       return !hasLower;
+    }
+    saUnreachable ("Invalid naming style.");
+}
+
+static bool isComment (boost::string_ref tokenValue)
+{
+    return tokenValue.starts_with ("//") || tokenValue.starts_with ("/*");
+}
+
+static void checkIndentation (FileContext& fileContext, const StyleRules& rules, uint32_t beginOffset,
+                              uint32_t endOffset, vector <StyleDiagnostic>& diagnostics)
+{
+    const IndentationContext& context = *fileContext.getIndentationContext();
+    const string& contents = fileContext.getFileContents();
+
+    // Lines continuing a statement are not checked: the last token before such a line is not a statement end
+    for (uint32_t i = context.findToken (beginOffset); i < context.getNumTokens(); i++)
+    {
+        uint32_t offset = context.getTokenOffset (i);
+        if (offset >= endOffset)
+            break;
+
+        TokenInterval interval = context.getIntervalBefore (i);
+        if (!interval.isAfterNewline || isComment (context.getTokenValue (i)))
+            continue;
+
+        uint32_t previous = i - 1;
+        while (previous > 0 && isComment (context.getTokenValue (previous)))
+            previous--;
+
+        boost::string_ref previousValue = context.getTokenValue (previous);
+        if (previousValue != ";" && previousValue != "{" && previousValue != "}")
+            continue;
+
+        uint32_t lineBegin = offset;
+        while (lineBegin > 0 && contents[lineBegin - 1] != '\n')
+            lineBegin--;
+
+        uint32_t nSpaces = offset - lineBegin;
+        if (contents.find ('\t', lineBegin) < offset)
+        {
+            diagnostics.push_back (StyleDiagnostic { lineBegin, nSpaces, "indentation",
+                                                     saFormat ("Indentation contains tabs") });
+            continue;
+        }
+
+        if (nSpaces % rules.indentWidth != 0)
+        {
+            diagnostics.push_back (StyleDiagnostic { lineBegin, nSpaces, "indentation",
+                                                     saFormat ("Indentation of %1 spaces is not a multiple of %2")
+                                                         << nSpaces << rules.indentWidth });
+            continue;
+        }
+
+        // Relative to the previous line
+        int32_t growth = static_cast <int32_t> (interval.nSpaces);
+        if (growth > static_cast <int32_t> (rules.indentWidth))
+            diagnostics.push_back (StyleDiagnostic { lineBegin, nSpaces, "indentation",
+                                                     saFormat ("Indentation grows by %1 spaces, by %2 at most expected")
+                                                         << growth << rules.indentWidth });
+    }
+}
+
+static void checkNames (FileContext& fileContext, const StyleRules& rules, uint32_t beginOffset, uint32_t endOffset,
+                        vector <StyleDiagnostic>& diagnostics)
+{
+    const vector <NameDeclaration>& declarations = fileContext.getNameContext()->getDeclarations();
+    auto it = lower_bound (declarations.begin(), declarations.end(), beginOffset,
+                           [] (const NameDeclaration& declaration, uint32_t offset)
+                           { return declaration.fileBufferOffset < offset; });
+
+    for (; it != declarations.end() && it->fileBufferOffset < endOffset; it++)
+    {
+        NamingStyle style = NamingStyle::ANY;
+        switch (it->kind)
+        {
+            case NameKind::TYPE:     style = rules.typeNames;     break;
+            case NameKind::FUNCTION: style = rules.functionNames; break;
+            case NameKind::VARIABLE: style = rules.variableNames; break;
+            case NameKind::OTHER:    continue;
+        }
+
+        if (matchesNamingStyle (it->name, style))
+            continue;
+
+        const char* styleName = getNamingStyleName (style);
+        string message;
+        if (it->kind == NameKind::TYPE)
+            message = saFormat ("Type name '%1' is not %2") << it->name << styleName;
+        else if (it->kind == NameKind::FUNCTION)
+            message = saFormat ("Function name '%1' is not %2") << it->name << styleName;
+        else
+            message = saFormat ("Variable name '%1' is not %2") << it->name << styleName;
+
+        diagnostics.push_back (StyleDiagnostic { it->fileBufferOffset, static_cast <uint32_t> (it->name.length()), "naming",
+                                                 message });
+    }
+}
+
+vector <StyleDiagnostic> sa::checkStyle (FileContext& fileContext, const StyleRules& rules, uint32_t beginOffset,
+                                         uint32_t endOffset)
+{
+    vector <StyleDiagnostic> diagnostics;
+    checkIndentation (fileContext, rules, beginOffset, endOffset, diagnostics);
+    checkNames (fileContext, rules, beginOffset, endOffset, diagnostics);
+
+    stable_sort (diagnostics.begin(), diagnostics.end(), [] (const StyleDiagnostic& a, const StyleDiagnostic& b)
+                 { return a.fileBufferOffset < b.fileBufferOffset; });
+    return diagnostics;
+}
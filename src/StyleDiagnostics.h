@@ -0,0 +1,72 @@
+#ifndef STYLE_ANALYZER_STYLE_DIAGNOSTICS_H
+#define STYLE_ANALYZER_STYLE_DIAGNOSTICS_H
+
+/* Style diagnostics computed from a file context: indentation (IndentationContext) & naming (NameContext).
+
+   Rules are set in the [style] section of the project:
+   IndentWidth   = "4"                   ; lines starting a statement are indented by multiples of it,
+                                         ; one level deeper than the previous line at most, without tabs
+   TypeNames     = "UpperCamelCase"      ; classes, structures, enumerations, typedefs
+   FunctionNames = "lowerCamelCase"      ; functions & methods
+   VariableNames = "lowerCamelCase"      ; variables, fields, parameters
+   A naming style is one of "lowerCamelCase", "UpperCamelCase", "snake_case", "UPPER_CASE" or "any".
+   Lines continuing a statement (the previous token is not ';', '{' or '}') are free to align as they like.
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FileContext.h"
+#include "IniConfiguration.h"
+
+namespace sa
+{
+
+using std::string;
+using std::vector;
+
+enum class NamingStyle
+{
+    ANY,
+    LOWER_CAMEL_CASE,
+    UPPER_CAMEL_CASE,
+    SNAKE_CASE,
+    UPPER_CASE
+};
+
+struct StyleRules
+{
+    uint32_t indentWidth;
+    NamingStyle typeNames, functionNames, variableNames;
+
+    // Defaults for keys not set
+    static StyleRules load (const IniConfiguration& project);
+};
+
+struct StyleDiagnostic
+{
+    uint32_t fileBufferOffset, length;
+    // "indentation" or "naming"
+    string code;
+    string message;
+
+    bool operator== (const StyleDiagnostic& other) const
+    {
+        return fileBufferOffset == other.fileBufferOffset && length == other.length && code == other.code &&
+               message == other.message;
+    }
+};
+
+bool matchesNamingStyle (const string& name, NamingStyle style);
+
+// The name used in the [style] section
+const char* getNamingStyleName (NamingStyle style);
+
+// Diagnostics of the tokens & declarations starting within [beginOffset, endOffset), ordered by offsets
+vector <StyleDiagnostic> checkStyle (FileContext& fileContext, const StyleRules& rules, uint32_t beginOffset,
+                                     uint32_t endOffset);
+
+}
+
+#endif // STYLE_ANALYZER_STYLE_DIAGNOSTICS_H
@@ -0,0 +1,226 @@
+/* Summary format (native byte order):
+   - header: magic, version (32-bit)
+   - intervals (count, then for every one): classes, newline flag (8-bit), spaces (32-bit), count (64-bit)
+   - name counts by kind & style, then features (64-bit)
+*/
+
+#include <algorithm>
+#include <tuple>
+
+#include "StyleStatistics.h"
+#include "Debug.h"
+
+using namespace sa;
+using namespace std;
+
+static const uint32_t statisticsMagic = 0x53535341; // "ASSS"
+static const uint32_t statisticsVersion = 1;
+
+namespace
+{
+
+template <typename T> void writeValue (IOutputStream* stream, T value)
+{
+    stream->write (reinterpret_cast <const char*> (&value), sizeof (value));
+}
+
+template <typename T> T readValue (IInputStream* stream)
+{
+    T value;
+    saVerify (stream->read (reinterpret_cast <char*> (&value), sizeof (value)) == sizeof (value));
+    return value;
+}
+
+int32_t clampSpaces (int32_t nSpaces)
+{
+    return min (max (nSpaces, -StyleStatistics::maxIntervalSpaces), StyleStatistics::maxIntervalSpaces);
+}
+
+}
+
+const int32_t sa::StyleStatistics::maxIntervalSpaces;
+
+bool sa::IntervalKey::operator< (const IntervalKey& other) const
+{
+    return tie (previousClass, tokenClass, isAfterNewline, nSpaces) <
+           tie (other.previousClass, other.tokenClass, other.isAfterNewline, other.nSpaces);
+}
+
+sa::StyleStatistics::StyleStatistics() :
+    nameCounts(), features (StyleFeatures())
+{}
+
+void sa::StyleStatistics::addFile (FileContext& fileContext)
+{
+    const IndentationContext& context = *fileContext.getIndentationContext();
+    for (uint32_t i = 1; i < context.getNumTokens(); i++)
+    {
+        // Newline intervals keep indentation changes as unsigned differences
+        TokenInterval interval = context.getIntervalBefore (i);
+        IntervalKey key = IntervalKey { context.getTokenClassName (i - 1).to_string(),
+                                        context.getTokenClassName (i).to_string(), interval.isAfterNewline,
+                                        clampSpaces (static_cast <int32_t> (interval.nSpaces)) };
+        intervals[key]++;
+    }
+
+    for (const NameDeclaration& declaration: fileContext.getNameContext()->getDeclarations())
+    {
+        if (declaration.kind == NameKind::OTHER)
+            continue;
+
+        for (unsigned style = 0; style < nNamingStyles; style++)
+            if (matchesNamingStyle (declaration.name, static_cast <NamingStyle> (style)))
+                nameCounts[static_cast <unsigned> (declaration.kind)][style]++;
+    }
+
+    const string& contents = fileContext.getFileContents();
+    bool isLineStart = true, isIndentation = false, hasTabs = false;
+    for (size_t i = 0; i <= contents.length(); i++)
+    {
+        char c = i < contents.length() ? contents[i] : '\n';
+        if (c == '\n' || c == '\r')
+        {
+            // The last line counts if it is not empty
+            if (i < contents.length() || !isLineStart)
+                features.nLines++;
+            if (i > 0 && (contents[i - 1] == ' ' || contents[i - 1] == '\t'))
+                features.nTrailingSpaceLines++;
+            if (c == '\r' && i + 1 < contents.length() && contents[i + 1] == '\n')
+                i++;
+
+            isLineStart = true;
+            continue;
+        }
+
+        if (isLineStart)
+        {
+            isLineStart = false;
+            isIndentation = true;
+            hasTabs = false;
+        }
+
+        if (isIndentation && c != ' ' && c != '\t')
+        {
+            isIndentation = false;
+            features.nTabIndentedLines += hasTabs ? 1 : 0;
+        }
+        hasTabs |= c == '\t';
+    }
+
+    features.nFiles++;
+    features.nTokens += context.getNumTokens();
+}
+
+void sa::StyleStatistics::merge (const StyleStatistics& other)
+{
+    for (const auto& interval: other.intervals)
+        intervals[interval.first] += interval.second;
+
+    for (unsigned kind = 0; kind < nNameKinds; kind++)
+        for (unsigned style = 0; style < nNamingStyles; style++)
+            nameCounts[kind][style] += other.nameCounts[kind][style];
+
+    features.nFiles += other.features.nFiles;
+    features.nTokens += other.features.nTokens;
+    features.nLines += other.features.nLines;
+    features.nTabIndentedLines += other.features.nTabIndentedLines;
+    features.nTrailingSpaceLines += other.features.nTrailingSpaceLines;
+}
+
+uint64_t sa::StyleStatistics::getNumNames (NameKind kind, NamingStyle style) const
+{
+    saAssert (kind != NameKind::OTHER);
+    return nameCounts[static_cast <unsigned> (kind)][static_cast <unsigned> (style)];
+}
+
+StyleRules sa::StyleStatistics::inferRules (StyleRules rules) const
+{
+    uint64_t bestCount = 0;
+    for (const auto& interval: intervals)
+    {
+        const IntervalKey& key = interval.first;
+        if (key.previousClass == "{" && key.isAfterNewline && key.nSpaces > 0 && interval.second > bestCount)
+        {
+            rules.indentWidth = static_cast <uint32_t> (key.nSpaces);
+            bestCount = interval.second;
+        }
+    }
+
+    // Styles are tried in declaration order: ties go to the first one
+    auto inferNamingStyle = [this] (NameKind kind, NamingStyle& result)
+    {
+        uint64_t bestNameCount = 0;
+        for (unsigned style = static_cast <unsigned> (NamingStyle::ANY) + 1; style < nNamingStyles; style++)
+        {
+            if (getNumNames (kind, static_cast <NamingStyle> (style)) > bestNameCount)
+            {
+                result = static_cast <NamingStyle> (style);
+                bestNameCount = getNumNames (kind, result);
+            }
+        }
+    };
+
+    inferNamingStyle (NameKind::TYPE, rules.typeNames);
+    inferNamingStyle (NameKind::FUNCTION, rules.functionNames);
+    inferNamingStyle (NameKind::VARIABLE, rules.variableNames);
+    return rules;
+}
+
+void sa::StyleStatistics::save (IOutputStream* stream) const
+{
+    writeValue (stream, statisticsMagic);
+    writeValue (stream, statisticsVersion);
+
+    writeValue (stream, static_cast <uint32_t> (intervals.size()));
+    for (const auto& interval: intervals)
+    {
+        serializeString (stream, interval.first.previousClass);
+        serializeString (stream, interval.first.tokenClass);
+        writeValue (stream, static_cast <uint8_t> (interval.first.isAfterNewline));
+        writeValue (stream, interval.first.nSpaces);
+        writeValue (stream, interval.second);
+    }
+
+    for (unsigned kind = 0; kind < nNameKinds; kind++)
+        for (unsigned style = 0; style < nNamingStyles; style++)
+            writeValue (stream, nameCounts[kind][style]);
+
+    writeValue (stream, features);
+}
+
+StyleStatistics sa::StyleStatistics::load (IInputStream* stream)
+{
+    saVerify (readValue <uint32_t> (stream) == statisticsMagic);
+    saVerify (readValue <uint32_t> (stream) == statisticsVersion);
+
+    StyleStatistics statistics;
+    uint32_t nIntervals = readValue <uint32_t> (stream);
+    for (uint32_t i = 0; i < nIntervals; i++)
+    {
+        IntervalKey key;
+        key.previousClass = deserializeString (stream);
+        key.tokenClass = deserializeString (stream);
+        key.isAfterNewline = readValue <uint8_t> (stream) != 0;
+        key.nSpaces = readValue <int32_t> (stream);
+        statistics.intervals[key] = readValue <uint64_t> (stream);
+    }
+
+    for (unsigned kind = 0; kind < nNameKinds; kind++)
+        for (unsigned style = 0; style < nNamingStyles; style++)
+            statistics.nameCounts[kind][style] = readValue <uint64_t> (stream);
+
+    statistics.features = readValue <StyleFeatures> (stream);
+    return statistics;
+}
+
+bool sa::StyleStatistics::operator== (const StyleStatistics& other) const
+{
+    return intervals.size() == other.intervals.size() &&
+           equal (intervals.begin(), intervals.end(), other.intervals.begin(),
+                  [] (const pair <const IntervalKey, uint64_t>& a, const pair <const IntervalKey, uint64_t>& b)
+                  { return !(a.first < b.first) && !(b.first < a.first) && a.second == b.second; }) &&
+           equal (&nameCounts[0][0], &nameCounts[0][0] + nNameKinds * nNamingStyles, &other.nameCounts[0][0]) &&
+           features.nFiles == other.features.nFiles && features.nTokens == other.features.nTokens &&
+           features.nLines == other.features.nLines && features.nTabIndentedLines == other.features.nTabIndentedLines &&
+           features.nTrailingSpaceLines == other.features.nTrailingSpaceLines;
+}
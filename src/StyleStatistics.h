@@ -0,0 +1,89 @@
+#ifndef STYLE_ANALYZER_STYLE_STATISTICS_H
+#define STYLE_ANALYZER_STYLE_STATISTICS_H
+
+/* Style statistics: a compact summary of the style of files, made while grabbing & merged into a project summary.
+
+   A summary counts:
+   - intervals between tokens by the classes of both tokens (see IndentationContext::getTokenClassName): spaces on
+     the same line, or the indentation change of a new line; changes beyond 16 spaces are counted as 16
+   - declared names by kind & by the naming styles they match (a name may match several, i. e. "value")
+   - features: files, tokens, lines, lines indented with tabs, lines ending with spaces
+   Merging adds counts up: it is associative & commutative, summaries may be merged in any order. The size of a summary
+   depends on the token classes seen, not on the number of files: a project of any size is summarized in the same memory.
+   Invisible modifiers are not assigned to intervals yet: intervals are told apart by the token classes only.
+*/
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "FileContext.h"
+#include "StyleDiagnostics.h"
+
+namespace sa
+{
+
+using std::map;
+using std::string;
+
+struct IntervalKey
+{
+    string previousClass, tokenClass;
+    bool isAfterNewline;
+    // Spaces on the same line, or the change of the indentation of a new line
+    int32_t nSpaces;
+
+    bool operator< (const IntervalKey& other) const;
+};
+
+struct StyleFeatures
+{
+    uint64_t nFiles, nTokens, nLines, nTabIndentedLines, nTrailingSpaceLines;
+};
+
+class StyleStatistics
+{
+public :
+    static const int32_t maxIntervalSpaces = 16;
+
+    StyleStatistics();
+
+    // Counts the file: its contents, tokens & names
+    void addFile (FileContext& fileContext);
+
+    void merge (const StyleStatistics& other);
+
+    const map <IntervalKey, uint64_t>& getIntervals() const
+    {
+        return intervals;
+    }
+
+    // Names of the kind (NameKind::OTHER is not counted) matching the style; NamingStyle::ANY counts all of them
+    uint64_t getNumNames (NameKind kind, NamingStyle style) const;
+
+    const StyleFeatures& getFeatures() const
+    {
+        return features;
+    }
+
+    // The rules followed by most: the most frequent indentation after '{', the naming styles matched by most names.
+    // Rules given are kept where nothing was counted.
+    StyleRules inferRules (StyleRules rules) const;
+
+    void save (IOutputStream* stream) const;
+    static StyleStatistics load (IInputStream* stream);
+
+    bool operator== (const StyleStatistics& other) const;
+
+private :
+    static const unsigned nNameKinds = 3, nNamingStyles = 5;
+
+    map <IntervalKey, uint64_t> intervals;
+    // By NameKind, then by NamingStyle
+    uint64_t nameCounts[nNameKinds][nNamingStyles];
+    StyleFeatures features;
+};
+
+}
+
+#endif // STYLE_ANALYZER_STYLE_STATISTICS_H
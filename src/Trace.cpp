@@ -0,0 +1,227 @@
+#include <cstdio>
+#include <cstring>
+
+#include "Trace.h"
+#include "BinaryData.h"
+#include "Debug.h"
+
+using namespace sa;
+using namespace std;
+
+static string escapeJsonString (const string& value)
+{
+    string escaped;
+    escaped.reserve (value.length());
+
+    for (char c: value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast <unsigned char> (c) < 0x20)
+        {
+            char code[8];
+            snprintf (code, sizeof (code), "\\u%04x", static_cast <unsigned> (c));
+            escaped += code;
+        }
+        else
+            escaped += c;
+    }
+
+    return escaped;
+}
+
+TraceRecorder::TraceRecorder() :
+    recording (false), processId (1)
+{}
+
+TraceRecorder& TraceRecorder::instance()
+{
+    static TraceRecorder theInstance;
+    return theInstance;
+}
+
+void TraceRecorder::startRecording()
+{
+    saAssert (!isRecording());
+
+    lock_guard <mutex> lock (eventsMutex);
+    events.clear();
+    threads.clear();
+    processNames.clear();
+    mainThread = this_thread::get_id();
+    startTime = chrono::steady_clock::now();
+
+    recording.store (true, memory_order_release);
+}
+
+void TraceRecorder::stopRecording()
+{
+    recording.store (false, memory_order_release);
+}
+
+double TraceRecorder::getTimestamp() const
+{
+    return chrono::duration <double, micro> (chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned TraceRecorder::getThreadId()
+{
+    thread::id id = this_thread::get_id();
+    for (unsigned i = 0; i < threads.size(); i++)
+        if (threads[i] == id)
+            return i + 1;
+
+    threads.push_back (id);
+    return static_cast <unsigned> (threads.size());
+}
+
+void TraceRecorder::addEvent (const char* name, double beginTimestamp, double endTimestamp, const char* argumentName,
+                              const string& argumentValue)
+{
+    lock_guard <mutex> lock (eventsMutex);
+    events.push_back (Event { name, beginTimestamp, endTimestamp - beginTimestamp, processId, getThreadId(), argumentName,
+                              argumentValue });
+}
+
+unsigned TraceRecorder::getNumEvents()
+{
+    lock_guard <mutex> lock (eventsMutex);
+    return static_cast <unsigned> (events.size());
+}
+
+void TraceRecorder::write (IOutputStream* stream)
+{
+    lock_guard <mutex> lock (eventsMutex);
+
+    vector <string> entries;
+    char buffer[256];
+
+    for (unsigned i = 0; i < threads.size(); i++)
+    {
+        string threadName = threads[i] == mainThread ? "main" : "thread " + to_string (i + 1);
+        snprintf (buffer, sizeof (buffer), "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %u, \"tid\": %u, "
+                  "\"args\": {\"name\": \"%s\"}}", processId, i + 1, threadName.c_str());
+        entries.push_back (buffer);
+    }
+
+    for (const auto& process: processNames)
+        entries.push_back ("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " + to_string (process.first) +
+                           ", \"args\": {\"name\": \"" + escapeJsonString (process.second) + "\"}}");
+
+    for (const Event& event: events)
+    {
+        string entry = "{\"name\": \"" + escapeJsonString (event.name) + "\", \"cat\": \"sa\", \"ph\": \"X\"";
+        snprintf (buffer, sizeof (buffer), ", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %u, \"tid\": %u",
+                  event.beginTimestamp, event.duration, event.processId, event.threadId);
+        entry += buffer;
+
+        if (event.argumentName)
+            entry += ", \"args\": {\"" + escapeJsonString (event.argumentName) + "\": \"" +
+                     escapeJsonString (event.argumentValue) + "\"}";
+
+        entries.push_back (entry + "}");
+    }
+
+    string trace = "{\"traceEvents\": [\n";
+    for (unsigned i = 0; i < entries.size(); i++)
+        trace += entries[i] + (i + 1 == entries.size() ? "\n" : ",\n");
+    trace += "], \"displayTimeUnit\": \"ms\"}\n";
+
+    stream->write (trace.c_str(), static_cast <uint32_t> (trace.length()));
+    events.clear();
+}
+
+void TraceRecorder::continueInForkedProcess (unsigned processId, const string& processName)
+{
+    lock_guard <mutex> lock (eventsMutex);
+    events.clear();
+    threads.clear();
+    processNames.clear();
+    mainThread = this_thread::get_id();
+
+    this->processId = processId;
+    this->processName = processName;
+}
+
+static uint64_t getTimestampBits (double timestamp)
+{
+    uint64_t bits = 0;
+    memcpy (&bits, &timestamp, sizeof (bits));
+    return bits;
+}
+
+static double getTimestampFromBits (uint64_t bits)
+{
+    double timestamp = 0;
+    memcpy (&timestamp, &bits, sizeof (timestamp));
+    return timestamp;
+}
+
+string TraceRecorder::exportEvents()
+{
+    lock_guard <mutex> lock (eventsMutex);
+    if (events.empty())
+        return string();
+
+    BinaryWriter writer;
+    writer.writeInteger (processId);
+    writer.writeString (processName);
+    writer.writeInteger (static_cast <uint32_t> (events.size()));
+
+    for (const Event& event: events)
+    {
+        writer.writeString (event.name);
+        writer.writeInteger64 (getTimestampBits (event.beginTimestamp));
+        writer.writeInteger64 (getTimestampBits (event.duration));
+        writer.writeInteger (event.threadId);
+        writer.writeInteger (event.argumentName ? 1 : 0);
+        writer.writeString (event.argumentName ? event.argumentName : "");
+        writer.writeString (event.argumentValue);
+    }
+
+    events.clear();
+    return writer.contents;
+}
+
+void TraceRecorder::importEvents (const string& exported)
+{
+    if (exported.empty())
+        return;
+
+    lock_guard <mutex> lock (eventsMutex);
+    BinaryReader reader (exported.data(), exported.length());
+
+    unsigned importedProcessId = reader.readInteger();
+    processNames[importedProcessId] = reader.readString();
+
+    uint32_t nEvents = reader.readInteger();
+    for (uint32_t i = 0; i < nEvents && reader.isOk(); i++)
+    {
+        Event event;
+        event.name = importedNames.insert (reader.readString()).first->c_str();
+        event.beginTimestamp = getTimestampFromBits (reader.readInteger64());
+        event.duration = getTimestampFromBits (reader.readInteger64());
+        event.processId = importedProcessId;
+        event.threadId = reader.readInteger();
+
+        bool hasArgument = reader.readInteger() != 0;
+        const char* argumentName = importedNames.insert (reader.readString()).first->c_str();
+        event.argumentName = hasArgument ? argumentName : nullptr;
+        event.argumentValue = reader.readString();
+        events.push_back (event);
+    }
+
+    saVerify (reader.isOk() && reader.isAtEnd());
+}
+
+TraceScope::~TraceScope()
+{
+    if (beginTimestamp < 0)
+        return;
+
+    TraceRecorder& recorder = TraceRecorder::instance();
+    recorder.addEvent (name, beginTimestamp, recorder.getTimestamp(), argumentName, argumentValue);
+}
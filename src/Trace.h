@@ -0,0 +1,135 @@
+#ifndef STYLE_ANALYZER_TRACE_H
+#define STYLE_ANALYZER_TRACE_H
+
+/* Phase timing trace in Chrome trace-event format (chrome://tracing, Perfetto & similar viewers load it).
+
+   Phases are marked by scopes: saTraceScope ("Parse translation unit", "file", fileName);
+   A scope becomes a complete event ("ph": "X") with its start & duration in microseconds since recording started,
+   an optional argument (i. e. the processed file) & the track of its thread.
+
+   Recording is off by default: a scope only checks an atomic flag then, nothing is allocated or measured.
+   Events are kept in memory until written, the whole trace is written at once:
+   {"traceEvents": [{"name": "...", "cat": "sa", "ph": "X", "ts": 12.5, "dur": 40.0, "pid": 1, "tid": 1,
+                     "args": {"file": "a.cpp"}}, ...], "displayTimeUnit": "ms"}
+   Thread tracks are numbered in order of the first event, the thread which started recording is named "main".
+
+   Forked processes (i. e. grabbing workers) go on recording as processes of their own: they export their events,
+   the process writing the trace imports them. The steady clock is shared by processes of a system, so timestamps
+   of all processes are comparable.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Streams.h"
+
+namespace sa
+{
+
+using std::string;
+using std::vector;
+
+class TraceRecorder
+{
+public :
+    void startRecording();
+    void stopRecording();
+
+    bool isRecording() const
+    {
+        return recording.load (std::memory_order_relaxed);
+    }
+
+    // Recorded events are dropped after writing
+    void write (IOutputStream* stream);
+
+    // Called in a forked process: drops events inherited from the parent, events are recorded by the process given.
+    // Process 1 is the process which started recording.
+    void continueInForkedProcess (unsigned processId, const string& processName);
+
+    // Events recorded so far (dropped here) for importEvents in the process writing the trace
+    string exportEvents();
+    void importEvents (const string& exported);
+
+    unsigned getNumEvents();
+
+    // Microseconds since recording started
+    double getTimestamp() const;
+
+    void addEvent (const char* name, double beginTimestamp, double endTimestamp, const char* argumentName,
+                   const string& argumentValue);
+
+    static TraceRecorder& instance();
+
+private :
+    TraceRecorder();
+    TraceRecorder (const TraceRecorder&) = delete;
+    TraceRecorder& operator= (const TraceRecorder&) = delete;
+
+    struct Event
+    {
+        const char* name;
+        double beginTimestamp, duration;
+        unsigned processId, threadId;
+        const char* argumentName;
+        string argumentValue;
+    };
+
+    std::atomic <bool> recording;
+    std::chrono::steady_clock::time_point startTime;
+    std::thread::id mainThread;
+
+    std::mutex eventsMutex;
+    vector <Event> events;
+    vector <std::thread::id> threads;
+
+    unsigned processId;
+    string processName;
+    // Of imported events
+    std::map <unsigned, string> processNames;
+    // Names of imported events, referred to by them
+    std::set <string> importedNames;
+
+    unsigned getThreadId();
+};
+
+class TraceScope
+{
+public :
+    // Name & argument name must be string literals (their addresses are stored), the argument value is copied
+    explicit TraceScope (const char* name, const char* argumentName = nullptr, const string& argumentValue = string()) :
+        name (name), argumentName (argumentName), beginTimestamp (-1)
+    {
+        if (TraceRecorder::instance().isRecording())
+        {
+            if (argumentName)
+                this->argumentValue = argumentValue;
+            beginTimestamp = TraceRecorder::instance().getTimestamp();
+        }
+    }
+
+    ~TraceScope();
+
+private :
+    TraceScope (const TraceScope&) = delete;
+    TraceScope& operator= (const TraceScope&) = delete;
+
+    const char* name;
+    const char* argumentName;
+    string argumentValue;
+    double beginTimestamp;
+};
+
+#define saTraceScopeVariableJoin(name, line) name##line
+#define saTraceScopeVariable(name, line) saTraceScopeVariableJoin (name, line)
+#define saTraceScope(...) sa::TraceScope saTraceScopeVariable (traceScope, __LINE__) (__VA_ARGS__)
+
+}
+
+#endif // STYLE_ANALYZER_TRACE_H
@@ -0,0 +1,427 @@
+#include "TranslationCatalog.h"
+#include "StringFormatter.h"
+#include "FileSystem.h"
+#include "Debug.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+using namespace sa;
+using namespace std;
+
+static const uint32_t catalogMagic = 0x54434153; // "SACT"
+static const uint32_t catalogVersion = 1;
+
+static const size_t catalogHeaderSize = 3 * sizeof (uint32_t);
+
+// hash, source offset, source length, translation offset, translation length
+static const size_t catalogEntrySize = 5 * sizeof (uint32_t);
+
+// FNV-1a: cheap and good enough for a few thousands of strings
+static uint32_t hashCatalogString (const char* s, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast <unsigned char> (s[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+struct sa::TranslationCatalog::Storage
+{
+    unique_ptr <boost::interprocess::mapped_region> region;
+    string buffer;
+};
+
+sa::TranslationCatalog::TranslationCatalog (string name, unique_ptr <Storage> storage, const char* data, size_t size) :
+    name (name), storage (move (storage)), data (data), size (size), nEntries (0)
+{
+    validate();
+}
+
+sa::TranslationCatalog::~TranslationCatalog()
+{}
+
+uint32_t sa::TranslationCatalog::readInteger (size_t offset) const
+{
+    uint32_t integer;
+    memcpy (&integer, data + offset, sizeof (integer));
+    return integer;
+}
+
+const char* sa::TranslationCatalog::getString (uint32_t offset) const
+{
+    return data + offset;
+}
+
+void sa::TranslationCatalog::validate()
+{
+    auto invalid = [this] (string description) -> TranslationCatalogException
+    {
+        return TranslationCatalogException (__ORIGIN__, TranslationCatalogException::Type::INVALID_BINARY_CATALOG,
+                                            "Invalid translation catalog '" + name + "': " + description);
+    };
+
+    if (size < catalogHeaderSize || readInteger (0) != catalogMagic)
+        throw invalid ("not a compiled catalog");
+
+    if (readInteger (4) != catalogVersion)
+        throw invalid ("unsupported version " + toString (readInteger (4)));
+
+    nEntries = readInteger (8);
+    if ((size - catalogHeaderSize) / catalogEntrySize < nEntries)
+        throw invalid ("truncated entries table");
+
+    // Lookups rely on string bounds & order, so they are checked once here
+    uint32_t previousHash = 0;
+    for (uint32_t i = 0; i < nEntries; i++)
+    {
+        size_t entry = catalogHeaderSize + i * catalogEntrySize;
+
+        uint32_t hash = readInteger (entry);
+        if (hash < previousHash)
+            throw invalid ("entries are not sorted");
+        previousHash = hash;
+
+        for (size_t field = entry + 4; field < entry + catalogEntrySize; field += 8)
+        {
+            uint64_t offset = readInteger (field), length = readInteger (field + 4);
+            if (offset + length >= size || data[offset + length] != 0)
+                throw invalid ("string out of bounds in entry " + toString (i));
+        }
+    }
+}
+
+const char* sa::TranslationCatalog::find (const char* source, size_t length) const
+{
+    uint32_t hash = hashCatalogString (source, length);
+
+    uint32_t begin = 0, end = nEntries;
+    while (begin < end)
+    {
+        uint32_t middle = begin + (end - begin) / 2;
+        if (readInteger (catalogHeaderSize + middle * catalogEntrySize) < hash)
+            begin = middle + 1;
+        else
+            end = middle;
+    }
+
+    for (; begin < nEntries; begin++)
+    {
+        size_t entry = catalogHeaderSize + begin * catalogEntrySize;
+        if (readInteger (entry) != hash)
+            break;
+
+        uint32_t sourceLength = readInteger (entry + 8);
+        if (sourceLength == length && memcmp (getString (readInteger (entry + 4)), source, length) == 0)
+            return getString (readInteger (entry + 12));
+    }
+
+    return nullptr;
+}
+
+unique_ptr <TranslationCatalog> sa::TranslationCatalog::open (string fileName)
+{
+    if (!FileSystem::instance().fileExists (fileName))
+        throw FileNotFoundException (__ORIGIN__, fileName, "(translation catalog)");
+
+    using namespace boost::interprocess;
+
+    unique_ptr <Storage> storage (new Storage);
+    try
+    {
+        file_mapping mapping (fileName.c_str(), read_only);
+        storage->region.reset (new mapped_region (mapping, read_only));
+    }
+    catch (interprocess_exception& e)
+    {
+        throw InputOutputException (__ORIGIN__, "translation catalog '" + fileName + "'",
+                                    string ("Memory mapping (") + e.what() + ")");
+    }
+
+    const char* data = static_cast <const char*> (storage->region->get_address());
+    size_t size = storage->region->get_size();
+    return unique_ptr <TranslationCatalog> (new TranslationCatalog (fileName, move (storage), data, size));
+}
+
+unique_ptr <TranslationCatalog> sa::TranslationCatalog::load (string bufferName, string binaryContents)
+{
+    unique_ptr <Storage> storage (new Storage);
+    storage->buffer = move (binaryContents);
+
+    const char* data = storage->buffer.data();
+    size_t size = storage->buffer.size();
+    return unique_ptr <TranslationCatalog> (new TranslationCatalog (bufferName, move (storage), data, size));
+}
+
+namespace
+{
+
+class TextCatalogParser
+{
+public :
+    TextCatalogParser (string catalogSourceName, string contents) :
+        catalogSourceName (catalogSourceName), contents (contents), position (0), line (1)
+    {}
+
+    map <string, string> parse();
+
+private :
+    string catalogSourceName, contents;
+    size_t position;
+    unsigned line;
+
+    ATTRIBUTE_NORETURN void syntaxError (string description);
+
+    void skipSpaces();
+    bool atLineEnd();
+    string readIdentifier();
+    string readStringLiteral();
+
+    void addEntry (map <string, string>& entries, const string& source, const string& translation, unsigned sourceLine);
+};
+
+void TextCatalogParser::syntaxError (string description)
+{
+    throw TranslationCatalogException (__ORIGIN__, TranslationCatalogException::Type::INVALID_CATALOG_SYNTAX,
+                                       description + " on line " + toString (line) + " of " + catalogSourceName);
+}
+
+void TextCatalogParser::skipSpaces()
+{
+    while (position < contents.length() && (contents[position] == ' ' || contents[position] == '\t' ||
+                                            contents[position] == '\r'))
+        position++;
+}
+
+bool TextCatalogParser::atLineEnd()
+{
+    skipSpaces();
+    if (position == contents.length() || contents[position] == '\n')
+        return true;
+
+    return contents[position] == ';' || contents.compare (position, 2, "//") == 0;
+}
+
+string TextCatalogParser::readIdentifier()
+{
+    size_t begin = position;
+    while (position < contents.length() && isalpha (static_cast <unsigned char> (contents[position])))
+        position++;
+    return contents.substr (begin, position - begin);
+}
+
+string TextCatalogParser::readStringLiteral()
+{
+    skipSpaces();
+    if (position == contents.length() || contents[position] != '"')
+        syntaxError ("String literal expected");
+
+    string literal;
+    for (position++; position < contents.length() && contents[position] != '\n'; position++)
+    {
+        char c = contents[position];
+        if (c == '"')
+        {
+            position++;
+            return literal;
+        }
+
+        if (c != '\\')
+        {
+            literal.push_back (c);
+            continue;
+        }
+
+        if (++position == contents.length())
+            break;
+
+        switch (contents[position])
+        {
+            case 'n':  literal.push_back ('\n'); break;
+            case 't':  literal.push_back ('\t'); break;
+            case 'r':  literal.push_back ('\r'); break;
+            case '"':  literal.push_back ('"');  break;
+            case '\\': literal.push_back ('\\'); break;
+            default:   syntaxError (string ("Unknown escape sequence '\\") + contents[position] + "'");
+        }
+    }
+
+    syntaxError ("Unterminated string literal");
+}
+
+void TextCatalogParser::addEntry (map <string, string>& entries, const string& source, const string& translation,
+                                  unsigned sourceLine)
+{
+    auto invalidTranslation = [&] (string description) -> TranslationCatalogException
+    {
+        return TranslationCatalogException (__ORIGIN__, TranslationCatalogException::Type::INVALID_CATALOG_TRANSLATION,
+                                            description + " (source string on line " + toString (sourceLine) +
+                                            " of " + catalogSourceName + ")");
+    };
+
+    if (entries.count (source))
+        throw invalidTranslation ("Duplicate source string");
+
+    // Untranslated strings are not stored
+    if (translation.empty())
+        return;
+
+    unsigned nSourceArguments = 0, nTranslationArguments = 0;
+    try
+    {
+        nSourceArguments = FormatString (source).getNumArgumentsRequired();
+        nTranslationArguments = FormatString (translation).getNumArgumentsRequired();
+    }
+    catch (AssertionFailure&)
+    {
+        throw invalidTranslation ("Invalid format string");
+    }
+
+    if (nTranslationArguments > nSourceArguments)
+        throw invalidTranslation ("Translation refers to argument %" + toString (nTranslationArguments) +
+                                  " the source string has not");
+
+    entries[source] = translation;
+}
+
+map <string, string> TextCatalogParser::parse()
+{
+    map <string, string> entries;
+
+    // Entry being read: continuation lines are appended to the last string
+    string source, translation;
+    string* lastString = nullptr;
+    unsigned sourceLine = 0;
+
+    for (; position <= contents.length(); position++, line++)
+    {
+        if (!atLineEnd())
+        {
+            if (contents[position] == '"')
+            {
+                if (!lastString)
+                    syntaxError ("Unexpected string literal");
+                *lastString += readStringLiteral();
+            }
+            else
+            {
+                string keyword = readIdentifier();
+                if (keyword == "source")
+                {
+                    if (lastString == &source)
+                        syntaxError ("Translation expected");
+                    if (lastString)
+                        addEntry (entries, source, translation, sourceLine);
+
+                    source = readStringLiteral();
+                    translation.clear();
+                    lastString = &source;
+                    sourceLine = line;
+                }
+                else if (keyword == "translation")
+                {
+                    if (lastString != &source)
+                        syntaxError ("Unexpected translation");
+
+                    translation = readStringLiteral();
+                    lastString = &translation;
+                }
+                else
+                {
+                    syntaxError ("'source' or 'translation' expected");
+                }
+            }
+
+            if (!atLineEnd())
+                syntaxError ("End of line expected");
+        }
+
+        position = min (contents.find ('\n', position), contents.length());
+    }
+
+    if (lastString == &source)
+        syntaxError ("Translation expected");
+    if (lastString)
+        addEntry (entries, source, translation, sourceLine);
+
+    return entries;
+}
+
+void appendInteger (string& binary, uint32_t integer)
+{
+    binary.append (reinterpret_cast <const char*> (&integer), sizeof (integer));
+}
+
+}
+
+void sa::TranslationCatalog::compile (string catalogSourceName, IInputStream* textCatalog, IOutputStream* binaryCatalog)
+{
+    string contents (textCatalog->getNumBytesRemaining(), '\0');
+    if (!contents.empty())
+        saVerify (textCatalog->read (&contents[0], static_cast <uint32_t> (contents.length())) == contents.length());
+
+    map <string, string> entries = TextCatalogParser (catalogSourceName, contents).parse();
+
+    struct Entry
+    {
+        uint32_t hash;
+        const string* source;
+        const string* translation;
+
+        bool operator< (const Entry& other) const
+        {
+            return hash != other.hash ? hash < other.hash : *source < *other.source;
+        }
+    };
+
+    vector <Entry> sortedEntries;
+    for (auto& entry: entries)
+        sortedEntries.push_back (Entry { hashCatalogString (entry.first.data(), entry.first.length()),
+                                         &entry.first, &entry.second });
+    sort (sortedEntries.begin(), sortedEntries.end());
+
+    string binary;
+    appendInteger (binary, catalogMagic);
+    appendInteger (binary, catalogVersion);
+    appendInteger (binary, static_cast <uint32_t> (sortedEntries.size()));
+
+    string pool;
+    size_t poolOffset = catalogHeaderSize + sortedEntries.size() * catalogEntrySize;
+
+    auto appendString = [&] (const string& s)
+    {
+        appendInteger (binary, static_cast <uint32_t> (poolOffset + pool.length()));
+        appendInteger (binary, static_cast <uint32_t> (s.length()));
+        pool.append (s.c_str(), s.length() + 1);
+    };
+
+    for (const Entry& entry: sortedEntries)
+    {
+        appendInteger (binary, entry.hash);
+        appendString (*entry.source);
+        appendString (*entry.translation);
+    }
+
+    binary += pool;
+    saVerify (binary.length() <= UINT32_MAX);
+    binaryCatalog->write (binary.data(), static_cast <uint32_t> (binary.length()));
+}
+
+TranslationCatalogException::Type sa::TranslationCatalogException::getType() const
+{
+    return type;
+}
+
+string sa::TranslationCatalogException::toString() const
+{
+    return description;
+}
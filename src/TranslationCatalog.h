@@ -0,0 +1,102 @@
+#ifndef STYLE_ANALYZER_TRANSLATION_CATALOG_H
+#define STYLE_ANALYZER_TRANSLATION_CATALOG_H
+
+/* Translation catalogs used by the internationalization engine.
+
+   Catalogs are written as text files (see the translations directory) and compiled into a binary form,
+   which is mapped into memory as is: loading a catalog only checks the bounds, nothing is parsed or allocated per entry.
+
+   Text format (UTF-8):
+   ; comment                               (// comments are allowed too)
+   source "Grabbing data from file '%1'..."
+   translation "Сбор данных из файла '%1'..."
+   - strings use C++ escape sequences (\n, \t, \", \\), a line with a single string continues the previous one
+   - an empty translation means the string is not translated
+   - a translation must not refer to arguments the source string has not (e. g. %3 for a "%1 %2" source)
+
+   Binary format (native byte order, 32-bit integers):
+   - header: magic, version, number of entries
+   - entries sorted by (hash, source): hash of the source string, offsets & lengths of source & translation
+   - string pool: zero-terminated strings, offsets are counted from the beginning of the file
+*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Streams.h"
+
+namespace sa
+{
+
+using std::unique_ptr;
+using std::string;
+
+class TranslationCatalog
+{
+public :
+    ~TranslationCatalog();
+
+    // Zero-terminated translation or nullptr if the string is not translated. Valid while the catalog lives.
+    const char* find (const char* source, size_t length) const;
+
+    unsigned getNumEntries() const
+    {
+        return nEntries;
+    }
+
+    // Maps a compiled catalog file into memory
+    static unique_ptr <TranslationCatalog> open (string fileName);
+    static unique_ptr <TranslationCatalog> load (string bufferName, string binaryContents);
+
+    // Compiles a text catalog into binary form. Catalog source name is used for error messages only.
+    static void compile (string catalogSourceName, IInputStream* textCatalog, IOutputStream* binaryCatalog);
+
+private :
+    TranslationCatalog (const TranslationCatalog&) = delete;
+    TranslationCatalog& operator= (const TranslationCatalog&) = delete;
+
+    // Owns the memory (mapped region or buffer copy)
+    struct Storage;
+
+    TranslationCatalog (string name, unique_ptr <Storage> storage, const char* data, size_t size);
+
+    string name;
+    unique_ptr <Storage> storage;
+
+    const char* data;
+    size_t size;
+    uint32_t nEntries;
+
+    uint32_t readInteger (size_t offset) const;
+    const char* getString (uint32_t offset) const;
+    void validate();
+};
+
+class TranslationCatalogException : public Exception
+{
+public :
+    enum class Type
+    {
+        INVALID_CATALOG_SYNTAX,
+        INVALID_CATALOG_TRANSLATION,
+        INVALID_BINARY_CATALOG
+    };
+
+    TranslationCatalogException (const char* fileOrigin, int lineOrigin, const char* functionOrigin,
+                                 Type type, string description) :
+        Exception (fileOrigin, lineOrigin, functionOrigin, description), type (type), description (description)
+    {}
+
+    Type getType() const;
+
+    string toString() const;
+
+private :
+    Type type;
+    string description;
+};
+
+}
+
+#endif // STYLE_ANALYZER_TRANSLATION_CATALOG_H
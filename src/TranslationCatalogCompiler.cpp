@@ -0,0 +1,35 @@
+#include <cstdio>
+#include <iostream>
+
+#include "TranslationCatalog.h"
+#include "FileStreams.h"
+#include "Debug.h"
+
+using namespace std;
+
+int main (int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        cerr << "Usage: " << argv[0] << " <text catalog> <compiled catalog>" << endl;
+        return 1;
+    }
+
+    try
+    {
+        unique_ptr <sa::UniversalInputStream> textCatalog
+            = sa::UniversalInputStream::openInputStream (argv[1], sa::RelativeInputStreamFlags::NONE);
+        unique_ptr <sa::FileOutputStream> binaryCatalog
+            = sa::FileOutputStream::openOutputStream (argv[2], sa::RelativeOutputStreamFlags::BINARY);
+
+        sa::TranslationCatalog::compile (argv[1], textCatalog.get(), binaryCatalog.get());
+    }
+    catch (sa::Exception& e)
+    {
+        cerr << e.toString() << endl;
+        remove (argv[2]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "WorkerPool.h"
+
+using namespace sa;
+using namespace std;
+
+string sa::WorkerPoolException::toString() const
+{
+    return "Worker pool: " + operation + " failed";
+}
+
+// The failed call with the reason
+static string describeSystemError (const char* call)
+{
+    return string (call) + " (" + strerror (errno) + ")";
+}
+
+enum class ReadStatus
+{
+    READ,
+    // End of file or error
+    CLOSED,
+    TIMED_OUT
+};
+
+typedef chrono::steady_clock::time_point Deadline;
+
+// Waits for data until the deadline (Deadline::max() waits forever)
+static ReadStatus readFully (int fd, char* buffer, size_t nBytes, Deadline deadline)
+{
+    while (nBytes > 0)
+    {
+        if (deadline != Deadline::max())
+        {
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if (now >= deadline)
+                return ReadStatus::TIMED_OUT;
+
+            // Errors are left to read
+            pollfd descriptor = pollfd { fd, POLLIN, 0 };
+            int waitMilliseconds = static_cast <int> (chrono::duration_cast <chrono::milliseconds> (deadline - now).count());
+            int nReady = poll (&descriptor, 1, waitMilliseconds + 1);
+            if (nReady == 0 || (nReady < 0 && errno == EINTR))
+                continue;
+        }
+
+        ssize_t nRead = read (fd, buffer, nBytes);
+        if (nRead < 0 && errno == EINTR)
+            continue;
+        if (nRead <= 0)
+            return ReadStatus::CLOSED;
+
+        buffer += nRead;
+        nBytes -= static_cast <size_t> (nRead);
+    }
+
+    return ReadStatus::READ;
+}
+
+static bool writeFully (int fd, const char* buffer, size_t nBytes)
+{
+    while (nBytes > 0)
+    {
+        ssize_t nWritten = write (fd, buffer, nBytes);
+        if (nWritten < 0 && errno == EINTR)
+            continue;
+        if (nWritten <= 0)
+            return false;
+
+        buffer += nWritten;
+        nBytes -= static_cast <size_t> (nWritten);
+    }
+
+    return true;
+}
+
+// The deadline applies to the whole frame: a writer stopping in the middle of a frame does not block the reader
+static ReadStatus readFrame (int fd, string& frame, Deadline deadline)
+{
+    uint32_t length = 0;
+    ReadStatus status = readFully (fd, reinterpret_cast <char*> (&length), 4, deadline);
+    if (status != ReadStatus::READ)
+        return status;
+
+    frame.resize (length);
+    return length == 0 ? ReadStatus::READ : readFully (fd, &frame[0], length, deadline);
+}
+
+static bool writeFrame (int fd, const string& frame)
+{
+    uint32_t length = static_cast <uint32_t> (frame.length());
+    return writeFully (fd, reinterpret_cast <const char*> (&length), 4) && writeFully (fd, frame.data(), frame.length());
+}
+
+sa::WorkerPool::WorkerPool (unsigned nWorkers, TaskHandler taskHandler, WorkerStartHandler startHandler,
+                            chrono::milliseconds timeout) :
+    taskHandler (taskHandler), startHandler (startHandler), timeout (timeout), nRunningTasks (0), nRestarts (0)
+{
+    saAssert (nWorkers > 0);
+
+    // Writing to a crashed worker must fail, not kill the coordinator
+    signal (SIGPIPE, SIG_IGN);
+
+    workers.resize (nWorkers);
+    for (unsigned i = 0; i < nWorkers; i++)
+        startWorker (i);
+}
+
+sa::WorkerPool::~WorkerPool()
+{
+    for (unsigned i = 0; i < workers.size(); i++)
+        stopWorker (i, false);
+}
+
+void sa::WorkerPool::startWorker (unsigned index)
+{
+    int taskPipe[2], resultPipe[2];
+    if (pipe (taskPipe) != 0)
+        throw WorkerPoolException (__ORIGIN__, describeSystemError ("pipe"));
+    if (pipe (resultPipe) != 0)
+    {
+        string error = describeSystemError ("pipe");
+        close (taskPipe[0]);
+        close (taskPipe[1]);
+        throw WorkerPoolException (__ORIGIN__, error);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        string error = describeSystemError ("fork");
+        for (int fd: { taskPipe[0], taskPipe[1], resultPipe[0], resultPipe[1] })
+            close (fd);
+        throw WorkerPoolException (__ORIGIN__, error);
+    }
+
+    if (pid == 0)
+    {
+        // Pipes of the other workers must not be kept open here: their ends would never see EOF
+        for (const Worker& worker: workers)
+            if (worker.pid > 0)
+            {
+                close (worker.taskFd);
+                close (worker.resultFd);
+            }
+
+        close (taskPipe[1]);
+        close (resultPipe[0]);
+        runWorker (index, taskPipe[0], resultPipe[1]);
+    }
+
+    close (taskPipe[0]);
+    close (resultPipe[1]);
+
+    Worker& worker = workers[index];
+    worker.pid = pid;
+    worker.taskFd = taskPipe[1];
+    worker.resultFd = resultPipe[0];
+    worker.isBusy = false;
+    worker.taskId = 0;
+}
+
+void sa::WorkerPool::stopWorker (unsigned index, bool kill)
+{
+    Worker& worker = workers[index];
+    if (worker.pid <= 0)
+        return;
+
+    // A worker leaves when its task pipe is closed
+    close (worker.taskFd);
+    if (kill)
+        ::kill (worker.pid, SIGKILL);
+
+    close (worker.resultFd);
+    while (waitpid (worker.pid, nullptr, 0) < 0 && errno == EINTR)
+        ;
+
+    worker.pid = 0;
+}
+
+void sa::WorkerPool::runWorker (unsigned index, int taskFd, int resultFd)
+{
+    int exitCode = 0;
+
+    try
+    {
+        if (startHandler)
+            startHandler (index);
+
+        string task;
+        while (readFrame (taskFd, task, Deadline::max()) == ReadStatus::READ)
+        {
+            string result (1, static_cast <char> (Status::DONE));
+
+            try
+            {
+                result += taskHandler (task);
+            }
+            catch (Exception& e)
+            {
+                result = string (1, static_cast <char> (Status::FAILED)) + e.toString();
+            }
+            catch (std::exception& e)
+            {
+                result = string (1, static_cast <char> (Status::FAILED)) + e.what();
+            }
+
+            if (!writeFrame (resultFd, result))
+                break;
+        }
+    }
+    catch (...)
+    {
+        exitCode = 1;
+    }
+
+    _exit (exitCode);
+}
+
+void sa::WorkerPool::submit (unsigned taskId, const string& task)
+{
+    queuedTasks.push_back (Task { taskId, task });
+}
+
+unsigned sa::WorkerPool::getNumPendingTasks() const
+{
+    return static_cast <unsigned> (queuedTasks.size()) + nRunningTasks;
+}
+
+void sa::WorkerPool::dispatchTasks()
+{
+    for (unsigned i = 0; i < workers.size() && !queuedTasks.empty(); i++)
+    {
+        Worker& worker = workers[i];
+        if (worker.isBusy)
+            continue;
+
+        Task task = queuedTasks.front();
+        queuedTasks.pop_front();
+
+        worker.isBusy = true;
+        worker.taskId = task.id;
+        worker.deadline = chrono::steady_clock::now() + timeout;
+        nRunningTasks++;
+
+        // A failed write means the worker is dead: the result read finds it out
+        writeFrame (worker.taskFd, task.data);
+    }
+}
+
+WorkerPool::Result sa::WorkerPool::finishTask (unsigned index, Status status, string output)
+{
+    Worker& worker = workers[index];
+    saAssert (worker.isBusy);
+
+    Result result = Result { worker.taskId, status, output };
+    worker.isBusy = false;
+    nRunningTasks--;
+
+    if (status == Status::CRASHED || status == Status::TIMED_OUT)
+    {
+        stopWorker (index, true);
+        startWorker (index);
+        nRestarts++;
+    }
+
+    // The worker takes its next task at once: it runs while the caller handles the result
+    dispatchTasks();
+    return result;
+}
+
+WorkerPool::Result sa::WorkerPool::waitForResult()
+{
+    saAssert (getNumPendingTasks() > 0);
+
+    for (;;)
+    {
+        dispatchTasks();
+
+        vector <pollfd> descriptors;
+        vector <unsigned> indices;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now(), nearestDeadline = now + timeout;
+
+        for (unsigned i = 0; i < workers.size(); i++)
+        {
+            if (!workers[i].isBusy)
+                continue;
+
+            if (workers[i].deadline <= now)
+                return finishTask (i, Status::TIMED_OUT, "Timed out");
+
+            nearestDeadline = min (nearestDeadline, workers[i].deadline);
+            descriptors.push_back (pollfd { workers[i].resultFd, POLLIN, 0 });
+            indices.push_back (i);
+        }
+
+        int waitMilliseconds = static_cast <int> (chrono::duration_cast <chrono::milliseconds> (nearestDeadline - now).count());
+        int nReady = poll (descriptors.data(), descriptors.size(), waitMilliseconds + 1);
+        if (nReady < 0 && errno != EINTR)
+            throw WorkerPoolException (__ORIGIN__, describeSystemError ("poll"));
+
+        for (unsigned i = 0; i < descriptors.size(); i++)
+        {
+            if (!descriptors[i].revents)
+                continue;
+
+            string frame;
+            ReadStatus status = readFrame (descriptors[i].fd, frame, workers[indices[i]].deadline);
+            if (status == ReadStatus::TIMED_OUT)
+                return finishTask (indices[i], Status::TIMED_OUT, "Timed out");
+            if (status == ReadStatus::CLOSED || frame.empty())
+                return finishTask (indices[i], Status::CRASHED, "Worker died");
+
+            return finishTask (indices[i], static_cast <Status> (frame[0]), frame.substr (1));
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef STYLE_ANALYZER_WORKER_POOL_H
+#define STYLE_ANALYZER_WORKER_POOL_H
+
+/* Pre-forked worker processes (POSIX only): tasks run isolated from the coordinator & from each other.
+
+   A task is a byte string sent to an idle worker, the handler running in the worker returns the result as a byte string.
+   Messages go over pipes as frames: 4 bytes of length, then the data; a result frame starts with a status byte.
+
+   The coordinator (the process which created the pool) submits tasks & waits for their results:
+   - a worker which dies while running a task (crash, abort, killed) gives CRASHED for the task & is restarted
+   - a task running longer than the timeout gives TIMED_OUT: the worker is killed & restarted
+   - an exception leaving the handler gives FAILED with the exception description, the worker stays alive
+   Retrying or skipping a crashed task is up to the caller.
+   Idle workers take queued tasks in the order submitted; a worker finishing a task takes the next one before its result
+   is returned.
+
+   Workers are forked from the coordinator when the pool is created & when restarted: they see the coordinator memory
+   as it was at that moment. Fork from the thread owning the pool, other threads do not exist in workers.
+   Workers leave with _exit: buffered output inherited from the coordinator is not written twice.
+*/
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "Debug.h"
+
+namespace sa
+{
+
+using std::string;
+using std::vector;
+
+class WorkerPoolException : public Exception
+{
+public :
+    WorkerPoolException (const char* fileOrigin, int lineOrigin, const char* functionOrigin, string operation) :
+        Exception (fileOrigin, lineOrigin, functionOrigin, "Worker pool: " + operation + " failed"),
+        operation (operation)
+    {}
+
+    string toString() const;
+
+private :
+    string operation;
+};
+
+class WorkerPool
+{
+public :
+    // Runs in a worker
+    typedef std::function <string (const string& task)> TaskHandler;
+
+    // Runs in a worker right after the fork, before any task (i. e. to reopen logs)
+    typedef std::function <void (unsigned workerIndex)> WorkerStartHandler;
+
+    enum class Status : uint8_t
+    {
+        DONE,
+        FAILED,
+        CRASHED,
+        TIMED_OUT
+    };
+
+    struct Result
+    {
+        unsigned taskId;
+        Status status;
+        // Handler result or the failure description
+        string output;
+    };
+
+    WorkerPool (unsigned nWorkers, TaskHandler taskHandler, WorkerStartHandler startHandler,
+                std::chrono::milliseconds timeout);
+
+    // Workers finish after their current tasks are done
+    ~WorkerPool();
+
+    void submit (unsigned taskId, const string& task);
+
+    // Submitted tasks without results taken yet
+    unsigned getNumPendingTasks() const;
+
+    // Dispatches submitted tasks to idle workers, returns the first finished one
+    Result waitForResult();
+
+    unsigned getNumRestarts() const
+    {
+        return nRestarts;
+    }
+
+private :
+    WorkerPool (const WorkerPool&) = delete;
+    WorkerPool& operator= (const WorkerPool&) = delete;
+
+    struct Worker
+    {
+        pid_t pid;
+        int taskFd, resultFd;
+
+        bool isBusy;
+        unsigned taskId;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    struct Task
+    {
+        unsigned id;
+        string data;
+    };
+
+    TaskHandler taskHandler;
+    WorkerStartHandler startHandler;
+    std::chrono::milliseconds timeout;
+
+    vector <Worker> workers;
+    std::deque <Task> queuedTasks;
+    unsigned nRunningTasks, nRestarts;
+
+    void startWorker (unsigned index);
+    void stopWorker (unsigned index, bool kill);
+    ATTRIBUTE_NORETURN void runWorker (unsigned index, int taskFd, int resultFd);
+
+    void dispatchTasks();
+    Result finishTask (unsigned index, Status status, string output);
+};
+
+}
+
+#endif // STYLE_ANALYZER_WORKER_POOL_H
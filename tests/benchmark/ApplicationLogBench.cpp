@@ -0,0 +1,31 @@
+#include "Benchmark.h"
+#include "ApplicationLog.h"
+
+using namespace sa;
+using namespace std;
+
+saBenchmark (ApplicationLoggerLog)
+{
+    NullOutputStream stream;
+    LogStreamHolder logHolder (&stream);
+
+    string spelling = "identifier";
+    string kind = "Identifier";
+    int offset = 1234;
+
+    while (state.keepRunning())
+        saLog ("Token: '%1', kind: %2, offset: %3") << spelling << kind << offset;
+
+    doNotOptimize (stream.getNumBytesWritten());
+}
+
+saBenchmark (ApplicationLoggerLogNoArguments)
+{
+    NullOutputStream stream;
+    LogStreamHolder logHolder (&stream);
+
+    while (state.keepRunning())
+        saLog ("Translation unit parsed successfully");
+
+    doNotOptimize (stream.getNumBytesWritten());
+}
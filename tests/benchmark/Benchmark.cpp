@@ -0,0 +1,361 @@
+#include "Benchmark.h"
+#include "ApplicationLog.h"
+#include "Debug.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+
+#include <boost/filesystem.hpp>
+
+using namespace sa;
+using namespace std;
+
+static atomic <uint64_t> allocationsCounter (0), bytesAllocatedCounter (0);
+
+void* operator new (size_t size)
+{
+    allocationsCounter.fetch_add (1, memory_order_relaxed);
+    bytesAllocatedCounter.fetch_add (size, memory_order_relaxed);
+
+    if (void* memory = malloc (size ? size : 1))
+        return memory;
+    throw bad_alloc();
+}
+
+void* operator new[] (size_t size)
+{
+    return operator new (size);
+}
+
+void operator delete (void* memory) noexcept
+{
+    free (memory);
+}
+
+void operator delete[] (void* memory) noexcept
+{
+    free (memory);
+}
+
+uint64_t sa::getTotalAllocations()
+{
+    return allocationsCounter.load (memory_order_relaxed);
+}
+
+uint64_t sa::getTotalBytesAllocated()
+{
+    return bytesAllocatedCounter.load (memory_order_relaxed);
+}
+
+sa::BenchmarkState::BenchmarkState (uint64_t nIterations) :
+    nIterations (nIterations), iteration (0), startAllocations (0), startBytesAllocated (0),
+    elapsedNanoseconds (0), nAllocations (0), nBytesAllocated (0)
+{}
+
+void sa::BenchmarkState::start()
+{
+    startAllocations = getTotalAllocations();
+    startBytesAllocated = getTotalBytesAllocated();
+    startTime = chrono::steady_clock::now();
+}
+
+void sa::BenchmarkState::stop()
+{
+    chrono::steady_clock::time_point stopTime = chrono::steady_clock::now();
+    elapsedNanoseconds += static_cast <double> (chrono::duration_cast <chrono::nanoseconds> (stopTime - startTime).count());
+
+    nAllocations += getTotalAllocations() - startAllocations;
+    nBytesAllocated += getTotalBytesAllocated() - startBytesAllocated;
+}
+
+void sa::BenchmarkState::pauseTiming()
+{
+    stop();
+}
+
+void sa::BenchmarkState::resumeTiming()
+{
+    start();
+}
+
+void sa::BenchmarkRegistry::add (const char* name, BenchmarkFunction function)
+{
+    benchmarks.push_back (Benchmark { name, function });
+}
+
+BenchmarkRegistry& sa::BenchmarkRegistry::instance()
+{
+    static BenchmarkRegistry registry;
+    return registry;
+}
+
+sa::BenchmarkRegistrar::BenchmarkRegistrar (const char* name, BenchmarkFunction function)
+{
+    BenchmarkRegistry::instance().add (name, function);
+}
+
+sa::NullOutputStream::~NullOutputStream()
+{}
+
+void sa::NullOutputStream::write (const char* /*data*/, uint32_t nBytes)
+{
+    nBytesWritten += nBytes;
+}
+
+sa::BenchmarkDirectory::BenchmarkDirectory()
+{
+    boost::filesystem::path directory = boost::filesystem::temp_directory_path() /
+                                        boost::filesystem::unique_path ("style-analyzer-bench-%%%%-%%%%");
+    boost::filesystem::create_directories (directory);
+    path = directory.string();
+}
+
+sa::BenchmarkDirectory::~BenchmarkDirectory()
+{
+    boost::system::error_code ignored;
+    boost::filesystem::remove_all (path, ignored);
+}
+
+string sa::BenchmarkDirectory::getPath (string fileName) const
+{
+    return (boost::filesystem::path (path) / fileName).string();
+}
+
+string sa::BenchmarkDirectory::writeFile (string fileName, const string& contents) const
+{
+    string filePath = getPath (fileName);
+    ofstream file (filePath, ios::binary);
+    file << contents;
+    saVerify (file.good());
+    return filePath;
+}
+
+namespace
+{
+
+struct BenchmarkResult
+{
+    string name;
+    uint64_t nIterations;
+    double nsPerOp, minNsPerOp;
+    double allocationsPerOp, bytesPerOp;
+};
+
+struct RunOptions
+{
+    string filter;
+    unsigned nRepetitions = 5;
+    double minSeconds = 0.1;
+    string jsonFileName;
+};
+
+BenchmarkResult runBenchmark (const BenchmarkRegistry::Benchmark& benchmark, const RunOptions& options)
+{
+    // Calibration: iterations are multiplied until a run is long enough to be measured reliably
+    uint64_t nIterations = 1;
+    for (;;)
+    {
+        BenchmarkState state (nIterations);
+        benchmark.function (state);
+
+        double seconds = state.getElapsedNanoseconds() * 1e-9;
+        if (seconds >= options.minSeconds || nIterations >= (1ull << 40))
+            break;
+
+        double multiplier = seconds > 0 ? options.minSeconds * 1.4 / seconds : 100;
+        multiplier = min (max (multiplier, 2.0), 100.0);
+        nIterations = static_cast <uint64_t> (static_cast <double> (nIterations) * multiplier);
+    }
+
+    vector <double> nsPerOp;
+    uint64_t nAllocations = 0, nBytesAllocated = 0;
+
+    for (unsigned repetition = 0; repetition < options.nRepetitions; repetition++)
+    {
+        BenchmarkState state (nIterations);
+        benchmark.function (state);
+
+        nsPerOp.push_back (state.getElapsedNanoseconds() / static_cast <double> (nIterations));
+        nAllocations += state.getNumAllocations();
+        nBytesAllocated += state.getNumBytesAllocated();
+    }
+
+    sort (nsPerOp.begin(), nsPerOp.end());
+    double nOps = static_cast <double> (nIterations) * options.nRepetitions;
+
+    return BenchmarkResult { benchmark.name, nIterations, nsPerOp[nsPerOp.size() / 2], nsPerOp[0],
+                             static_cast <double> (nAllocations) / nOps, static_cast <double> (nBytesAllocated) / nOps };
+}
+
+string formatResult (const BenchmarkResult& result)
+{
+    char line[512];
+    snprintf (line, sizeof (line), "{\"name\": \"%s\", \"iterations\": %llu, \"nsPerOp\": %.3f, \"minNsPerOp\": %.3f, "
+              "\"allocationsPerOp\": %.3f, \"bytesPerOp\": %.3f}", result.name.c_str(),
+              static_cast <unsigned long long> (result.nIterations), result.nsPerOp, result.minNsPerOp,
+              result.allocationsPerOp, result.bytesPerOp);
+    return line;
+}
+
+// Reads files written by formatResult only
+map <string, BenchmarkResult> readResults (const string& fileName)
+{
+    ifstream file (fileName);
+    if (!file)
+    {
+        cerr << "Failed to open benchmark results '" << fileName << "'" << endl;
+        exit (1);
+    }
+
+    map <string, BenchmarkResult> results;
+    for (string line; getline (file, line);)
+    {
+        char name[256];
+        unsigned long long nIterations = 0;
+        BenchmarkResult result;
+
+        if (sscanf (line.c_str(), "{\"name\": \"%255[^\"]\", \"iterations\": %llu, \"nsPerOp\": %lf, \"minNsPerOp\": %lf, "
+                    "\"allocationsPerOp\": %lf, \"bytesPerOp\": %lf}", name, &nIterations, &result.nsPerOp,
+                    &result.minNsPerOp, &result.allocationsPerOp, &result.bytesPerOp) != 6)
+            continue;
+
+        result.name = name;
+        result.nIterations = nIterations;
+        results[result.name] = result;
+    }
+
+    return results;
+}
+
+int compareResults (const string& baselineFileName, const string& currentFileName, double thresholdPercent)
+{
+    map <string, BenchmarkResult> baseline = readResults (baselineFileName), current = readResults (currentFileName);
+
+    printf ("%-40s %14s %14s %9s %12s %12s\n", "benchmark", "baseline ns", "current ns", "change", "baseline al.",
+            "current al.");
+
+    bool wereRegressions = false;
+    for (auto& entry: current)
+    {
+        auto old = baseline.find (entry.first);
+        if (old == baseline.end())
+        {
+            printf ("%-40s %14s %14.1f\n", entry.first.c_str(), "-", entry.second.nsPerOp);
+            continue;
+        }
+
+        double change = (entry.second.nsPerOp / old->second.nsPerOp - 1) * 100;
+        bool slower = change > thresholdPercent;
+        bool allocatesMore = entry.second.allocationsPerOp > old->second.allocationsPerOp + 1e-3;
+
+        printf ("%-40s %14.1f %14.1f %+8.1f%% %12.2f %12.2f%s\n", entry.first.c_str(), old->second.nsPerOp,
+                entry.second.nsPerOp, change, old->second.allocationsPerOp, entry.second.allocationsPerOp,
+                slower || allocatesMore ? "  REGRESSION" : "");
+
+        wereRegressions = wereRegressions || slower || allocatesMore;
+    }
+
+    return wereRegressions ? 1 : 0;
+}
+
+void printUsage (const char* executable)
+{
+    cerr << "Usage:\n"
+         << "  " << executable << " [--filter <substring>] [--repetitions <n>] [--min-time <seconds>] [--json <file>]\n"
+         << "  " << executable << " --compare <baseline results> <current results> [--threshold <percent>]" << endl;
+}
+
+}
+
+int main (int argc, char** argv)
+{
+    vector <string> arguments (argv + 1, argv + argc);
+    RunOptions options;
+
+    if (!arguments.empty() && arguments[0] == "--compare")
+    {
+        if (arguments.size() != 3 && !(arguments.size() == 5 && arguments[3] == "--threshold"))
+        {
+            printUsage (argv[0]);
+            return 1;
+        }
+
+        return compareResults (arguments[1], arguments[2], arguments.size() == 5 ? atof (arguments[4].c_str()) : 5.0);
+    }
+
+    for (size_t i = 0; i < arguments.size(); i += 2)
+    {
+        if (i + 1 == arguments.size())
+        {
+            printUsage (argv[0]);
+            return 1;
+        }
+
+        const string& value = arguments[i + 1];
+        if (arguments[i] == "--filter")
+            options.filter = value;
+        else if (arguments[i] == "--repetitions")
+            options.nRepetitions = static_cast <unsigned> (max (1, atoi (value.c_str())));
+        else if (arguments[i] == "--min-time")
+            options.minSeconds = atof (value.c_str());
+        else if (arguments[i] == "--json")
+            options.jsonFileName = value;
+        else
+        {
+            printUsage (argv[0]);
+            return 1;
+        }
+    }
+
+    // Benchmarked code logs: entries are formatted only if they are written somewhere
+    ApplicationLogger::instance().setDuplicateToCerr (false);
+
+    vector <BenchmarkResult> results;
+    printf ("%-40s %12s %14s %14s %12s %12s\n", "benchmark", "iterations", "ns/op", "min ns/op", "allocs/op",
+            "bytes/op");
+
+    try
+    {
+        for (const BenchmarkRegistry::Benchmark& benchmark: BenchmarkRegistry::instance().getBenchmarks())
+        {
+            if (string (benchmark.name).find (options.filter) == string::npos)
+                continue;
+
+            BenchmarkResult result = runBenchmark (benchmark, options);
+            printf ("%-40s %12llu %14.1f %14.1f %12.2f %12.1f\n", result.name.c_str(),
+                    static_cast <unsigned long long> (result.nIterations), result.nsPerOp, result.minNsPerOp,
+                    result.allocationsPerOp, result.bytesPerOp);
+            fflush (stdout);
+
+            results.push_back (result);
+        }
+    }
+    catch (Exception& e)
+    {
+        cerr << "sa::Exception caught:\n" << e.toString() << "\nRaised in " << e.originToString() << endl;
+        return 1;
+    }
+
+    if (!options.jsonFileName.empty())
+    {
+        ofstream json (options.jsonFileName);
+        for (const BenchmarkResult& result: results)
+            json << formatResult (result) << "\n";
+
+        if (!json)
+        {
+            cerr << "Failed to write benchmark results '" << options.jsonFileName << "'" << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+#ifndef STYLE_ANALYZER_BENCHMARK_H
+#define STYLE_ANALYZER_BENCHMARK_H
+
+/* Micro-benchmarks of the hot paths.
+
+   A benchmark is a function repeating the measured operation while state.keepRunning() returns true:
+   saBenchmark (Something)
+   {
+       prepareInput();                 // not measured
+       while (state.keepRunning())
+           measuredOperation();
+   }
+
+   Runner internals:
+   - the number of iterations is calibrated until a run takes at least the minimal time,
+     then the run is repeated several times: the median time per operation is reported (the minimum too)
+   - heap allocations are counted by the replaced global operator new of the benchmark executable,
+     only between the first keepRunning() call and the last one (or inside resumed sections)
+   - results are printed as a table and may be written to a file, one JSON object per benchmark per line
+     {"name": "...", "iterations": 1000, "nsPerOp": 12.5, "minNsPerOp": 12.1, "allocationsPerOp": 1, "bytesPerOp": 32}
+   - two result files are compared with --compare: a benchmark slower than the threshold or allocating more
+     is a regression, the exit code is 1 then
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Streams.h"
+
+namespace sa
+{
+
+using std::string;
+using std::vector;
+
+class BenchmarkState
+{
+public :
+    explicit BenchmarkState (uint64_t nIterations);
+
+    // The first call starts measuring, the call after the last iteration stops it
+    bool keepRunning()
+    {
+        if (iteration == 0)
+            start();
+        else if (iteration == nIterations)
+        {
+            stop();
+            return false;
+        }
+
+        iteration++;
+        return true;
+    }
+
+    // Excludes per-iteration setup from time & allocation counts
+    void pauseTiming();
+    void resumeTiming();
+
+    uint64_t getNumIterations() const
+    {
+        return nIterations;
+    }
+
+    double getElapsedNanoseconds() const
+    {
+        return elapsedNanoseconds;
+    }
+
+    uint64_t getNumAllocations() const
+    {
+        return nAllocations;
+    }
+
+    uint64_t getNumBytesAllocated() const
+    {
+        return nBytesAllocated;
+    }
+
+private :
+    uint64_t nIterations, iteration;
+
+    std::chrono::steady_clock::time_point startTime;
+    uint64_t startAllocations, startBytesAllocated;
+
+    double elapsedNanoseconds;
+    uint64_t nAllocations, nBytesAllocated;
+
+    void start();
+    void stop();
+};
+
+typedef void (*BenchmarkFunction) (BenchmarkState& state);
+
+class BenchmarkRegistry
+{
+public :
+    struct Benchmark
+    {
+        const char* name;
+        BenchmarkFunction function;
+    };
+
+    void add (const char* name, BenchmarkFunction function);
+
+    const vector <Benchmark>& getBenchmarks() const
+    {
+        return benchmarks;
+    }
+
+    static BenchmarkRegistry& instance();
+
+private :
+    BenchmarkRegistry() = default;
+
+    vector <Benchmark> benchmarks;
+};
+
+class BenchmarkRegistrar
+{
+public :
+    BenchmarkRegistrar (const char* name, BenchmarkFunction function);
+};
+
+// Counts written bytes only: output is not stored, so long runs do not grow memory
+class NullOutputStream : public IOutputStream
+{
+public :
+    ~NullOutputStream();
+
+    void write (const char* data, uint32_t nBytes);
+
+    uint64_t getNumBytesWritten() const
+    {
+        return nBytesWritten;
+    }
+
+private :
+    uint64_t nBytesWritten = 0;
+};
+
+// Temporary directory removed on destruction
+class BenchmarkDirectory
+{
+public :
+    BenchmarkDirectory();
+    ~BenchmarkDirectory();
+
+    string getPath (string fileName) const;
+    string writeFile (string fileName, const string& contents) const;
+
+private :
+    BenchmarkDirectory (const BenchmarkDirectory&) = delete;
+    BenchmarkDirectory& operator= (const BenchmarkDirectory&) = delete;
+
+    string path;
+};
+
+// Heap allocations made by the process so far (counted by the benchmark executable only)
+uint64_t getTotalAllocations();
+uint64_t getTotalBytesAllocated();
+
+// Keeps the compiler from optimizing a computed value away
+template <class T>
+void doNotOptimize (const T& value)
+{
+    asm volatile ("" : : "g" (&value) : "memory");
+}
+
+#define saBenchmark(name) \
+    static void benchmark##name (sa::BenchmarkState& state); \
+    static sa::BenchmarkRegistrar benchmark##name##Registrar (#name, &benchmark##name); \
+    static void benchmark##name (sa::BenchmarkState& state)
+
+}
+
+#endif // STYLE_ANALYZER_BENCHMARK_H
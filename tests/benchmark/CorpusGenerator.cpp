@@ -0,0 +1,455 @@
+/* Synthetic corpus generator for end-to-end benchmarks (see EndToEndBenchmark.cpp).
+
+   Emits a C++ project of a configurable size:
+   - include/header<k>.h: shared headers, every source file includes a few of them (include fan-out)
+   - src/file<k>.cpp: functions with nested blocks, written in one of the indentation styles,
+     with UTF-8 comments & string literals
+   - project.ini: the tool project listing all source files
+   - corpus.ini: generation parameters & an estimate of the number of tokens of every file
+
+   Generation is deterministic for a given seed.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Debug.h"
+
+using namespace sa;
+using namespace std;
+
+namespace
+{
+
+enum class IndentationStyle
+{
+    ALLMAN,
+    KERNIGHAN_RITCHIE,
+    GNU,
+    TABS
+};
+
+IndentationStyle parseStyle (const string& name)
+{
+    if (name == "allman") return IndentationStyle::ALLMAN;
+    if (name == "kr")     return IndentationStyle::KERNIGHAN_RITCHIE;
+    if (name == "gnu")    return IndentationStyle::GNU;
+    if (name == "tabs")   return IndentationStyle::TABS;
+
+    cerr << "Unknown indentation style '" << name << "' (allman, kr, gnu & tabs are supported)" << endl;
+    exit (1);
+}
+
+struct GeneratorOptions
+{
+    string outputDirectory;
+    unsigned nFiles = 100;
+    unsigned nLinesPerFile = 200;
+    unsigned includeFanOut = 4;
+    unsigned nHeaders = 0;
+    vector <IndentationStyle> styles = { IndentationStyle::ALLMAN };
+    double utf8Ratio = 0.1;
+    unsigned seed = 1;
+};
+
+// Writes blocks & statements in the chosen style
+class CodeWriter
+{
+public :
+    explicit CodeWriter (IndentationStyle style) :
+        style (style), depth (0), nLines (0)
+    {}
+
+    void line (const string& text)
+    {
+        code += text.empty() ? string() : indentation (depth) + text;
+        code += '\n';
+        nLines++;
+    }
+
+    void openBlock (const string& header)
+    {
+        switch (style)
+        {
+            case IndentationStyle::KERNIGHAN_RITCHIE:
+                line (header + " {");
+                break;
+
+            case IndentationStyle::GNU:
+                line (header);
+                if (depth > 0)
+                {
+                    code += indentation (depth) + "  {\n";
+                    nLines++;
+                    gnuBraceDepths.push_back (depth);
+                    depth++;
+                    return;
+                }
+                line ("{");
+                break;
+
+            case IndentationStyle::ALLMAN:
+            case IndentationStyle::TABS:
+                line (header);
+                line ("{");
+                break;
+        }
+
+        depth++;
+    }
+
+    void closeBlock (const string& suffix = "")
+    {
+        depth--;
+        if (style == IndentationStyle::GNU && !gnuBraceDepths.empty() && gnuBraceDepths.back() == depth)
+        {
+            gnuBraceDepths.pop_back();
+            code += indentation (depth) + "  }" + suffix + "\n";
+            nLines++;
+            return;
+        }
+
+        line ("}" + suffix);
+    }
+
+    unsigned getNumLines() const
+    {
+        return nLines;
+    }
+
+    const string& getCode() const
+    {
+        return code;
+    }
+
+private :
+    IndentationStyle style;
+    unsigned depth, nLines;
+    string code;
+
+    // GNU style indents nested braces by a half of the indentation: depths of such blocks
+    vector <unsigned> gnuBraceDepths;
+
+    string indentation (unsigned level) const
+    {
+        switch (style)
+        {
+            case IndentationStyle::GNU:  return string (level * 4, ' ');
+            case IndentationStyle::TABS: return string (level, '\t');
+            case IndentationStyle::ALLMAN:
+            case IndentationStyle::KERNIGHAN_RITCHIE:
+                return string (level * 4, ' ');
+        }
+        saUnreachable ("Unknown indentation style.");
+    }
+};
+
+const char* const utf8Texts[] =
+{
+    "Проверка отступов и имён переменных",
+    "缩进检查与变量命名",
+    "Ünïcödé ïdéntïfïérs äré nöt üsed, only text",
+    "Ελέγχος στυλ κώδικα"
+};
+
+const unsigned nUtf8Texts = static_cast <unsigned> (sizeof (utf8Texts) / sizeof (utf8Texts[0]));
+
+// Rough estimate of the number of clang tokens: comments are skipped, literals are single tokens
+unsigned estimateTokens (const string& code)
+{
+    static const char* const twoCharacterOperators[] =
+        { "==", "!=", "<=", ">=", "+=", "-=", "++", "--", "->", "&&", "||", "::" };
+
+    unsigned nTokens = 0;
+    size_t i = 0;
+    while (i < code.length())
+    {
+        char c = code[i];
+        if (isspace (static_cast <unsigned char> (c)))
+        {
+            i++;
+            continue;
+        }
+
+        if (code.compare (i, 2, "//") == 0)
+        {
+            i = min (code.find ('\n', i), code.length());
+            continue;
+        }
+
+        nTokens++;
+        if (isalnum (static_cast <unsigned char> (c)) || c == '_')
+        {
+            while (i < code.length() && (isalnum (static_cast <unsigned char> (code[i])) || code[i] == '_'))
+                i++;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            for (i++; i < code.length() && code[i] != c; i++)
+                if (code[i] == '\\')
+                    i++;
+            i++;
+        }
+        else
+        {
+            bool isTwoCharacter = false;
+            for (const char* op: twoCharacterOperators)
+                isTwoCharacter = isTwoCharacter || code.compare (i, 2, op) == 0;
+            i += isTwoCharacter ? 2 : 1;
+        }
+    }
+
+    return nTokens;
+}
+
+class CorpusGenerator
+{
+public :
+    explicit CorpusGenerator (const GeneratorOptions& options) :
+        options (options), random (options.seed)
+    {}
+
+    void generate();
+
+private :
+    const GeneratorOptions& options;
+    mt19937 random;
+
+    unsigned uniform (unsigned maximum)
+    {
+        return uniform_int_distribution <unsigned> (0, maximum - 1) (random);
+    }
+
+    bool chance (double probability)
+    {
+        return uniform_real_distribution <double> (0, 1) (random) < probability;
+    }
+
+    string header (unsigned index) const
+    {
+        return "header" + to_string (index);
+    }
+
+    void writeFile (const string& relativePath, const string& contents) const;
+
+    string generateHeader (unsigned index);
+    string generateSource (unsigned index, unsigned& nTokens);
+    void generateFunction (CodeWriter& writer, const string& name, const vector <unsigned>& includedHeaders);
+};
+
+void CorpusGenerator::writeFile (const string& relativePath, const string& contents) const
+{
+    boost::filesystem::path path = boost::filesystem::path (options.outputDirectory) / relativePath;
+    boost::filesystem::create_directories (path.parent_path());
+
+    ofstream file (path.string(), ios::binary);
+    file << contents;
+    if (!file)
+    {
+        cerr << "Failed to write '" << path.string() << "'" << endl;
+        exit (1);
+    }
+}
+
+string CorpusGenerator::generateHeader (unsigned index)
+{
+    string guard = "CORPUS_HEADER_" + to_string (index) + "_H";
+    string name = header (index);
+
+    return "#ifndef " + guard + "\n#define " + guard + "\n\n"
+           "struct " + name + "Data\n{\n    int value;\n    const char* name;\n};\n\n"
+           "int " + name + "Function (int argument);\n"
+           "int " + name + "Combine (const " + name + "Data& data, int argument);\n\n"
+           "#endif // " + guard + "\n";
+}
+
+void CorpusGenerator::generateFunction (CodeWriter& writer, const string& name, const vector <unsigned>& includedHeaders)
+{
+    if (chance (options.utf8Ratio))
+        writer.line (string ("// ") + utf8Texts[uniform (nUtf8Texts)]);
+
+    writer.openBlock ("int " + name + " (int argument, const char* text)");
+    writer.line ("int result = 0;");
+
+    unsigned nLoops = 1 + uniform (3);
+    for (unsigned loop = 0; loop < nLoops; loop++)
+    {
+        string counter = string (1, static_cast <char> ('i' + loop));
+        writer.openBlock ("for (int " + counter + " = 0; " + counter + " < argument; " + counter + "++)");
+
+        string callee = includedHeaders.empty() ? string ("result") :
+                        header (includedHeaders[uniform (static_cast <unsigned> (includedHeaders.size()))]) +
+                        "Function (" + counter + ")";
+
+        writer.openBlock ("if (text[" + counter + "] == ' ')");
+        writer.line ("result += " + callee + ";");
+        writer.closeBlock();
+        writer.openBlock ("else");
+        writer.line ("result -= " + counter + " * " + to_string (uniform (100)) + ";");
+        writer.closeBlock();
+
+        writer.closeBlock();
+    }
+
+    if (chance (options.utf8Ratio))
+        writer.line (string ("const char* message = \"") + utf8Texts[uniform (nUtf8Texts)] +
+                     "\";");
+    else
+        writer.line ("const char* message = \"" + name + "\";");
+
+    writer.line ("return result + message[0];");
+    writer.closeBlock();
+    writer.line ("");
+}
+
+string CorpusGenerator::generateSource (unsigned index, unsigned& nTokens)
+{
+    CodeWriter writer (options.styles[index % options.styles.size()]);
+
+    vector <unsigned> includedHeaders;
+    for (unsigned i = 0; i < min (options.includeFanOut, options.nHeaders); i++)
+    {
+        unsigned headerIndex = uniform (options.nHeaders);
+        if (find (includedHeaders.begin(), includedHeaders.end(), headerIndex) == includedHeaders.end())
+            includedHeaders.push_back (headerIndex);
+    }
+
+    for (unsigned headerIndex: includedHeaders)
+        writer.line ("#include \"../include/" + header (headerIndex) + ".h\"");
+    writer.line ("");
+
+    for (unsigned function = 0; function == 0 || writer.getNumLines() < options.nLinesPerFile; function++)
+        generateFunction (writer, "file" + to_string (index) + "Function" + to_string (function), includedHeaders);
+
+    nTokens = estimateTokens (writer.getCode());
+    return writer.getCode();
+}
+
+void CorpusGenerator::generate()
+{
+    for (unsigned i = 0; i < options.nHeaders; i++)
+        writeFile ("include/" + header (i) + ".h", generateHeader (i));
+
+    string project = "; Synthetic project generated by style-analyzer-corpus-generator\n\n"
+                     "[project]\n"
+                     "Name        = \"Synthetic corpus\"\n"
+                     "Description = \"" + to_string (options.nFiles) + " files, seed " + to_string (options.seed) + "\"\n\n"
+                     "[common]\n"
+                     "NewContext      = \"true\"\n"
+                     "ContextFileName = \"sa-context\"\n\n"
+                     "[dataGrabbing]\n"
+                     "Enabled = \"true\"\n"
+                     "CommonClangOptions[] = \"-std=c++11\"\n";
+
+    string corpus = "; Generated corpus description, read by style-analyzer-e2e-bench\n\n"
+                    "[corpus]\n"
+                    "Files        = \"" + to_string (options.nFiles) + "\"\n"
+                    "LinesPerFile = \"" + to_string (options.nLinesPerFile) + "\"\n"
+                    "IncludeFanOut = \"" + to_string (options.includeFanOut) + "\"\n"
+                    "Seed         = \"" + to_string (options.seed) + "\"\n";
+
+    for (unsigned i = 0; i < options.nFiles; i++)
+    {
+        string fileName = "src/file" + to_string (i) + ".cpp";
+
+        unsigned nTokens = 0;
+        writeFile (fileName, generateSource (i, nTokens));
+
+        project += "Files[] = \"" + fileName + "\"\n";
+        corpus += "SourceFiles[] = \"" + fileName + "\"\n";
+        corpus += "SourceTokens[] = \"" + to_string (nTokens) + "\"\n";
+    }
+
+    writeFile ("project.ini", project);
+    writeFile ("corpus.ini", corpus);
+}
+
+void printUsage (const char* executable)
+{
+    cerr << "Usage: " << executable << " --output <directory> [--files <n>] [--lines <lines per file>]\n"
+         << "       [--include-fanout <n>] [--headers <n>] [--styles <allman,kr,gnu,tabs>] [--utf8-ratio <0..1>]\n"
+         << "       [--seed <n>]" << endl;
+}
+
+}
+
+int main (int argc, char** argv)
+{
+    GeneratorOptions options;
+    vector <string> arguments (argv + 1, argv + argc);
+
+    for (size_t i = 0; i < arguments.size(); i += 2)
+    {
+        if (i + 1 == arguments.size())
+        {
+            printUsage (argv[0]);
+            return 1;
+        }
+
+        const string& value = arguments[i + 1];
+        unsigned number = static_cast <unsigned> (strtoul (value.c_str(), nullptr, 10));
+
+        if (arguments[i] == "--output")
+            options.outputDirectory = value;
+        else if (arguments[i] == "--files")
+            options.nFiles = number;
+        else if (arguments[i] == "--lines")
+            options.nLinesPerFile = number;
+        else if (arguments[i] == "--include-fanout")
+            options.includeFanOut = number;
+        else if (arguments[i] == "--headers")
+            options.nHeaders = number;
+        else if (arguments[i] == "--utf8-ratio")
+            options.utf8Ratio = atof (value.c_str());
+        else if (arguments[i] == "--seed")
+            options.seed = number;
+        else if (arguments[i] == "--styles")
+        {
+            options.styles.clear();
+            for (size_t begin = 0; begin <= value.length();)
+            {
+                size_t end = min (value.find (',', begin), value.length());
+                options.styles.push_back (parseStyle (value.substr (begin, end - begin)));
+                begin = end + 1;
+            }
+        }
+        else
+        {
+            printUsage (argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.outputDirectory.empty() || options.nFiles == 0)
+    {
+        printUsage (argv[0]);
+        return 1;
+    }
+
+    // A header per ten files by default: headers are shared, as in real projects
+    if (!options.nHeaders)
+        options.nHeaders = max (1u, options.nFiles / 10);
+
+    try
+    {
+        CorpusGenerator (options).generate();
+    }
+    catch (boost::filesystem::filesystem_error& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Generated " << options.nFiles << " files & " << options.nHeaders << " headers in '"
+         << options.outputDirectory << "'" << endl;
+    return 0;
+}
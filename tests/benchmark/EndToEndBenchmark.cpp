@@ -0,0 +1,249 @@
+/* End-to-end benchmark driver: runs the tool over a generated corpus (see CorpusGenerator.cpp).
+
+   For every input size (the first N files of the corpus) and every job count, a single tool process grabs the files
+   in its own directory (run-<jobs>), which holds a run project including the corpus project. Jobs are grabbing
+   workers of the tool (see DataGrabbing.h), a single job grabs in the tool process:
+   #include "../project.ini"
+   [dataGrabbing]
+   Files = "../src/file0.cpp"
+   Files[] = "../src/file1.cpp"
+   Workers = "4"
+
+   Reported per run: wall time, files & tokens (estimated by the generator) per second, peak RSS of the largest
+   process (the tool or a worker), size of the produced context, whether the tool failed.
+   Results are printed as a table and may be written to a file, one JSON object per run per line.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include "IniConfiguration.h"
+#include "Debug.h"
+
+using namespace std;
+
+namespace
+{
+
+struct DriverOptions
+{
+    string corpusDirectory;
+    string toolPath;
+    vector <unsigned> jobCounts = { 1 };
+    vector <unsigned> fileCounts;
+    string jsonFileName;
+};
+
+struct RunResult
+{
+    unsigned nFiles, nJobs;
+    double seconds;
+    unsigned long long nTokens;
+    long maxPeakRssKb;
+    unsigned long long contextBytes;
+    unsigned nFailures;
+};
+
+vector <unsigned> parseList (const string& value)
+{
+    vector <unsigned> list;
+    for (size_t begin = 0; begin <= value.length();)
+    {
+        size_t end = min (value.find (',', begin), value.length());
+        list.push_back (static_cast <unsigned> (strtoul (value.substr (begin, end - begin).c_str(), nullptr, 10)));
+        begin = end + 1;
+    }
+    return list;
+}
+
+// Starts the tool in the run directory, output goes to tool-output
+pid_t startTool (const string& toolPath, const string& runDirectory)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    if (chdir (runDirectory.c_str()) != 0)
+        _exit (127);
+
+    int output = open ("tool-output", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output < 0 || dup2 (output, STDOUT_FILENO) < 0 || dup2 (output, STDERR_FILENO) < 0)
+        _exit (127);
+
+    const char* arguments[] = { toolPath.c_str(), "project.ini", nullptr };
+    execv (toolPath.c_str(), const_cast <char* const*> (arguments));
+    _exit (127);
+}
+
+RunResult runTool (const DriverOptions& options, const vector <string>& files, const vector <unsigned>& tokens,
+                   unsigned nFiles, unsigned nJobs)
+{
+    RunResult result = RunResult { nFiles, nJobs, 0, 0, 0, 0, 0 };
+    for (unsigned i = 0; i < nFiles; i++)
+        result.nTokens += tokens[i];
+
+    boost::filesystem::path directory = boost::filesystem::path (options.corpusDirectory) / ("run-" + to_string (nJobs));
+    boost::filesystem::remove_all (directory);
+    boost::filesystem::create_directories (directory);
+
+    {
+        ofstream project ((directory / "project.ini").string());
+        project << "#include \"../project.ini\"\n\n[dataGrabbing]\n";
+        for (unsigned i = 0; i < nFiles; i++)
+            project << "Files" << (i == 0 ? "" : "[]") << " = \"../" << files[i] << "\"\n";
+        if (nJobs > 1)
+            project << "Workers = \"" << nJobs << "\"\n";
+    }
+
+    string toolPath = boost::filesystem::absolute (options.toolPath).string();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    pid_t process = startTool (toolPath, boost::filesystem::absolute (directory).string());
+
+    // Usage of waited children is included: the peak is the one of the largest process, the tool or a worker
+    int status = 0;
+    struct rusage usage = rusage();
+    if (wait4 (process, &status, 0, &usage) < 0 || !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        result.nFailures++;
+
+    result.seconds = chrono::duration <double> (chrono::steady_clock::now() - start).count();
+    result.maxPeakRssKb = usage.ru_maxrss;
+
+    boost::filesystem::path context = directory / "sa-context";
+    if (boost::filesystem::exists (context))
+        result.contextBytes = boost::filesystem::file_size (context);
+
+    return result;
+}
+
+string formatResult (const RunResult& result)
+{
+    char line[512];
+    snprintf (line, sizeof (line), "{\"files\": %u, \"jobs\": %u, \"seconds\": %.3f, \"filesPerSecond\": %.2f, "
+              "\"tokensPerSecond\": %.0f, \"maxPeakRssKb\": %ld, \"contextBytes\": %llu, \"failures\": %u}",
+              result.nFiles, result.nJobs, result.seconds, result.nFiles / result.seconds,
+              static_cast <double> (result.nTokens) / result.seconds, result.maxPeakRssKb, result.contextBytes,
+              result.nFailures);
+    return line;
+}
+
+void printUsage (const char* executable)
+{
+    cerr << "Usage: " << executable << " --corpus <directory> --tool <style-analyzer-tool>\n"
+         << "       [--jobs <n,n,...>] [--files <n,n,...>] [--json <file>]" << endl;
+}
+
+}
+
+int main (int argc, char** argv)
+{
+    DriverOptions options;
+    vector <string> arguments (argv + 1, argv + argc);
+
+    for (size_t i = 0; i < arguments.size(); i += 2)
+    {
+        if (i + 1 == arguments.size())
+        {
+            printUsage (argv[0]);
+            return 1;
+        }
+
+        const string& value = arguments[i + 1];
+        if (arguments[i] == "--corpus")
+            options.corpusDirectory = value;
+        else if (arguments[i] == "--tool")
+            options.toolPath = value;
+        else if (arguments[i] == "--jobs")
+            options.jobCounts = parseList (value);
+        else if (arguments[i] == "--files")
+            options.fileCounts = parseList (value);
+        else if (arguments[i] == "--json")
+            options.jsonFileName = value;
+        else
+        {
+            printUsage (argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.corpusDirectory.empty() || options.toolPath.empty())
+    {
+        printUsage (argv[0]);
+        return 1;
+    }
+
+    vector <RunResult> results;
+
+    try
+    {
+        string corpusFileName = (boost::filesystem::path (options.corpusDirectory) / "corpus.ini").string();
+        sa::IniIncludeManager includeManager;
+        unique_ptr <sa::IInputStream> corpusStream = includeManager.openInputStream (corpusFileName,
+                                                                                     sa::RelativeInputStreamFlags::NONE);
+        unique_ptr <sa::IniConfiguration> corpus = sa::IniConfiguration::load (corpusFileName, corpusStream.get(),
+                                                                              &includeManager);
+
+        const vector <string>& files = (*corpus)["corpus.sourcefiles"].asVector();
+        vector <unsigned> tokens;
+        for (const string& count: (*corpus)["corpus.sourcetokens"].asVector())
+            tokens.push_back (static_cast <unsigned> (strtoul (count.c_str(), nullptr, 10)));
+        saVerify (tokens.size() == files.size());
+
+        if (options.fileCounts.empty())
+            options.fileCounts.push_back (static_cast <unsigned> (files.size()));
+
+        printf ("%8s %5s %10s %10s %12s %12s %14s %8s\n", "files", "jobs", "seconds", "files/s", "tokens/s",
+                "max RSS KiB", "context bytes", "failed");
+
+        for (unsigned nFiles: options.fileCounts)
+        {
+            nFiles = min (nFiles, static_cast <unsigned> (files.size()));
+            for (unsigned nJobs: options.jobCounts)
+            {
+                RunResult result = runTool (options, files, tokens, nFiles, max (nJobs, 1u));
+                printf ("%8u %5u %10.3f %10.2f %12.0f %12ld %14llu %8u\n", result.nFiles, result.nJobs,
+                        result.seconds, result.nFiles / result.seconds, static_cast <double> (result.nTokens) / result.seconds,
+                        result.maxPeakRssKb, result.contextBytes, result.nFailures);
+                fflush (stdout);
+
+                results.push_back (result);
+            }
+        }
+    }
+    catch (sa::Exception& e)
+    {
+        cerr << "sa::Exception caught:\n" << e.toString() << endl;
+        return 1;
+    }
+    catch (boost::filesystem::filesystem_error& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    if (!options.jsonFileName.empty())
+    {
+        ofstream json (options.jsonFileName);
+        for (const RunResult& result: results)
+            json << formatResult (result) << "\n";
+    }
+
+    bool wereFailures = false;
+    for (const RunResult& result: results)
+        wereFailures = wereFailures || result.nFailures > 0;
+
+    return wereFailures ? 1 : 0;
+}
@@ -0,0 +1,53 @@
+#include "Benchmark.h"
+#include "StringFormatter.h"
+
+using namespace sa;
+using namespace std;
+
+saBenchmark (FormatToString)
+{
+    string spelling = "identifier";
+    unsigned offset = 1234;
+
+    while (state.keepRunning())
+    {
+        string message = saFormatPure ("Token: '%1', offset: %2") << spelling << offset;
+        doNotOptimize (message);
+    }
+}
+
+saBenchmark (FormatIntoThreadBuffer)
+{
+    string spelling = "identifier";
+    unsigned offset = 1234;
+
+    while (state.keepRunning())
+    {
+        FormatBuffer* buffer = FormatBuffer::acquireThreadBuffer();
+        (saFormatPure ("Token: '%1', offset: %2") << spelling << offset).getMessage().format (*buffer);
+        doNotOptimize (buffer->getContents());
+        FormatBuffer::releaseThreadBuffer (buffer);
+    }
+}
+
+saBenchmark (FormatTranslated)
+{
+    string file = "src/Main.cpp";
+
+    while (state.keepRunning())
+    {
+        string message = saFormat ("Grabbing data from file '%1'...") << file;
+        doNotOptimize (message);
+    }
+}
+
+saBenchmark (FormatVectorArgument)
+{
+    vector <string> files = { "first.cpp", "second.cpp", "third.cpp", "fourth.cpp" };
+
+    while (state.keepRunning())
+    {
+        string message = saFormatPure ("Grabbing from files: %1") << files;
+        doNotOptimize (message);
+    }
+}
@@ -0,0 +1,50 @@
+#include "Benchmark.h"
+#include "FileContext.h"
+#include "LibclangHelpers.h"
+
+using namespace sa;
+using namespace std;
+
+namespace
+{
+
+// Functions with nested blocks & mixed indentation, so intervals of all kinds are computed
+string generateSource (unsigned nFunctions)
+{
+    string source = "#define MAXIMUM(a, b) ((a) > (b) ? (a) : (b))\n\n";
+    for (unsigned i = 0; i < nFunctions; i++)
+    {
+        string name = "function" + toString (i);
+        source += "int " + name + " (int argument, const char* text)\n"
+                  "{\n"
+                  "    int result = 0;\n"
+                  "    for (int j = 0; j < argument; j++)\n"
+                  "    {\n"
+                  "        if (text[j] == ' ')\n"
+                  "          result += MAXIMUM (j, " + toString (i) + ");\n"
+                  "        else\n"
+                  "            result--;\n"
+                  "    }\n"
+                  "    return result;\n"
+                  "}\n\n";
+    }
+    return source;
+}
+
+}
+
+saBenchmark (IndentationContextCreate)
+{
+    BenchmarkDirectory directory;
+    string fileName = directory.writeFile ("source.cpp", generateSource (50));
+
+    ClangIndex index (false, false);
+    ClangTranslationUnit unit = index.parseTranslationUnit (fileName, vector <string>());
+    saVerify (unit);
+
+    unique_ptr <FileContext> fileContext = FileContext::create (unit);
+    CXFile file = clang_getFile (unit, fileName.c_str());
+
+    while (state.keepRunning())
+        doNotOptimize (IndentationContext::create (*fileContext, unit, file));
+}
@@ -0,0 +1,64 @@
+#include "Benchmark.h"
+#include "IniConfiguration.h"
+
+using namespace sa;
+using namespace std;
+
+namespace
+{
+
+// A project file of a realistic size: sections with scalar & list properties
+string generateIniFile (unsigned nSections, unsigned nKeysPerSection)
+{
+    string contents = "; Generated benchmark configuration\n";
+    for (unsigned section = 0; section < nSections; section++)
+    {
+        contents += "[section" + toString (section) + "]\n";
+        for (unsigned key = 0; key < nKeysPerSection; key++)
+        {
+            if (key % 4 == 3)
+                contents += "list" + toString (key) + "[] = \"first value\"\nlist" + toString (key) + "[] = \"second\"\n";
+            else
+                contents += "Key" + toString (key) + " = \"value of key " + toString (key) + "\" // comment\n";
+        }
+    }
+    return contents;
+}
+
+}
+
+saBenchmark (IniConfigurationLoad)
+{
+    string contents = generateIniFile (20, 16);
+
+    while (state.keepRunning())
+    {
+        IniIncludeManager includeManager;
+        unique_ptr <IInputStream> stream = includeManager.openInputStream ("<benchmark>", contents);
+        unique_ptr <IniConfiguration> configuration = IniConfiguration::load ("<benchmark>", stream.get(),
+                                                                               &includeManager);
+        doNotOptimize (configuration);
+    }
+}
+
+saBenchmark (IniConfigurationLookupByString)
+{
+    IniIncludeManager includeManager;
+    unique_ptr <IInputStream> stream = includeManager.openInputStream ("<benchmark>", generateIniFile (20, 16));
+    unique_ptr <IniConfiguration> configuration = IniConfiguration::load ("<benchmark>", stream.get(), &includeManager);
+
+    string key = "section10.key5";
+    while (state.keepRunning())
+        doNotOptimize ((*configuration)[key].asVector());
+}
+
+saBenchmark (IniConfigurationLookupByHandle)
+{
+    IniIncludeManager includeManager;
+    unique_ptr <IInputStream> stream = includeManager.openInputStream ("<benchmark>", generateIniFile (20, 16));
+    unique_ptr <IniConfiguration> configuration = IniConfiguration::load ("<benchmark>", stream.get(), &includeManager);
+
+    IniPropertyHandle handle = configuration->getHandle (saIniKey ("section10.key5"));
+    while (state.keepRunning())
+        doNotOptimize ((*configuration)[handle].asVector());
+}
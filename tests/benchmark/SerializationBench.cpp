@@ -0,0 +1,49 @@
+#include "Benchmark.h"
+#include "FileContext.h"
+#include "FileStreams.h"
+
+using namespace sa;
+using namespace std;
+
+saBenchmark (SerializeString)
+{
+    NullOutputStream stream;
+    string s (64, 'x');
+
+    while (state.keepRunning())
+        serializeString (&stream, s);
+
+    doNotOptimize (stream.getNumBytesWritten());
+}
+
+saBenchmark (DeserializeString)
+{
+    // Strings are read from a buffer of a fixed size, reopened when exhausted
+    const unsigned nStringsPerBuffer = 1024;
+
+    string buffer;
+    string s (64, 'x');
+    for (unsigned i = 0; i < nStringsPerBuffer; i++)
+    {
+        uint32_t length = static_cast <uint32_t> (s.length());
+        buffer.append (reinterpret_cast <const char*> (&length), sizeof (length));
+        buffer += s;
+    }
+
+    unique_ptr <UniversalInputStream> stream;
+    unsigned nStringsLeft = 0;
+
+    while (state.keepRunning())
+    {
+        if (!nStringsLeft)
+        {
+            state.pauseTiming();
+            stream = UniversalInputStream::openInputStream ("<benchmark>", buffer);
+            nStringsLeft = nStringsPerBuffer;
+            state.resumeTiming();
+        }
+
+        doNotOptimize (deserializeString (stream.get()));
+        nStringsLeft--;
+    }
+}
@@ -0,0 +1,44 @@
+#include "Benchmark.h"
+#include "FileStreams.h"
+
+using namespace sa;
+using namespace std;
+
+static const uint32_t benchmarkFileSize = 64 * 1024;
+static const uint32_t benchmarkChunkSize = 4 * 1024;
+
+static void readAll (IInputStream* stream)
+{
+    char chunk[benchmarkChunkSize];
+    while (stream->read (chunk, benchmarkChunkSize) == benchmarkChunkSize)
+        doNotOptimize (chunk);
+}
+
+// Operation: reading a 64 KiB buffer in 4 KiB chunks
+saBenchmark (UniversalInputStreamBufferRead)
+{
+    string contents (benchmarkFileSize, 'x');
+
+    while (state.keepRunning())
+    {
+        state.pauseTiming();
+        unique_ptr <UniversalInputStream> stream = UniversalInputStream::openInputStream ("<benchmark>", contents);
+        state.resumeTiming();
+
+        readAll (stream.get());
+    }
+}
+
+// Operation: opening a 64 KiB file & reading it in 4 KiB chunks
+saBenchmark (UniversalInputStreamFileRead)
+{
+    BenchmarkDirectory directory;
+    string fileName = directory.writeFile ("input.bin", string (benchmarkFileSize, 'x'));
+
+    while (state.keepRunning())
+    {
+        unique_ptr <UniversalInputStream> stream = UniversalInputStream::openInputStream (fileName,
+                                                                                           RelativeInputStreamFlags::BINARY);
+        readAll (stream.get());
+    }
+}
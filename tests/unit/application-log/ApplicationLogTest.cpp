@@ -0,0 +1,40 @@
+#include "Common.h"
+#include "ApplicationLog.h"
+#include "FileStreams.h"
+#include "Debug.h"
+
+using namespace sa;
+
+BOOST_AUTO_TEST_CASE (ApplicationLogDeferredFormatting)
+{
+	MemoryOutputStream logStream;
+	ApplicationLogger::instance().openLog (&logStream);
+
+	vector <string> files = { "a.cpp", "b.cpp" };
+	for (int i = 0; i < 3; i++)
+		saLog ("Entry %1 of %2: %3") << i << 3u << files;
+
+	saError ("Runtime %1, %2 & %3") << string ("string") << -2.5 << true;
+	saLog (string ("Non-literal %1%%")) << 100;
+
+	ApplicationLogger::instance().closeLog();
+
+	// Repeated strings are written once
+	BOOST_CHECK_EQUAL (logStream.getContents().find ("Entry"), logStream.getContents().rfind ("Entry"));
+
+	unique_ptr <UniversalInputStream> input = UniversalInputStream::openInputStream ("application-log", logStream.getContents());
+	unique_ptr <ApplicationLog> log = ApplicationLog::load (input.get());
+
+	BOOST_REQUIRE_EQUAL (log->getNumEntries(), 5u);
+	BOOST_CHECK_EQUAL (log->getEntryMessage (0), "Entry 0 of 3: { \"a.cpp\", \"b.cpp\" }");
+	BOOST_CHECK_EQUAL (log->getEntryMessage (2), "Entry 2 of 3: { \"a.cpp\", \"b.cpp\" }");
+	BOOST_CHECK_EQUAL (log->getEntryMessage (3), "Runtime string, -2.5 & true");
+	BOOST_CHECK_EQUAL (log->getEntryMessage (4), "Non-literal 100%");
+
+	BOOST_CHECK (!log->isErrorEntry (0));
+	BOOST_CHECK (log->isErrorEntry (3));
+	BOOST_CHECK_EQUAL (log->getEntryFileOrigin (0), __FILE__);
+
+	unique_ptr <UniversalInputStream> garbage = UniversalInputStream::openInputStream ("garbage", "not a log");
+	BOOST_CHECK_THROW (ApplicationLog::load (garbage.get()), InvalidArgumentException);
+}
@@ -0,0 +1,67 @@
+#include "Common.h"
+#include "Arena.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace sa;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE (ArenaAllocation)
+{
+	Arena arena (256);
+
+	char* first = static_cast <char*> (arena.allocate (3, 1));
+	void* aligned = arena.allocate (8, 8);
+	BOOST_CHECK_EQUAL (reinterpret_cast <uintptr_t> (aligned) % 8, 0u);
+	BOOST_CHECK_EQUAL (static_cast <char*> (aligned) - first, 8);
+	BOOST_CHECK_EQUAL (arena.getNumBytesUsed(), 11u);
+	BOOST_CHECK_EQUAL (arena.getNumBytesReserved(), 256u);
+
+	// Larger than a block: a block of its own
+	arena.allocate (1000, 1);
+	BOOST_CHECK_EQUAL (arena.getNumBytesReserved(), 1256u);
+
+	// Blocks are kept: the first allocation after a reset is where the first one was
+	arena.reset();
+	BOOST_CHECK_EQUAL (arena.getNumBytesUsed(), 0u);
+	BOOST_CHECK (arena.allocate (3, 1) == first);
+	BOOST_CHECK_EQUAL (arena.getNumBytesReserved(), 1256u);
+}
+
+BOOST_AUTO_TEST_CASE (ArenaBlocksKept)
+{
+	Arena arena (256, 512);
+	char* first = static_cast <char*> (arena.allocate (200, 1));
+	arena.allocate (200, 1);
+	arena.allocate (200, 1);
+	BOOST_CHECK_EQUAL (arena.getNumBytesReserved(), 768u);
+
+	// Blocks beyond the bytes kept are freed, the first ones stay
+	arena.reset();
+	BOOST_CHECK_EQUAL (arena.getNumBytesReserved(), 512u);
+	BOOST_CHECK (arena.allocate (200, 1) == first);
+
+	// So is a huge block
+	arena.allocate (200, 1);
+	arena.allocate (4096, 1);
+	arena.reset();
+	BOOST_CHECK_EQUAL (arena.getNumBytesReserved(), 512u);
+}
+
+BOOST_AUTO_TEST_CASE (ArenaContainers)
+{
+	Arena arena;
+	vector <int, ArenaAllocator <int>> values ((ArenaAllocator <int> (&arena)));
+	values.reserve (100);
+	for (int i = 0; i < 100; i++)
+		values.push_back (i);
+
+	BOOST_CHECK_EQUAL (values[99], 99);
+	BOOST_CHECK_EQUAL (arena.getNumBytesUsed(), 100 * sizeof (int));
+
+	// Without an arena, the heap
+	vector <int, ArenaAllocator <int>> heapValues (3, 7);
+	BOOST_CHECK (heapValues.get_allocator().getArena() == nullptr);
+	BOOST_CHECK_EQUAL (heapValues[2], 7);
+}
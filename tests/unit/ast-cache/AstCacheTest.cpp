@@ -0,0 +1,64 @@
+#include "Common.h"
+#include "AstCache.h"
+#include <boost/filesystem.hpp>
+
+#include <cstdio>
+
+using namespace sa;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE (AstCacheEntries)
+{
+	boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	boost::filesystem::create_directory (directory);
+
+	auto write = [] (const string& fileName, const char* contents)
+	{
+		FILE* file = fopen (fileName.c_str(), "w");
+		BOOST_REQUIRE (file);
+		fputs (contents, file);
+		fclose (file);
+	};
+
+	// The source is never written to disk: the unit keeps it
+	string header = (directory / "value.h").string(), source = (directory / "source.cpp").string();
+	string contents = "#include \"value.h\"\nint value() { return VALUE; }\n";
+	write (header, "#define VALUE 1\n");
+
+	vector <string> options = { "-x", "c++" };
+	AstCache cache (directory.string(), options);
+	ClangIndex index (false, false);
+
+	BOOST_CHECK (cache.load (index, source, contents) == nullptr);
+
+	{
+		vector <CXUnsavedFile> unsavedFiles = { CXUnsavedFile { source.c_str(), contents.data(), contents.length() } };
+		ClangTranslationUnit unit = index.parseTranslationUnit (source, options, CXTranslationUnit_None, unsavedFiles);
+		BOOST_REQUIRE (unit != nullptr);
+		cache.save (unit, source, contents);
+	}
+
+	// Files written aside are renamed
+	for (boost::filesystem::directory_iterator entry (directory); entry != boost::filesystem::directory_iterator(); entry++)
+		BOOST_CHECK_NE (entry->path().extension().string(), ".tmp");
+
+	{
+		ClangTranslationUnit unit = cache.load (index, source, contents);
+		BOOST_REQUIRE (unit != nullptr);
+
+		CXFile file = clang_getFile (unit, source.c_str());
+		BOOST_REQUIRE (file);
+		unsigned long size = 0;
+		const char* fileContents = clang_getFileContents (unit, file, &size);
+		BOOST_CHECK_EQUAL (string (fileContents, size), contents);
+	}
+
+	// Other text, options or headers are other entries
+	BOOST_CHECK (cache.load (index, source, contents + "\n") == nullptr);
+	BOOST_CHECK (AstCache (directory.string(), vector <string> { "-x", "c++", "-DX" }).load (index, source, contents) == nullptr);
+
+	write (header, "#define VALUE 2\n");
+	BOOST_CHECK (cache.load (index, source, contents) == nullptr);
+
+	boost::filesystem::remove_all (directory);
+}
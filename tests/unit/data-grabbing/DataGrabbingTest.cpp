@@ -0,0 +1,55 @@
+#include "Common.h"
+#include "DataGrabbing.h"
+#include "FileContext.h"
+#include "FileStreams.h"
+#include "Metrics.h"
+#include <boost/filesystem.hpp>
+
+using namespace sa;
+using namespace std;
+
+// The in-memory source is grabbed as given: its name is not a file, reading it would fail the file
+static void checkInMemorySourceGrabbed (const string& workersProperty)
+{
+	boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	boost::filesystem::create_directory (directory);
+	boost::filesystem::path previousDirectory = boost::filesystem::current_path();
+	// Workers log into the working directory
+	boost::filesystem::current_path (directory);
+
+	string contextFile = (directory / "context").string(), source = (directory / "stdin.cpp").string();
+	string projectText = "[common]\nContextFileName = \"" + contextFile + "\"\n"
+	                     "[dataGrabbing]\nCommonClangOptions[] = \"-x\"\nCommonClangOptions[] = \"c++\"\n" +
+	                     workersProperty;
+
+	IniIncludeManager includeManager;
+	unique_ptr <IInputStream> projectFile = includeManager.openInputStream ("<memory buffer>", projectText);
+	unique_ptr <IniConfiguration> project = IniConfiguration::load ("<memory buffer>", projectFile.get(), &includeManager);
+
+	string contents = "int square (int x)\n{\n    return x * x;\n}\n";
+	uint64_t nFilesProcessedBefore = metrics::filesProcessed.get(), nFilesFailedBefore = metrics::filesFailed.get();
+	grabProjectData (*project, source, contents);
+
+	BOOST_CHECK_EQUAL (metrics::filesProcessed.get() - nFilesProcessedBefore, 1u);
+	BOOST_CHECK_EQUAL (metrics::filesFailed.get() - nFilesFailedBefore, 0u);
+	BOOST_CHECK (!boost::filesystem::exists (source));
+
+	// A context starts with the file name & contents
+	unique_ptr <UniversalInputStream> contextStream = UniversalInputStream::openInputStream (contextFile,
+	                                                                                         RelativeInputStreamFlags::BINARY);
+	BOOST_CHECK_EQUAL (deserializeString (contextStream.get()), source);
+	BOOST_CHECK_EQUAL (deserializeString (contextStream.get()), contents);
+
+	boost::filesystem::current_path (previousDirectory);
+	boost::filesystem::remove_all (directory);
+}
+
+BOOST_AUTO_TEST_CASE (DataGrabbingInMemorySource)
+{
+	checkInMemorySourceGrabbed ("");
+}
+
+BOOST_AUTO_TEST_CASE (DataGrabbingInMemorySourceInWorker)
+{
+	checkInMemorySourceGrabbed ("Workers = \"1\"\n");
+}
@@ -0,0 +1,42 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Common.h"
+#include "HeaderRegistry.h"
+
+using namespace sa;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE (HeaderRegistryClaims)
+{
+	HeaderRegistry registry (4);
+
+	BOOST_CHECK (registry.claim ("/project/a.h", "int a;"));
+	BOOST_CHECK (!registry.claim ("/project/a.h", "int a;"));
+
+	// Another version of the header is another header
+	BOOST_CHECK (registry.claim ("/project/a.h", "int a, b;"));
+	BOOST_CHECK (registry.claim ("/project/b.h", "int a;"));
+
+	// A full table does not deduplicate
+	BOOST_CHECK (registry.claim ("/project/c.h", ""));
+	BOOST_CHECK (registry.claim ("/project/d.h", ""));
+	BOOST_CHECK (registry.claim ("/project/d.h", ""));
+}
+
+BOOST_AUTO_TEST_CASE (HeaderRegistrySharedWithChildren)
+{
+	HeaderRegistry registry;
+
+	pid_t child = fork();
+	BOOST_REQUIRE (child >= 0);
+	if (child == 0)
+		_exit (registry.claim ("/project/a.h", "int a;") ? 0 : 1);
+
+	int status = 0;
+	BOOST_REQUIRE (waitpid (child, &status, 0) == child);
+	BOOST_CHECK (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+
+	// Claimed by the child
+	BOOST_CHECK (!registry.claim ("/project/a.h", "int a;"));
+}
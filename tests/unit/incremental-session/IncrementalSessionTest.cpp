@@ -0,0 +1,110 @@
+#include <random>
+#include <sstream>
+
+#include "Common.h"
+#include "ApplicationLog.h"
+#include "FileStreams.h"
+#include "IncrementalSession.h"
+
+using namespace sa;
+using namespace std;
+
+static const char* sessionFileName = "incremental-session-test.cpp";
+
+static string makeSource (unsigned nFunctions)
+{
+	ostringstream source;
+	for (unsigned i = 0; i < nFunctions; i++)
+		source << "int f" << i << " (int x)\n{\n    if (x > " << i << ")\n        return x * 2; /* c */\n    return x + 1;\n}\n";
+	return source.str();
+}
+
+// The context updated by the session must be the one created from scratch for the same contents
+static void checkSameAsCreated (IncrementalSession& session, const string& edit)
+{
+	const string& contents = session.getFileContext().getFileContents();
+	ClangIndex index (false, false);
+	vector <CXUnsavedFile> unsavedFiles = { CXUnsavedFile { sessionFileName, contents.data(), contents.length() } };
+	ClangTranslationUnit unit = index.parseTranslationUnit (sessionFileName, {}, CXTranslationUnit_None, unsavedFiles);
+	BOOST_REQUIRE (static_cast <CXTranslationUnit> (unit) != nullptr);
+	unique_ptr <FileContext> created = FileContext::create (unit, contents);
+
+	const IndentationContext& updated = *session.getFileContext().getIndentationContext();
+	const IndentationContext& expected = *created->getIndentationContext();
+	BOOST_REQUIRE_MESSAGE (updated.getNumTokens() == expected.getNumTokens(), "token count after " << edit);
+
+	for (uint32_t i = 0; i < expected.getNumTokens(); i++)
+	{
+		TokenInterval updatedInterval = updated.getIntervalBefore (i), expectedInterval = expected.getIntervalBefore (i);
+		BOOST_REQUIRE_MESSAGE (updated.getTokenOffset (i) == expected.getTokenOffset (i) &&
+		                       updated.getTokenValue (i) == expected.getTokenValue (i) &&
+		                       updated.getTokenClassName (i) == expected.getTokenClassName (i) &&
+		                       updatedInterval.isAfterNewline == expectedInterval.isAfterNewline &&
+		                       updatedInterval.nSpaces == expectedInterval.nSpaces,
+		                       "token " << i << " '" << expected.getTokenValue (i) << "' after " << edit);
+	}
+
+	BOOST_CHECK_EQUAL (session.getFileContext().getNameContext()->getDeclarations().size(),
+	                   created->getNameContext()->getDeclarations().size());
+}
+
+BOOST_AUTO_TEST_CASE (IncrementalSessionRandomEdits)
+{
+	IncrementalSession session (sessionFileName, makeSource (10), {});
+
+	// Comment & string delimiters change tokens after the edit: such edits tokenize the whole file
+	const char* insertedTexts[] = { " ", "\n", "  ", "x", "+ 1", "/*", "*/", "\"", "int y;\n", "\n    ", "" };
+	mt19937 random (1);
+
+	for (unsigned i = 0; i < 100; i++)
+	{
+		uint32_t length = static_cast <uint32_t> (session.getFileContext().getFileContents().length());
+		uint32_t offset = random() % (length + 1);
+		uint32_t nRemovedBytes = min <uint32_t> (random() % 3, length - offset);
+		string insertedText = insertedTexts[random() % (sizeof (insertedTexts) / sizeof (insertedTexts[0]))];
+
+		session.applyEdit (offset, nRemovedBytes, insertedText);
+		checkSameAsCreated (session, "edit " + to_string (i) + " at " + to_string (offset) + ", " +
+		                             to_string (nRemovedBytes) + " bytes removed, '" + insertedText + "' inserted");
+	}
+}
+
+BOOST_AUTO_TEST_CASE (IncrementalSessionWholeFileTokenized)
+{
+	IncrementalSession session (sessionFileName, makeSource (3), {});
+
+	MemoryOutputStream logStream;
+	ApplicationLogger::instance().openLog (&logStream);
+
+	// Opening a comment swallows the tokens after it: the whole file is tokenized again. Removing the comment start
+	// changes tokens up to the comment end only.
+	size_t bodyOffset = session.getFileContext().getFileContents().find ("    if (x > 1)");
+	session.applyEdit (static_cast <uint32_t> (bodyOffset), 0, "/*");
+	checkSameAsCreated (session, "opening a comment");
+
+	session.applyEdit (static_cast <uint32_t> (bodyOffset), 2, "");
+	checkSameAsCreated (session, "removing the comment start");
+
+	// An edit inside a token keeps tokens after it
+	session.applyEdit (static_cast <uint32_t> (bodyOffset) + 4, 2, "while");
+	checkSameAsCreated (session, "replacing a keyword");
+
+	session.setContents ("int g;\n");
+	checkSameAsCreated (session, "replacing the whole source");
+
+	ApplicationLogger::instance().closeLog();
+
+	unique_ptr <UniversalInputStream> input = UniversalInputStream::openInputStream ("application-log", logStream.getContents());
+	unique_ptr <ApplicationLog> log = ApplicationLog::load (input.get());
+
+	unsigned nWholeFileTokenizations = 0, nPartialUpdates = 0;
+	for (unsigned i = 0; i < log->getNumEntries(); i++)
+	{
+		string message = log->getEntryMessage (i);
+		nWholeFileTokenizations += message.find ("tokenizing the whole file") != string::npos ? 1 : 0;
+		nPartialUpdates += message.find ("tokens replaced by") != string::npos ? 1 : 0;
+	}
+
+	BOOST_CHECK_EQUAL (nWholeFileTokenizations, 1u);
+	BOOST_CHECK_EQUAL (nPartialUpdates, 3u);
+}
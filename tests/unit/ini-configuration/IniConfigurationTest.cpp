@@ -1,11 +1,13 @@
 #include "Common.h"
 #include "IniConfiguration.h"
 #include "ApplicationLog.h"
+#include "BinaryData.h"
 #include "FileStreams.h"
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <cstdio>
+#include <thread>
 
 using namespace sa;
 
@@ -84,6 +86,7 @@ BOOST_AUTO_TEST_CASE (IniConfigurationSyntax)
     BOOST_CHECK_EXCEPTION (loadFromString ("\n\n\n#include <library> someshit\n"), IniConfigurationException, invalidSyntax);
     BOOST_CHECK_EXCEPTION (loadFromString ("\n\n\n#include\n<library>\n"), IniConfigurationException, invalidSyntax);
     BOOST_CHECK_THROW (loadFromString ("\n\n\n#include <include-not-found>\n"), FileNotFoundException);
+    BOOST_CHECK_EXCEPTION (loadFromFile ("data/recursive.ini"), IniConfigurationException, invalidSyntax);
 
     // Key-value pairs
     BOOST_CHECK_EXCEPTION (loadFromString ("key hello = \"test\""), IniConfigurationException, invalidSyntax);
@@ -178,6 +181,39 @@ BOOST_AUTO_TEST_CASE (IniConfigurationSemantics)
         BOOST_CHECK_EXCEPTION (test = config["notfound"] == "hello", IniConfigurationException, undefinedIniProperty);
     }
 
+    // Key handles & typed values
+    {
+        static_assert (hashIniKeyLiteral ("Section.Key") == hashIniKeyLiteral ("section.key"), "Keys are case-insensitive");
+        BOOST_CHECK_EQUAL (hashIniKey ("Section.Key", 11), hashIniKeyLiteral ("section.key"));
+
+        load ("[Section]\nNumber=\"42\"\nFlag=\"true\"\nWrong=\"4x\"");
+        BOOST_CHECK_EQUAL (config["SECTION.number"].asInteger(), 42);
+        BOOST_CHECK_EQUAL (config[saIniKey ("section.Flag")].asBoolean(), true);
+
+        IniPropertyHandle number = config.getHandle (saIniKey ("section.number"));
+        BOOST_CHECK_EQUAL (config[number].asInteger(), 42);
+        config["section.number"] = 7;
+        BOOST_CHECK_EQUAL (config[number].asInteger(), 7);
+
+        // Handles of undefined keys see later definitions
+        IniPropertyHandle later = config.getHandle (IniKey (string ("section.later")));
+        BOOST_CHECK (!config[later].isDefined());
+        BOOST_CHECK_EXCEPTION (config[later].asInteger(), IniConfigurationException, undefinedIniProperty);
+        config["Section.Later"] = "-1";
+        BOOST_CHECK_EQUAL (config[later].asInteger(), -1);
+
+        BOOST_CHECK_EXCEPTION (config["section.wrong"].asInteger(), IniConfigurationException, invalidPropertyValue);
+        BOOST_CHECK_EXCEPTION (config["section.wrong"].asBoolean(), IniConfigurationException, invalidPropertyValue);
+
+        // Many keys: slot table grows, handles & references to values stay valid
+        const vector <string>& numberValues = config[number].asVector();
+        for (int i = 0; i < 100; i++)
+            config["generated.key" + toString (i)] = i;
+        BOOST_CHECK_EQUAL (config[number].asInteger(), 7);
+        BOOST_CHECK_EQUAL (numberValues, vector <string> { "7" });
+        BOOST_CHECK_EQUAL (config["GENERATED.KEY99"].asInteger(), 99);
+    }
+
     // C++ API property-relative paths
     {
         unique_ptr <IniConfiguration> configuration = loadFromFile ("data/relative-reference.ini");
@@ -191,3 +227,247 @@ BOOST_AUTO_TEST_CASE (IniConfigurationSemantics)
 
 #undef load
 }
+
+BOOST_AUTO_TEST_CASE (IniConfigurationIncludeCache)
+{
+	CHANGE_DIRECTORY();
+
+	// Shared includes are read & tokenized once
+	unique_ptr <IniConfiguration> first = loadFromFile ("data/relative-reference.ini");
+	shared_ptr <IniCachedFile> cached = IniFileCache::instance().get ("data/recurse/a.ini");
+	BOOST_CHECK (cached->isTokenized);
+
+	unique_ptr <IniConfiguration> second = loadFromFile ("data/relative-reference.ini");
+	BOOST_CHECK_EQUAL (IniFileCache::instance().get ("data/recurse/a.ini").get(), cached.get());
+	BOOST_CHECK_EQUAL ((*first)["paths"].asVector(), (*second)["paths"].asVector());
+
+	// Changed files are read again
+	boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	auto write = [&] (const char* contents)
+	{
+		FILE* file = fopen (path.string().c_str(), "w");
+		BOOST_REQUIRE (file);
+		fputs (contents, file);
+		fclose (file);
+	};
+
+	write ("key = \"one\"\n");
+	BOOST_CHECK_EQUAL ((*loadFromFile (path.string()))["key"], "one");
+	write ("key = \"changed\"\n");
+	BOOST_CHECK_EQUAL ((*loadFromFile (path.string()))["key"], "changed");
+
+	// Edits keeping the size within the same second are seen too
+	write ("key = \"edited!\"\n");
+	BOOST_CHECK_EQUAL ((*loadFromFile (path.string()))["key"], "edited!");
+
+	boost::filesystem::remove (path);
+}
+
+BOOST_AUTO_TEST_CASE (IniConfigurationSnapshot)
+{
+	CHANGE_DIRECTORY();
+
+	boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	boost::filesystem::create_directory (directory);
+	string iniFile = (directory / "project.ini").string(), snapshotFile = (directory / "project.snapshot").string();
+
+	auto write = [] (const string& fileName, const char* contents)
+	{
+		FILE* file = fopen (fileName.c_str(), "w");
+		BOOST_REQUIRE (file);
+		fputs (contents, file);
+		fclose (file);
+	};
+
+	write ((directory / "base.ini").string(), "[base]\nvalue = \"one\"\nlist[] = \"a\"\nlist[] = \"b\"\n");
+	write (iniFile, "#include \"base.ini\"\n[project]\nname = \"snapshot\"\n");
+
+	BOOST_CHECK (!IniConfiguration::loadSnapshot (snapshotFile));
+
+	{
+		IniIncludeManager includeManager;
+		unique_ptr <IniConfiguration> config = IniConfiguration::loadWithSnapshot (iniFile, snapshotFile, &includeManager);
+		BOOST_CHECK_EQUAL ((*config)["project.name"], "snapshot");
+	}
+
+	unique_ptr <IniConfiguration> snapshot = IniConfiguration::loadSnapshot (snapshotFile);
+	BOOST_REQUIRE (snapshot);
+	BOOST_CHECK_EQUAL ((*snapshot)["project.name"], "snapshot");
+	BOOST_CHECK_EQUAL ((*snapshot)["base.value"], "one");
+	BOOST_CHECK_EQUAL ((*snapshot)["base.list"].asVector(), (vector <string> { "a", "b" }));
+	BOOST_CHECK_PREDICATE ((::boost::algorithm::ends_with <string, string>),
+	                       ((*snapshot)["base.value"].resolveRelativePath (0, "project.ini"))("project.ini"));
+
+	// Any change in the include graph makes the snapshot outdated
+	write ((directory / "base.ini").string(), "[base]\nvalue = \"two\"\n");
+	BOOST_CHECK (!IniConfiguration::loadSnapshot (snapshotFile));
+
+	{
+		IniIncludeManager includeManager;
+		unique_ptr <IniConfiguration> config = IniConfiguration::loadWithSnapshot (iniFile, snapshotFile, &includeManager);
+		BOOST_CHECK_EQUAL ((*config)["base.value"], "two");
+	}
+	BOOST_CHECK (IniConfiguration::loadSnapshot (snapshotFile));
+
+	// So does a change keeping the size within the same second
+	write ((directory / "base.ini").string(), "[base]\nvalue = \"owt\"\n");
+	BOOST_CHECK (!IniConfiguration::loadSnapshot (snapshotFile));
+
+	// A snapshot of another project is rebuilt, the project files are unchanged
+	string otherIniFile = (directory / "other.ini").string();
+	write (otherIniFile, "[project]\nname = \"other\"\n");
+	{
+		IniIncludeManager includeManager;
+		unique_ptr <IniConfiguration> config = IniConfiguration::loadWithSnapshot (otherIniFile, snapshotFile,
+		                                                                           &includeManager);
+		BOOST_CHECK_EQUAL ((*config)["project.name"], "other");
+		BOOST_CHECK (!(*config)["base.value"].isDefined());
+	}
+	{
+		IniIncludeManager includeManager;
+		unique_ptr <IniConfiguration> config = IniConfiguration::loadWithSnapshot (iniFile, snapshotFile, &includeManager);
+		BOOST_CHECK_EQUAL ((*config)["project.name"], "snapshot");
+	}
+
+	// Garbage is not a snapshot
+	write (snapshotFile, "garbage");
+	BOOST_CHECK (!IniConfiguration::loadSnapshot (snapshotFile));
+
+	// Neither are file ids out of the include graph: the root file is up to date, a second file includes itself
+	auto writeSnapshot = [&] (uint32_t includedWithId, uint32_t definedAtId)
+	{
+		string rootFile = boost::filesystem::canonical (otherIniFile).string();
+		BinaryWriter writer;
+		writer.writeInteger (0x53494153);
+		writer.writeInteger (2);
+		writer.writeInteger (2);
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			writer.writeString (rootFile);
+			writer.writeInteger (i == 0 ? 0 : includedWithId);
+			writer.writeInteger (1);
+			writer.writeInteger (1);
+			writer.writeInteger64 (boost::filesystem::file_size (rootFile));
+			writer.writeInteger64 (hashFileContents (rootFile));
+		}
+
+		writer.writeInteger (1);
+		writer.writeString ("project.name");
+		writer.writeInteger (1);
+		writer.writeString ("other");
+		writer.writeInteger (definedAtId);
+		writer.writeInteger (2);
+
+		FILE* file = fopen (snapshotFile.c_str(), "wb");
+		BOOST_REQUIRE (file);
+		fwrite (writer.contents.data(), 1, writer.contents.length(), file);
+		fclose (file);
+	};
+
+	writeSnapshot (0, 1);
+	BOOST_CHECK (IniConfiguration::loadSnapshot (snapshotFile));
+	writeSnapshot (1, 0);
+	BOOST_CHECK (!IniConfiguration::loadSnapshot (snapshotFile));
+	writeSnapshot (0, 2);
+	BOOST_CHECK (!IniConfiguration::loadSnapshot (snapshotFile));
+
+	boost::filesystem::remove_all (directory);
+}
+
+BOOST_AUTO_TEST_CASE (IniConfigurationLayers)
+{
+	shared_ptr <const IniConfiguration> base (loadFromString ("[a]\nkey = \"base\"\nlist[] = \"1\"\nlist[] = \"2\"\n"
+	                                                          "[b]\nnumber = \"10\"\n"));
+	const IniConfiguration& baseView = *base;
+	IniPropertyHandle keyHandle = baseView.findHandle (saIniKey ("a.key"));
+	BOOST_CHECK (keyHandle.isValid());
+
+	// Keys never met have invalid handles
+	IniPropertyHandle missingHandle = baseView.findHandle (saIniKey ("a.missing"));
+	BOOST_CHECK (!missingHandle.isValid());
+	BOOST_CHECK (!baseView[missingHandle].isDefined());
+	BOOST_CHECK_THROW (baseView[missingHandle].asString(), IniConfigurationException);
+
+	unique_ptr <IniConfiguration> layer = IniConfiguration::createLayer (base);
+
+	// Reads fall through to the base, base handles are valid
+	BOOST_CHECK_EQUAL ((*layer)[keyHandle], "base");
+	BOOST_CHECK_EQUAL ((*layer)["b.number"].asInteger(), 10);
+	BOOST_CHECK_EQUAL ((*layer)["a.list"].asVector(), (vector <string> { "1", "2" }));
+
+	// Writes stay in the layer
+	(*layer)["a.key"] = "layer";
+	(*layer)["a.list"].push_back ("3");
+	(*layer)["c.new"] = "new";
+	BOOST_CHECK_EQUAL ((*layer)[keyHandle], "layer");
+	BOOST_CHECK_EQUAL ((*layer)["A.LIST"].asVector(), (vector <string> { "1", "2", "3" }));
+	BOOST_CHECK_EQUAL ((*layer)["c.new"], "new");
+
+	BOOST_CHECK_EQUAL (baseView[keyHandle], "base");
+	BOOST_CHECK_EQUAL (baseView["a.list"].asVector().size(), 2);
+	BOOST_CHECK (!baseView["c.new"].isDefined());
+
+	// Layers of layers copy the delta only
+	unique_ptr <IniConfiguration> stacked = IniConfiguration::createLayer (shared_ptr <const IniConfiguration> (move (layer)));
+	(*stacked)["b.number"] = 20;
+	BOOST_CHECK_EQUAL ((*stacked)[keyHandle], "layer");
+	BOOST_CHECK_EQUAL ((*stacked)["c.new"], "new");
+	BOOST_CHECK_EQUAL ((*stacked)["b.number"].asInteger(), 20);
+	BOOST_CHECK_EQUAL (baseView["b.number"].asInteger(), 10);
+
+	// Overrides keep value origins
+	unique_ptr <IniConfiguration> overrides = loadFromFile ("data/relative-reference.ini");
+	unique_ptr <IniConfiguration> job = IniConfiguration::createLayer (base);
+	job->overrideWith (*overrides);
+	BOOST_CHECK_EQUAL ((*job)[keyHandle], "base");
+	CHANGE_DIRECTORY();
+	BOOST_CHECK_EQUAL ((*job)["paths"].resolveRelativePath (1, "syntax.ini"),
+	                   (*overrides)["paths"].resolveRelativePath (1, "syntax.ini"));
+	BOOST_CHECK_THROW ((*job)["paths"].resolveRelativePath (2, "throw-exception"), FileNotFoundException);
+}
+
+BOOST_AUTO_TEST_CASE (IniConfigurationFrozen)
+{
+	shared_ptr <const IniConfiguration> frozen = IniConfiguration::freeze (
+		loadFromString ("[a]\nnumber = \"42\"\nflag = \"true\"\nlist[] = \"x\"\nlist[] = \"y\"\n"
+		                "[b]\nunused = \"1\"\nalsoUnused = \"2\"\n"));
+
+	auto readOnly = [] (IniConfigurationException e)
+	                {
+	                    return e.getType() == IniConfigurationException::Type::READ_ONLY_INI_CONFIGURATION;
+	                };
+
+	IniProperty::Accessor number = (*frozen)["a.number"];
+	BOOST_CHECK_EXCEPTION (number = 10, IniConfigurationException, readOnly);
+	BOOST_CHECK_EXCEPTION ((*frozen)["a.new"].push_back ("x"), IniConfigurationException, readOnly);
+
+	// Concurrent readers: usage counters are merged once they are finished
+	vector <std::thread> readers;
+	vector <int> sums (4, 0);
+	for (unsigned i = 0; i < sums.size(); i++)
+		readers.push_back (std::thread ([&frozen, &sums, i]
+		{
+			for (unsigned j = 0; j < 1000; j++)
+			{
+				sums[i] += (*frozen)[saIniKey ("a.number")].asInteger();
+				if (i % 2 && (*frozen)["a.list"].asVector().size() == 2)
+					sums[i]++;
+			}
+		}));
+
+	for (std::thread& reader: readers)
+		reader.join();
+
+	BOOST_CHECK (sums == (vector <int> { 42000, 43000, 42000, 43000 }));
+	BOOST_CHECK_EQUAL (frozen->getUnusedProperties(), (vector <string> { "a.flag", "b.unused", "b.alsounused" }));
+
+	BOOST_CHECK ((*frozen)["a.flag"].asBoolean());
+	BOOST_CHECK_EQUAL (frozen->getUnusedProperties(), (vector <string> { "b.unused", "b.alsounused" }));
+
+	// Jobs layered over a frozen configuration count usage in the base
+	unique_ptr <IniConfiguration> job = IniConfiguration::createLayer (frozen);
+	(*job)["b.unused"] = "overridden";
+	BOOST_CHECK_EQUAL ((*job)["b.alsounused"], "2");
+	BOOST_CHECK_EQUAL (job->getUnusedProperties(), (vector <string> { "b.unused" }));
+	BOOST_CHECK_EQUAL (frozen->getUnusedProperties(), (vector <string> { "b.unused" }));
+}
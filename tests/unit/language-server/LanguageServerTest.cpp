@@ -0,0 +1,183 @@
+#include <chrono>
+#include <thread>
+
+#include <unistd.h>
+
+#include "Common.h"
+#include "FileStreams.h"
+#include "LanguageServer.h"
+
+using namespace sa;
+using namespace std;
+
+BOOST_AUTO_TEST_CASE (LanguageServerPositions)
+{
+	// 'é' is 2 bytes & 1 UTF-16 unit, the emoji is 4 bytes & 2 units
+	string text = "ab\nx\xc3\xa9y\xf0\x9f\x98\x80z\n";
+	TextLineIndex index (text);
+
+	BOOST_CHECK_EQUAL (index.getOffset (0, 1), 1u);
+	BOOST_CHECK_EQUAL (index.getOffset (1, 2), 6u);
+	BOOST_CHECK_EQUAL (index.getOffset (1, 5), 11u);
+	BOOST_CHECK_EQUAL (index.getOffset (1, 100), 12u);
+	BOOST_CHECK_EQUAL (index.getOffset (5, 0), text.length());
+
+	uint32_t line = 0, character = 0;
+	index.getPosition (11, line, character);
+	BOOST_CHECK_EQUAL (line, 1u);
+	BOOST_CHECK_EQUAL (character, 5u);
+
+	BOOST_CHECK_EQUAL (convertUriToPath ("file:///home/a%20b/c.cpp"), "/home/a b/c.cpp");
+}
+
+BOOST_AUTO_TEST_CASE (LanguageServerNamingStyles)
+{
+	BOOST_CHECK (matchesNamingStyle ("fileName", NamingStyle::LOWER_CAMEL_CASE));
+	BOOST_CHECK (!matchesNamingStyle ("FileName", NamingStyle::LOWER_CAMEL_CASE));
+	BOOST_CHECK (matchesNamingStyle ("FileContext", NamingStyle::UPPER_CAMEL_CASE));
+	BOOST_CHECK (!matchesNamingStyle ("file_context", NamingStyle::UPPER_CAMEL_CASE));
+	BOOST_CHECK (matchesNamingStyle ("__file_name", NamingStyle::SNAKE_CASE));
+	BOOST_CHECK (matchesNamingStyle ("MAX_SIZE", NamingStyle::UPPER_CASE));
+	BOOST_CHECK (matchesNamingStyle ("whatever_Name", NamingStyle::ANY));
+}
+
+BOOST_AUTO_TEST_CASE (LanguageServerProtocol)
+{
+	string input;
+	for (string body: { "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}",
+	                    "{\"jsonrpc\":\"2.0\",\"id\":\"x\",\"method\":\"unknown\"}",
+	                    "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"shutdown\"}",
+	                    "{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}" })
+		input += "Content-Length: " + to_string (body.length()) + "\r\n\r\n" + body;
+
+	// Malformed headers are dropped, messages after them are read
+	size_t secondMessage = input.find ("Content-Length", 1);
+	input.insert (secondMessage, "Content-Length: many\r\n\r\nContent-Length: 99999999999999999999999\r\n\r\n"
+	                             "Content-Length: -2\r\n\r\nContent-Length: +2\r\n\r\n");
+
+	int fds[2];
+	BOOST_REQUIRE (pipe (fds) == 0);
+	BOOST_REQUIRE (write (fds[1], input.data(), input.length()) == static_cast <ssize_t> (input.length()));
+	close (fds[1]);
+
+	IniIncludeManager includeManager;
+	unique_ptr <IInputStream> projectFile = includeManager.openInputStream ("<memory buffer>", "[languageServer]\n");
+	unique_ptr <IniConfiguration> project = IniConfiguration::load ("<memory buffer>", projectFile.get(), &includeManager);
+	MemoryOutputStream output;
+	LanguageServer server (*project, fds[0], &output);
+	BOOST_CHECK_EQUAL (server.run(), 0);
+	close (fds[0]);
+
+	const string& contents = output.getContents();
+	BOOST_CHECK (contents.find ("\"id\":1,\"result\":{\"capabilities\":{\"textDocumentSync\"") != string::npos);
+	BOOST_CHECK (contents.find ("\"id\":\"x\",\"error\":{\"code\":-32601") != string::npos);
+	BOOST_CHECK (contents.find ("Content-Length: 38\r\n\r\n{\"jsonrpc\":\"2.0\",\"id\":2,\"result\":null}") != string::npos);
+}
+
+static string frameMessage (const string& body)
+{
+	return "Content-Length: " + to_string (body.length()) + "\r\n\r\n" + body;
+}
+
+static string makeChange (unsigned version, unsigned startCharacter, unsigned endCharacter, const string& text)
+{
+	return frameMessage ("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":{\"textDocument\":"
+	                     "{\"uri\":\"file:///language-server-test.cpp\",\"version\":" + to_string (version) + "},"
+	                     "\"contentChanges\":[{\"range\":{\"start\":{\"line\":2,\"character\":" +
+	                     to_string (startCharacter) + "},\"end\":{\"line\":2,\"character\":" + to_string (endCharacter) +
+	                     "}},\"text\":\"" + text + "\"}]}}");
+}
+
+static unsigned countOccurrences (const string& text, const string& pattern)
+{
+	unsigned count = 0;
+	for (size_t position = text.find (pattern); position != string::npos; position = text.find (pattern, position + 1))
+		count++;
+	return count;
+}
+
+BOOST_AUTO_TEST_CASE (LanguageServerDiagnostics)
+{
+	int fds[2];
+	BOOST_REQUIRE (pipe (fds) == 0);
+
+	// Messages come as an editor sends them: the burst of edits is well within the debounce interval
+	bool isSent = true;
+	thread editor ([&fds, &isSent]
+	{
+		auto send = [&fds, &isSent] (const string& message)
+		{
+			isSent &= write (fds[1], message.data(), message.length()) == static_cast <ssize_t> (message.length());
+		};
+
+		send (frameMessage ("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{}}"));
+		send (frameMessage ("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":"
+		                    "{\"uri\":\"file:///language-server-test.cpp\",\"version\":1,"
+		                    "\"text\":\"int f ()\\n{\\n   return 1;\\n}\\n\"}}}"));
+		this_thread::sleep_for (chrono::milliseconds (200));
+
+		send (makeChange (2, 0, 0, " "));
+		this_thread::sleep_for (chrono::milliseconds (2));
+		send (makeChange (3, 0, 0, " "));
+		this_thread::sleep_for (chrono::milliseconds (2));
+		send (makeChange (4, 0, 1, ""));
+
+		// Past the analysis & the whole file check
+		this_thread::sleep_for (chrono::milliseconds (400));
+		send (frameMessage ("{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"shutdown\"}"));
+		send (frameMessage ("{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}"));
+		close (fds[1]);
+	});
+
+	IniIncludeManager includeManager;
+	unique_ptr <IInputStream> projectFile = includeManager.openInputStream ("<memory buffer>",
+		"[languageServer]\nDebounceMilliseconds = \"50\"\nFullCheckMilliseconds = \"50\"\n");
+	unique_ptr <IniConfiguration> project = IniConfiguration::load ("<memory buffer>", projectFile.get(), &includeManager);
+	MemoryOutputStream output;
+	LanguageServer server (*project, fds[0], &output);
+	BOOST_CHECK_EQUAL (server.run(), 0);
+	editor.join();
+	close (fds[0]);
+	BOOST_REQUIRE (isSent);
+
+	const string& contents = output.getContents();
+
+	// The opened document is misindented, the edits fix it: 3 spaces, 4, 5, then 4 again
+	size_t opened = contents.find ("\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":"
+	                               "\"file:///language-server-test.cpp\",\"version\":1,\"diagnostics\":[{\"range\":"
+	                               "{\"start\":{\"line\":2,\"character\":0}");
+	BOOST_CHECK (opened != string::npos);
+	BOOST_CHECK (contents.find ("\"code\":\"indentation\"", opened) != string::npos);
+
+	// The burst is analyzed once, for its last version; the whole file check finds nothing new
+	BOOST_CHECK_EQUAL (countOccurrences (contents, "textDocument/publishDiagnostics"), 2u);
+	BOOST_CHECK (contents.find ("\"version\":4,\"diagnostics\":[]}}") != string::npos);
+	BOOST_CHECK (contents.find ("\"version\":2,") == string::npos);
+	BOOST_CHECK (contents.find ("\"version\":3,") == string::npos);
+
+	// The shutdown result is the last message
+	string shutdownResult = frameMessage ("{\"jsonrpc\":\"2.0\",\"id\":2,\"result\":null}");
+	BOOST_CHECK_EQUAL (contents.rfind (shutdownResult), contents.length() - shutdownResult.length());
+}
+
+BOOST_AUTO_TEST_CASE (LanguageServerExitWithoutShutdown)
+{
+	IniIncludeManager includeManager;
+	unique_ptr <IInputStream> projectFile = includeManager.openInputStream ("<memory buffer>", "[languageServer]\n");
+	unique_ptr <IniConfiguration> project = IniConfiguration::load ("<memory buffer>", projectFile.get(), &includeManager);
+
+	// 'exit' without 'shutdown' & the end of input are failures
+	for (string input: { frameMessage ("{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}"), string() })
+	{
+		int fds[2];
+		BOOST_REQUIRE (pipe (fds) == 0);
+		BOOST_REQUIRE (write (fds[1], input.data(), input.length()) == static_cast <ssize_t> (input.length()));
+		close (fds[1]);
+
+		MemoryOutputStream output;
+		LanguageServer server (*project, fds[0], &output);
+		BOOST_CHECK_EQUAL (server.run(), 1);
+		BOOST_CHECK (output.getContents().empty());
+		close (fds[0]);
+	}
+}
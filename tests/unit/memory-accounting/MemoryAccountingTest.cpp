@@ -0,0 +1,41 @@
+#include <thread>
+
+#include "Common.h"
+#include "MemoryAccounting.h"
+
+using namespace sa;
+
+BOOST_AUTO_TEST_CASE (MemoryAccountingCounters)
+{
+	// The unit tests do not link the allocation hooks: counters change by explicit records only
+	BOOST_CHECK (!areAllocationHooksInstalled());
+
+	uint64_t nAllocations = getThreadAllocations(), nBytesAllocated = getThreadBytesAllocated();
+	uint64_t liveBytes = getLiveHeapBytes();
+
+	resetPeakLiveHeapBytes();
+	BOOST_CHECK_EQUAL (getPeakLiveHeapBytes(), liveBytes);
+
+	recordAllocation (1000);
+	recordAllocation (24);
+	recordDeallocation (1000);
+
+	BOOST_CHECK_EQUAL (getThreadAllocations(), nAllocations + 2);
+	BOOST_CHECK_EQUAL (getThreadBytesAllocated(), nBytesAllocated + 1024);
+	BOOST_CHECK_EQUAL (getLiveHeapBytes(), liveBytes + 24);
+	BOOST_CHECK_EQUAL (getPeakLiveHeapBytes(), liveBytes + 1024);
+
+	// Per thread counts, process-wide live bytes
+	std::thread worker ([] { recordAllocation (8); });
+	worker.join();
+
+	BOOST_CHECK_EQUAL (getThreadAllocations(), nAllocations + 2);
+	BOOST_CHECK_EQUAL (getLiveHeapBytes(), liveBytes + 32);
+
+	recordDeallocation (32);
+	resetPeakLiveHeapBytes();
+	BOOST_CHECK_EQUAL (getPeakLiveHeapBytes(), liveBytes);
+
+	BOOST_CHECK (getResidentBytes() > 0);
+	BOOST_CHECK (getPeakResidentBytes() >= getResidentBytes() / 2);
+}
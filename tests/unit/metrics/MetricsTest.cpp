@@ -0,0 +1,61 @@
+#include <thread>
+
+#include "Common.h"
+#include "Metrics.h"
+#include "FileStreams.h"
+
+using namespace sa;
+using namespace std;
+
+static MetricCounter testCounter ("sa_test_events_total", "Events of the metrics test.");
+static MetricHistogram testHistogram ("sa_test_seconds", "Durations of the metrics test.");
+
+BOOST_AUTO_TEST_CASE (MetricsConcurrentUpdates)
+{
+	uint64_t nEventsBefore = testCounter.get();
+
+	vector <thread> threads;
+	for (int i = 0; i < 4; i++)
+		threads.push_back (thread ([] { for (int j = 0; j < 1000; j++) testCounter.add(); }));
+	for (thread& t: threads)
+		t.join();
+
+	BOOST_CHECK_EQUAL (testCounter.get(), nEventsBefore + 4000);
+}
+
+BOOST_AUTO_TEST_CASE (MetricsExportFormats)
+{
+	uint64_t nObservationsBefore = testHistogram.getCount();
+
+	testHistogram.observe (0.002);
+	testHistogram.observe (0.3);
+	testHistogram.observe (100);
+
+	BOOST_CHECK_EQUAL (testHistogram.getCount(), nObservationsBefore + 3);
+	BOOST_CHECK_EQUAL (MetricHistogram::getBucketUpperBound (0), 0.005);
+	BOOST_CHECK (testHistogram.getBucketCount (MetricHistogram::getNumBuckets() - 1) >= 1);
+
+	MemoryOutputStream prometheus;
+	MetricsRegistry::instance().writePrometheus (&prometheus);
+
+	BOOST_CHECK (prometheus.getContents().find ("# TYPE sa_test_events_total counter\nsa_test_events_total ") != string::npos);
+	BOOST_CHECK (prometheus.getContents().find ("# TYPE sa_files_processed_total counter\n") != string::npos);
+	BOOST_CHECK (prometheus.getContents().find ("# TYPE sa_test_seconds histogram\n") != string::npos);
+
+	// Buckets are cumulative
+	if (nObservationsBefore == 0)
+	{
+		BOOST_CHECK (prometheus.getContents().find ("sa_test_seconds_bucket{le=\"0.005\"} 1\n") != string::npos);
+		BOOST_CHECK (prometheus.getContents().find ("sa_test_seconds_bucket{le=\"0.5\"} 2\n") != string::npos);
+		BOOST_CHECK (prometheus.getContents().find ("sa_test_seconds_bucket{le=\"+Inf\"} 3\n") != string::npos);
+		BOOST_CHECK (prometheus.getContents().find ("sa_test_seconds_sum 100.302000\nsa_test_seconds_count 3\n") != string::npos);
+	}
+
+	MemoryOutputStream json;
+	MetricsRegistry::instance().writeJson (&json);
+
+	BOOST_CHECK_EQUAL (json.getContents()[0], '{');
+	BOOST_CHECK (json.getContents().find ("\"sa_test_events_total\": ") != string::npos);
+	BOOST_CHECK (json.getContents().find ("\"sa_test_seconds\": {\"buckets\": {\"0.005\": ") != string::npos);
+	BOOST_CHECK (json.getContents().find ("\"+Inf\": ") != string::npos);
+}
@@ -0,0 +1,101 @@
+#include "Common.h"
+#include "NameContext.h"
+#include <boost/filesystem.hpp>
+
+#include <cstdio>
+
+using namespace sa;
+using namespace std;
+
+static void checkSameDeclarations (const vector <NameDeclaration>& collected, const vector <NameDeclaration>& visited)
+{
+	BOOST_REQUIRE_EQUAL (collected.size(), visited.size());
+	for (size_t i = 0; i < visited.size(); i++)
+	{
+		BOOST_CHECK_EQUAL (collected[i].name, visited[i].name);
+		BOOST_CHECK (collected[i].kind == visited[i].kind);
+		BOOST_CHECK_EQUAL (collected[i].fileBufferOffset, visited[i].fileBufferOffset);
+	}
+}
+
+BOOST_AUTO_TEST_CASE (NameCollectorSameAsVisit)
+{
+	boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	boost::filesystem::create_directory (directory);
+
+	// Templates are indexed differently from the visit (alias templates are not at all): names & kinds are the same still
+	string header = (directory / "shape.h").string();
+	FILE* file = fopen (header.c_str(), "w");
+	BOOST_REQUIRE (file);
+	fputs ("#define DECLARE_COUNT(name) int name##Count\n"
+	       "typedef unsigned ShapeId;\n"
+	       "class Shape\n{\npublic :\n    Shape (int sides);\n    int getSides() const;\n    bool operator== (const Shape& other);\n"
+	       "private :\n    int sides;\n    DECLARE_COUNT (corner);\n};\n"
+	       "enum class Color { RED, GREEN };\n"
+	       "int area (const Shape& shape, int (*scale) (int factor));\n"
+	       "template <typename T, int N> class Grid\n{\npublic :\n    template <typename U> Grid (U value);\n"
+	       "    template <typename Visitor> void visit (Visitor visitor);\n    template <typename U> bool operator< (U other);\n"
+	       "    template <typename V> using Row = V[N];\n    T cells[N];\n};\n"
+	       "template <typename T> class Grid <T*, 1> {};\n"
+	       "template <typename T> using GridRow = Grid <T, 8>;\n"
+	       "using Cell = int;\nnamespace detail { template <typename T> using Pair = Grid <T, 2>; }\n"
+	       "template <template <typename E> class Container> void fill (Container <int>& container);\n", file);
+	fclose (file);
+
+	// The source is never written to disk: the unit keeps it
+	string source = (directory / "shape.cpp").string();
+	string contents = "#include \"shape.h\"\n"
+	                  "Shape::Shape (int sides) : sides (sides) {}\n"
+	                  "int Shape::getSides() const\n{\n    int result = sides;\n    try { throw 1; } catch (int error) {}\n"
+	                  "    return result;\n}\n"
+	                  "namespace geometry { struct point_2d { double x, y; }; }\n"
+	                  "template <typename T> T maxOf (T a, T b) { return a < b ? b : a; }\n";
+
+	vector <string> options = { "-x", "c++", "-std=c++11" };
+	ClangIndex index (false, false);
+	vector <CXUnsavedFile> unsavedFiles = { CXUnsavedFile { source.c_str(), contents.data(), contents.length() } };
+	ClangTranslationUnit unit = index.parseTranslationUnit (source, options, CXTranslationUnit_None, unsavedFiles);
+	BOOST_REQUIRE (unit != nullptr);
+
+	NameCollector collector (index);
+	collector.collect (unit);
+
+	for (const string& fileName: { source, header })
+	{
+		CXFile unitFile = clang_getFile (unit, fileName.c_str());
+		BOOST_REQUIRE (unitFile);
+		unique_ptr <NameContext> visited = NameContext::create (unit, unitFile);
+		BOOST_CHECK (!visited->getDeclarations().empty());
+
+		checkSameDeclarations (collector.takeDeclarations (fileName), visited->getDeclarations());
+		BOOST_CHECK (collector.takeDeclarations (fileName).empty());
+	}
+
+	// A header taken is skipped in the next units
+	collector.collect (unit);
+	BOOST_CHECK (collector.takeDeclarations (header).empty());
+	BOOST_CHECK (!collector.takeDeclarations (source).empty());
+
+	// A header not taken is dropped, then collected again from the next unit including it
+	string otherSource = (directory / "other.cpp").string();
+	string otherContents = "#include \"shape.h\"\nint area (const Shape& shape, int (*scale) (int)) { return 0; }\n";
+	vector <CXUnsavedFile> otherUnsavedFiles = { CXUnsavedFile { otherSource.c_str(), otherContents.data(),
+	                                                              otherContents.length() } };
+	ClangTranslationUnit otherUnit = index.parseTranslationUnit (otherSource, options, CXTranslationUnit_None,
+	                                                             otherUnsavedFiles);
+	BOOST_REQUIRE (otherUnit != nullptr);
+
+	NameCollector otherCollector (index);
+	otherCollector.collect (unit);
+	BOOST_CHECK (!otherCollector.takeDeclarations (source).empty());
+	otherCollector.dropDeclarations();
+	BOOST_CHECK (otherCollector.takeDeclarations (header).empty());
+
+	otherCollector.collect (otherUnit);
+	CXFile otherUnitHeader = clang_getFile (otherUnit, header.c_str());
+	BOOST_REQUIRE (otherUnitHeader);
+	checkSameDeclarations (otherCollector.takeDeclarations (header),
+	                       NameContext::create (otherUnit, otherUnitHeader)->getDeclarations());
+
+	boost::filesystem::remove_all (directory);
+}
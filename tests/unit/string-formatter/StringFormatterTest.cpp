@@ -1,9 +1,13 @@
 #include "Common.h"
 #include "StringFormatter.h"
+#include "TranslationCatalog.h"
+#include "FileStreams.h"
+#include "Debug.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 
 #include <cstdio>
+#include <cstdint>
 
 using namespace sa;
 
@@ -19,3 +23,96 @@ BOOST_AUTO_TEST_CASE (StringFormatterBasicTypes)
     // Escape sequences
     BOOST_CHECK_EQUAL (string (saFormatPure ("%%%%hello%%")), "%%hello%");
 }
+
+BOOST_AUTO_TEST_CASE (StringFormatterNumbers)
+{
+    BOOST_CHECK_EQUAL (string (saFormatPure ("%1 %2 %3") << 0 << -7 << 1234567890), "0 -7 1234567890");
+    BOOST_CHECK_EQUAL (string (saFormatPure ("%1") << static_cast <int64_t> (INT64_MIN)), "-9223372036854775808");
+    BOOST_CHECK_EQUAL (string (saFormatPure ("%1") << static_cast <uint64_t> (UINT64_MAX)), "18446744073709551615");
+    BOOST_CHECK_EQUAL (string (saFormatPure ("%1 %2") << 10u << static_cast <size_t> (99)), "10 99");
+    BOOST_CHECK_EQUAL (string (saFormatPure ("%1 %2") << 0.5 << true), "0.5 true");
+
+    vector <int> vectorOfIntegers = { 1, 22 };
+    BOOST_CHECK_EQUAL (string (saFormatPure ("%1") << vectorOfIntegers), "{ \"1\", \"22\" }");
+    BOOST_CHECK_EQUAL (string (saFormatPure ("%1") << vector <int>()), "{ empty }");
+}
+
+BOOST_AUTO_TEST_CASE (StringFormatterArgumentLifetime)
+{
+    // Temporaries are owned by the holder
+    BOOST_CHECK_EQUAL (string (saFormatPure ("%1, %2") << string ("temporary") << vector <string> { "x" }),
+                       "temporary, { \"x\" }");
+
+    // Runtime format strings and repeated call site usage
+    for (int i = 0; i < 3; i++)
+    {
+        string runtimeFormat = "[%" + toString (i + 1) + "]";
+        BOOST_CHECK_EQUAL (string (saFormatPure (runtimeFormat) << "a" << "b" << "c"), "[" + string (1, char ('a' + i)) + "]");
+        BOOST_CHECK_EQUAL (string (saFormatPure ("(%1)") << i), "(" + toString (i) + ")");
+    }
+
+    // Missing arguments
+    BOOST_CHECK_THROW (static_cast <string> (saFormatPure ("%1 %2") << 1), AssertionFailure);
+
+    // Actions are fired after temporaries of the statement are gone: C strings pointing into them are copied
+    struct CapturingAction : public IAfterformatAction
+    {
+        mutable string text;
+
+        virtual void fire (const FormatMessage& message) const override
+        {
+            text = message.toString();
+        }
+    };
+
+    CapturingAction action;
+    sa::FormatObjectsHolder ("%1 %2", saFormatCallSite(), false, action) << string (100, 'x').c_str() << "literal";
+    BOOST_CHECK_EQUAL (action.text, string (100, 'x') + " literal");
+}
+
+static unique_ptr <TranslationCatalog> compileCatalog (string textCatalog)
+{
+	unique_ptr <UniversalInputStream> input = UniversalInputStream::openInputStream ("test catalog", textCatalog);
+	MemoryOutputStream output;
+	TranslationCatalog::compile ("test catalog", input.get(), &output);
+	return TranslationCatalog::load ("test catalog", output.getContents());
+}
+
+BOOST_AUTO_TEST_CASE (StringFormatterTranslation)
+{
+	unique_ptr <TranslationCatalog> catalog = compileCatalog ("; comment\n"
+	                                                          "source \"Hello, %1\" // comment\n"
+	                                                          "translation \"Привет, \"\n"
+	                                                          "            \"%1\"\n"
+	                                                          "\n"
+	                                                          "source \"Untranslated\"\n"
+	                                                          "translation \"\"\n");
+	BOOST_CHECK_EQUAL (catalog->getNumEntries(), 1u);
+	BOOST_CHECK_EQUAL (catalog->find ("Untranslated", 12), static_cast <const char*> (nullptr));
+
+	auto greet = [] (const char* name) -> string
+	{
+		return saFormat ("Hello, %1") << name;
+	};
+
+	InternationalizationEngine& engine = InternationalizationEngine::instance();
+	BOOST_CHECK_EQUAL (greet ("world"), "Hello, world");
+
+	// Call sites pick up a new catalog
+	engine.setCatalog (move (catalog));
+	BOOST_CHECK_EQUAL (greet ("world"), "Привет, world");
+	BOOST_CHECK_EQUAL (greet ("again"), "Привет, again");
+	BOOST_CHECK_EQUAL (string (saFormat (string ("Hello, %1")) << 1), "Привет, 1");
+	BOOST_CHECK_EQUAL (string (saFormatPure ("Hello, %1") << "pure"), "Hello, pure");
+
+	engine.setCatalog (nullptr);
+	BOOST_CHECK_EQUAL (greet ("world"), "Hello, world");
+
+	// Invalid catalogs
+	BOOST_CHECK_THROW (compileCatalog ("source \"%1\"\ntranslation \"%2\"\n"), TranslationCatalogException);
+	BOOST_CHECK_THROW (compileCatalog ("source \"a\"\nsource \"b\"\n"), TranslationCatalogException);
+	BOOST_CHECK_THROW (compileCatalog ("source \"a\ntranslation \"b\"\n"), TranslationCatalogException);
+	BOOST_CHECK_THROW (compileCatalog ("source \"a\"\ntranslation \"b\"\nsource \"a\"\ntranslation \"c\"\n"),
+	                   TranslationCatalogException);
+	BOOST_CHECK_THROW (TranslationCatalog::load ("garbage", "not a catalog"), TranslationCatalogException);
+}
@@ -0,0 +1,53 @@
+#include "Common.h"
+#include "FileStreams.h"
+#include "StyleStatistics.h"
+
+using namespace sa;
+using namespace std;
+
+static StyleStatistics summarize (ClangIndex& index, const string& fileName, const string& contents)
+{
+	vector <string> options = { "-x", "c++" };
+	vector <CXUnsavedFile> unsavedFiles = { CXUnsavedFile { fileName.c_str(), contents.data(), contents.length() } };
+	ClangTranslationUnit unit = index.parseTranslationUnit (fileName, options, CXTranslationUnit_None, unsavedFiles);
+	BOOST_REQUIRE (unit != nullptr);
+
+	unique_ptr <FileContext> context = FileContext::create (unit, contents);
+	StyleStatistics statistics;
+	statistics.addFile (*context);
+	return statistics;
+}
+
+BOOST_AUTO_TEST_CASE (StyleStatisticsMerging)
+{
+	ClangIndex index (false, false);
+	StyleStatistics first = summarize (index, "first.cpp", "int fileSize (int blockSize)\n{\n    int nBlocks = 1;\n"
+	                                                       "    return nBlocks * blockSize;\n}\n");
+	StyleStatistics second = summarize (index, "second.cpp", "struct Block\n{\n    int block_size; \n};\n\n"
+	                                                         "int block_count()\n{\n\treturn 2;\n}");
+
+	BOOST_CHECK_EQUAL (first.getFeatures().nLines, 5u);
+	BOOST_CHECK_EQUAL (second.getFeatures().nLines, 9u);
+	BOOST_CHECK_EQUAL (second.getFeatures().nTabIndentedLines, 1u);
+	BOOST_CHECK_EQUAL (second.getFeatures().nTrailingSpaceLines, 1u);
+	BOOST_CHECK_EQUAL (first.getNumNames (NameKind::VARIABLE, NamingStyle::ANY), 2u);
+	BOOST_CHECK_EQUAL (first.getNumNames (NameKind::VARIABLE, NamingStyle::LOWER_CAMEL_CASE), 2u);
+
+	// Merged in any order, the summary is the same
+	StyleStatistics merged = first, reversed = second;
+	merged.merge (second);
+	reversed.merge (first);
+	BOOST_CHECK (merged == reversed);
+	BOOST_CHECK_EQUAL (merged.getFeatures().nFiles, 2u);
+	BOOST_CHECK_EQUAL (merged.getFeatures().nTokens, first.getFeatures().nTokens + second.getFeatures().nTokens);
+
+	StyleRules rules = merged.inferRules (StyleRules { 2, NamingStyle::ANY, NamingStyle::ANY, NamingStyle::ANY });
+	BOOST_CHECK_EQUAL (rules.indentWidth, 4u);
+	BOOST_CHECK (rules.typeNames == NamingStyle::UPPER_CAMEL_CASE);
+	BOOST_CHECK (rules.variableNames == NamingStyle::LOWER_CAMEL_CASE);
+
+	MemoryOutputStream output;
+	merged.save (&output);
+	unique_ptr <UniversalInputStream> input = UniversalInputStream::openInputStream ("<memory buffer>", output.getContents());
+	BOOST_CHECK (StyleStatistics::load (input.get()) == merged);
+}
@@ -0,0 +1,124 @@
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Common.h"
+#include "Trace.h"
+#include "FileStreams.h"
+
+using namespace sa;
+using namespace std;
+
+static unsigned countOccurrences (const string& text, const string& pattern)
+{
+	unsigned count = 0;
+	for (size_t position = text.find (pattern); position != string::npos; position = text.find (pattern, position + 1))
+		count++;
+	return count;
+}
+
+BOOST_AUTO_TEST_CASE (TraceScopesOffByDefault)
+{
+	BOOST_REQUIRE (!TraceRecorder::instance().isRecording());
+
+	{
+		saTraceScope ("Not recorded");
+	}
+
+	BOOST_CHECK_EQUAL (TraceRecorder::instance().getNumEvents(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE (TraceChromeEventFormat)
+{
+	TraceRecorder::instance().startRecording();
+
+	{
+		saTraceScope ("Outer phase", "file", string ("dir\\a \"quoted\".cpp"));
+		saTraceScope ("Inner phase");
+	}
+
+	thread worker ([] { saTraceScope ("Worker phase", "file", "b.cpp"); });
+	worker.join();
+
+	TraceRecorder::instance().stopRecording();
+
+	{
+		saTraceScope ("After recording");
+	}
+
+	BOOST_CHECK_EQUAL (TraceRecorder::instance().getNumEvents(), 3u);
+
+	MemoryOutputStream stream;
+	TraceRecorder::instance().write (&stream);
+	const string& trace = stream.getContents();
+
+	BOOST_CHECK_EQUAL (trace.find ("{\"traceEvents\": ["), 0u);
+	BOOST_CHECK (trace.find ("\"displayTimeUnit\": \"ms\"}") != string::npos);
+	BOOST_CHECK_EQUAL (countOccurrences (trace, "\"ph\": \"X\""), 3u);
+
+	// Inner scope ends first
+	BOOST_CHECK (trace.find ("\"Inner phase\"") < trace.find ("\"Outer phase\""));
+	BOOST_CHECK (trace.find ("\"args\": {\"file\": \"dir\\\\a \\\"quoted\\\".cpp\"}") != string::npos);
+	BOOST_CHECK (trace.find ("After recording") == string::npos);
+
+	// Tracks are per thread
+	BOOST_CHECK (trace.find ("\"tid\": 1, \"args\": {\"name\": \"main\"}") != string::npos);
+	BOOST_CHECK (trace.find ("\"tid\": 2, \"args\": {\"name\": \"thread 2\"}") != string::npos);
+	BOOST_CHECK (trace.find ("\"Worker phase\", \"cat\": \"sa\", \"ph\": \"X\"") != string::npos);
+	BOOST_CHECK (trace.find ("\"pid\": 1, \"tid\": 2, \"args\": {\"file\": \"b.cpp\"}") != string::npos);
+
+	BOOST_CHECK_EQUAL (TraceRecorder::instance().getNumEvents(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE (TraceEventsOfForkedProcess)
+{
+	TraceRecorder::instance().startRecording();
+	{
+		saTraceScope ("Coordinator phase");
+	}
+
+	int fds[2];
+	BOOST_REQUIRE (pipe (fds) == 0);
+	pid_t pid = fork();
+	BOOST_REQUIRE (pid >= 0);
+
+	if (pid == 0)
+	{
+		// Inherited events are not exported again
+		TraceRecorder::instance().continueInForkedProcess (3, "worker 1");
+		{
+			saTraceScope ("Worker phase", "file", "a.cpp");
+		}
+
+		string exported = TraceRecorder::instance().exportEvents();
+		bool isWritten = write (fds[1], exported.data(), exported.length()) == ssize_t (exported.length());
+		_exit (isWritten && TraceRecorder::instance().exportEvents().empty() ? 0 : 1);
+	}
+
+	close (fds[1]);
+	string exported;
+	char buffer[256];
+	for (ssize_t nRead; (nRead = read (fds[0], buffer, sizeof (buffer))) > 0;)
+		exported.append (buffer, nRead);
+	close (fds[0]);
+
+	int status = 0;
+	BOOST_REQUIRE (waitpid (pid, &status, 0) == pid);
+	BOOST_CHECK (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+
+	TraceRecorder::instance().importEvents (exported);
+	TraceRecorder::instance().stopRecording();
+	BOOST_CHECK_EQUAL (TraceRecorder::instance().getNumEvents(), 2u);
+
+	MemoryOutputStream stream;
+	TraceRecorder::instance().write (&stream);
+	const string& trace = stream.getContents();
+
+	BOOST_CHECK_EQUAL (countOccurrences (trace, "\"ph\": \"X\""), 2u);
+	BOOST_CHECK (trace.find ("\"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"main\"}") != string::npos);
+	BOOST_CHECK (trace.find ("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 3, \"args\": {\"name\": \"worker 1\"}}") !=
+	             string::npos);
+	BOOST_CHECK (trace.find ("\"pid\": 3, \"tid\": 1, \"args\": {\"file\": \"a.cpp\"}") != string::npos);
+	BOOST_CHECK (trace.find ("Coordinator phase") != string::npos);
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <csignal>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Common.h"
+#include "WorkerPool.h"
+#include <boost/filesystem.hpp>
+
+using namespace sa;
+using namespace std;
+
+static string runTestTask (const string& task)
+{
+	// Boost.Test handles catchable signals in workers too: they would go on running tests
+	if (task == "crash")
+		kill (getpid(), SIGKILL);
+	if (task == "exit")
+		_exit (0);
+	if (task == "hang")
+		this_thread::sleep_for (chrono::seconds (10));
+	if (task == "partial")
+	{
+		// The start of a result frame on the result pipe (the only pipe written by the worker), then nothing
+		for (int fd = 3; fd < 64; fd++)
+		{
+			struct stat status;
+			if (fstat (fd, &status) == 0 && S_ISFIFO (status.st_mode) && (fcntl (fd, F_GETFL) & O_ACCMODE) == O_WRONLY)
+			{
+				const char partialFrame[] = { 100, 0, 0, 0, static_cast <char> (WorkerPool::Status::DONE) };
+				BOOST_REQUIRE (write (fd, partialFrame, sizeof (partialFrame)) == sizeof (partialFrame));
+			}
+		}
+		this_thread::sleep_for (chrono::seconds (10));
+	}
+	if (task == "throw")
+		throw InvalidArgumentException (__ORIGIN__, "Bad task", "task");
+	if (task.compare (0, 7, "record ") == 0)
+	{
+		// 'record <file> <name> <milliseconds>': the name is appended to the file when the task starts
+		istringstream arguments (task.substr (7));
+		string fileName, name;
+		int milliseconds = 0;
+		arguments >> fileName >> name >> milliseconds;
+		ofstream (fileName, ios::app) << name << "\n";
+		this_thread::sleep_for (chrono::milliseconds (milliseconds));
+	}
+
+	return "result of " + task;
+}
+
+static WorkerPool::Result waitForTask (WorkerPool& pool, unsigned taskId, const string& task)
+{
+	pool.submit (taskId, task);
+	WorkerPool::Result result = pool.waitForResult();
+	BOOST_CHECK_EQUAL (result.taskId, taskId);
+	return result;
+}
+
+BOOST_AUTO_TEST_CASE (WorkerPoolRunsTasks)
+{
+	WorkerPool pool (3, runTestTask, nullptr, chrono::seconds (10));
+
+	for (unsigned i = 0; i < 10; i++)
+		pool.submit (i, to_string (i));
+
+	vector <bool> finished (10, false);
+	while (pool.getNumPendingTasks() > 0)
+	{
+		WorkerPool::Result result = pool.waitForResult();
+		BOOST_REQUIRE (result.taskId < 10);
+		BOOST_CHECK (result.status == WorkerPool::Status::DONE);
+		BOOST_CHECK_EQUAL (result.output, "result of " + to_string (result.taskId));
+		finished[result.taskId] = true;
+	}
+
+	BOOST_CHECK (find (finished.begin(), finished.end(), false) == finished.end());
+	BOOST_CHECK_EQUAL (pool.getNumRestarts(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE (WorkerPoolIsolatesFailures)
+{
+	WorkerPool pool (1, runTestTask, nullptr, chrono::milliseconds (300));
+
+	WorkerPool::Result result = waitForTask (pool, 1, "throw");
+	BOOST_CHECK (result.status == WorkerPool::Status::FAILED);
+	BOOST_CHECK (result.output.find ("Bad task") != string::npos);
+
+	BOOST_CHECK (waitForTask (pool, 2, "crash").status == WorkerPool::Status::CRASHED);
+	BOOST_CHECK (waitForTask (pool, 3, "exit").status == WorkerPool::Status::CRASHED);
+	BOOST_CHECK (waitForTask (pool, 4, "hang").status == WorkerPool::Status::TIMED_OUT);
+	BOOST_CHECK (waitForTask (pool, 5, "partial").status == WorkerPool::Status::TIMED_OUT);
+	BOOST_CHECK_EQUAL (pool.getNumRestarts(), 4u);
+
+	// Restarted workers take tasks as usual
+	result = waitForTask (pool, 6, "after");
+	BOOST_CHECK (result.status == WorkerPool::Status::DONE);
+	BOOST_CHECK_EQUAL (result.output, "result of after");
+}
+
+BOOST_AUTO_TEST_CASE (WorkerPoolDispatchOrder)
+{
+	string fileName = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+	WorkerPool pool (1, runTestTask, nullptr, chrono::seconds (10));
+
+	// The coordinator submits files largest first (see GrabbingCoordinator::run): a worker takes them in that order
+	vector <pair <string, int>> tasks = { { "largest", 100 }, { "large", 80 }, { "medium", 50 }, { "small", 10 } };
+	for (unsigned i = 0; i < tasks.size(); i++)
+		pool.submit (i, "record " + fileName + " " + tasks[i].first + " " + to_string (tasks[i].second));
+
+	// The next task is sent before the result is returned: the worker starts it while the caller has the result
+	auto readStarted = [&fileName] ()
+	{
+		vector <string> started;
+		ifstream file (fileName);
+		for (string name; getline (file, name); )
+			started.push_back (name);
+		return started;
+	};
+
+	WorkerPool::Result result = pool.waitForResult();
+	BOOST_CHECK_EQUAL (result.taskId, 0u);
+	this_thread::sleep_for (chrono::milliseconds (50));
+	BOOST_CHECK_EQUAL (readStarted().size(), 2u);
+
+	for (unsigned i = 1; i < tasks.size(); i++)
+		BOOST_CHECK_EQUAL (pool.waitForResult().taskId, i);
+
+	vector <string> started = readStarted();
+	vector <string> expected = { "largest", "large", "medium", "small" };
+	BOOST_CHECK_EQUAL_COLLECTIONS (started.begin(), started.end(), expected.begin(), expected.end());
+	boost::filesystem::remove (fileName);
+}